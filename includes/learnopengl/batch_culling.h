@@ -0,0 +1,198 @@
+#ifndef BATCH_CULLING_H
+#define BATCH_CULLING_H
+
+#include <glm/glm.hpp> //glm::vec3
+#include <vector> //std::vector
+#include <cmath> //std::abs
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BATCH_CULLING_SSE
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+// Only compiled when the compiler targets AVX (-mavx or /arch:AVX)
+#define BATCH_CULLING_AVX
+#include <immintrin.h>
+#endif
+
+#include <learnopengl/frustum.h>
+
+// World space AABBs stored as structure of arrays so that 4 (SSE) or 8 (AVX) boxes can be tested against a plane with
+// a handful of instructions. Arrays are padded to a multiple of 8 so the kernels never read out of bounds.
+struct BoundsSoA
+{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<void*> userData;
+	unsigned int count = 0;
+
+	unsigned int add(const glm::vec3& center, const glm::vec3& extents, void* data)
+	{
+		const unsigned int index = count++;
+		const size_t padded = (count + 7) & ~size_t(7);
+		for (std::vector<float>* array : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ })
+			array->resize(padded, 0.f);
+		userData.resize(padded, nullptr);
+
+		set(index, center, extents);
+		userData[index] = data;
+		return index;
+	}
+
+	void set(unsigned int index, const glm::vec3& center, const glm::vec3& extents)
+	{
+		centerX[index] = center.x;
+		centerY[index] = center.y;
+		centerZ[index] = center.z;
+		extentX[index] = extents.x;
+		extentY[index] = extents.y;
+		extentZ[index] = extents.z;
+	}
+};
+
+// Frustum planes splatted per component, plus the absolute value of the normals used for the projected radius
+struct FrustumSoA
+{
+	float nx[6], ny[6], nz[6], d[6];
+	float ax[6], ay[6], az[6];
+
+	explicit FrustumSoA(const Frustum& frustum)
+	{
+		const Plane* planes[6] = { &frustum.leftFace, &frustum.rightFace, &frustum.topFace,
+			&frustum.bottomFace, &frustum.nearFace, &frustum.farFace };
+		for (unsigned int i = 0; i < 6; ++i)
+		{
+			nx[i] = planes[i]->normal.x;
+			ny[i] = planes[i]->normal.y;
+			nz[i] = planes[i]->normal.z;
+			d[i] = planes[i]->distance;
+			ax[i] = std::abs(nx[i]);
+			ay[i] = std::abs(ny[i]);
+			az[i] = std::abs(nz[i]);
+		}
+	}
+};
+
+// Reference implementation. Writes the indices of the boxes on or in front of all six planes to outVisible and returns
+// how many were written. outVisible must hold at least bounds.count + 8 entries.
+unsigned int cullBoundsScalar(const Frustum& frustum, const BoundsSoA& bounds, unsigned int* outVisible)
+{
+	const FrustumSoA f(frustum);
+	unsigned int visibleCount = 0;
+	for (unsigned int i = 0; i < bounds.count; ++i)
+	{
+		bool visible = true;
+		for (unsigned int p = 0; p < 6 && visible; ++p)
+		{
+			const float dist = f.nx[p] * bounds.centerX[i] + f.ny[p] * bounds.centerY[i] + f.nz[p] * bounds.centerZ[i] - f.d[p];
+			const float r = f.ax[p] * bounds.extentX[i] + f.ay[p] * bounds.extentY[i] + f.az[p] * bounds.extentZ[i];
+			visible = -r <= dist;
+		}
+		outVisible[visibleCount] = i;
+		visibleCount += visible;
+	}
+	return visibleCount;
+}
+
+#ifdef BATCH_CULLING_SSE
+unsigned int cullBoundsSSE(const Frustum& frustum, const BoundsSoA& bounds, unsigned int* outVisible)
+{
+	const FrustumSoA f(frustum);
+	const __m128 signMask = _mm_set1_ps(-0.f);
+	unsigned int visibleCount = 0;
+	for (unsigned int i = 0; i < bounds.count; i += 4)
+	{
+		const __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+		const __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+		const __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+		const __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+		const __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+		const __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+
+		__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (unsigned int p = 0; p < 6; ++p)
+		{
+			__m128 dist = _mm_mul_ps(cx, _mm_set1_ps(f.nx[p]));
+			dist = _mm_add_ps(dist, _mm_mul_ps(cy, _mm_set1_ps(f.ny[p])));
+			dist = _mm_add_ps(dist, _mm_mul_ps(cz, _mm_set1_ps(f.nz[p])));
+			dist = _mm_sub_ps(dist, _mm_set1_ps(f.d[p]));
+
+			__m128 r = _mm_mul_ps(ex, _mm_set1_ps(f.ax[p]));
+			r = _mm_add_ps(r, _mm_mul_ps(ey, _mm_set1_ps(f.ay[p])));
+			r = _mm_add_ps(r, _mm_mul_ps(ez, _mm_set1_ps(f.az[p])));
+
+			// -r <= dist
+			visible = _mm_and_ps(visible, _mm_cmple_ps(_mm_xor_ps(r, signMask), dist));
+		}
+
+		// Branchless compaction, the lanes past bounds.count are masked out
+		const unsigned int remaining = bounds.count - i;
+		unsigned int mask = static_cast<unsigned int>(_mm_movemask_ps(visible));
+		if (remaining < 4)
+			mask &= (1u << remaining) - 1u;
+		for (unsigned int lane = 0; lane < 4; ++lane)
+		{
+			outVisible[visibleCount] = i + lane;
+			visibleCount += (mask >> lane) & 1u;
+		}
+	}
+	return visibleCount;
+}
+#endif
+
+#ifdef BATCH_CULLING_AVX
+unsigned int cullBoundsAVX(const Frustum& frustum, const BoundsSoA& bounds, unsigned int* outVisible)
+{
+	const FrustumSoA f(frustum);
+	const __m256 signMask = _mm256_set1_ps(-0.f);
+	unsigned int visibleCount = 0;
+	for (unsigned int i = 0; i < bounds.count; i += 8)
+	{
+		const __m256 cx = _mm256_loadu_ps(&bounds.centerX[i]);
+		const __m256 cy = _mm256_loadu_ps(&bounds.centerY[i]);
+		const __m256 cz = _mm256_loadu_ps(&bounds.centerZ[i]);
+		const __m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+		const __m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+		const __m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+
+		__m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (unsigned int p = 0; p < 6; ++p)
+		{
+			__m256 dist = _mm256_mul_ps(cx, _mm256_set1_ps(f.nx[p]));
+			dist = _mm256_add_ps(dist, _mm256_mul_ps(cy, _mm256_set1_ps(f.ny[p])));
+			dist = _mm256_add_ps(dist, _mm256_mul_ps(cz, _mm256_set1_ps(f.nz[p])));
+			dist = _mm256_sub_ps(dist, _mm256_set1_ps(f.d[p]));
+
+			__m256 r = _mm256_mul_ps(ex, _mm256_set1_ps(f.ax[p]));
+			r = _mm256_add_ps(r, _mm256_mul_ps(ey, _mm256_set1_ps(f.ay[p])));
+			r = _mm256_add_ps(r, _mm256_mul_ps(ez, _mm256_set1_ps(f.az[p])));
+
+			visible = _mm256_and_ps(visible, _mm256_cmp_ps(_mm256_xor_ps(r, signMask), dist, _CMP_LE_OQ));
+		}
+
+		const unsigned int remaining = bounds.count - i;
+		unsigned int mask = static_cast<unsigned int>(_mm256_movemask_ps(visible));
+		if (remaining < 8)
+			mask &= (1u << remaining) - 1u;
+		for (unsigned int lane = 0; lane < 8; ++lane)
+		{
+			outVisible[visibleCount] = i + lane;
+			visibleCount += (mask >> lane) & 1u;
+		}
+	}
+	return visibleCount;
+}
+#endif
+
+// Widest kernel available for the current compile target
+unsigned int cullBounds(const Frustum& frustum, const BoundsSoA& bounds, unsigned int* outVisible)
+{
+#if defined(BATCH_CULLING_AVX)
+	return cullBoundsAVX(frustum, bounds, outVisible);
+#elif defined(BATCH_CULLING_SSE)
+	return cullBoundsSSE(frustum, bounds, outVisible);
+#else
+	return cullBoundsScalar(frustum, bounds, outVisible);
+#endif
+}
+#endif
@@ -0,0 +1,381 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp> //glm::vec3
+#include <vector> //std::vector
+#include <algorithm> //std::max
+#include <cassert> //assert
+
+#include <learnopengl/frustum.h>
+
+struct BVHStats
+{
+	unsigned int tested = 0; //Nodes tested against the frustum planes
+	unsigned int visible = 0; //Leaves reported as visible
+};
+
+// Dynamic bounding volume hierarchy over world space AABBs. Leaves hold a slightly enlarged ("fat") copy of the
+// bounds so that small movements only update the stored box; a leaf that leaves its fat box is removed and re-inserted,
+// and the tree is kept balanced with AVL-like rotations while the ancestors are refitted.
+class DynamicBVH
+{
+public:
+	static constexpr int nullNode = -1;
+
+	DynamicBVH(float margin = 0.5f) : m_margin{ margin }
+	{}
+
+	//Insert a new leaf and return its proxy id. userData is handed back by the queries.
+	int createProxy(const glm::vec3& min, const glm::vec3& max, void* userData)
+	{
+		const int proxyId = allocateNode();
+		m_nodes[proxyId].min = min - glm::vec3(m_margin);
+		m_nodes[proxyId].max = max + glm::vec3(m_margin);
+		m_nodes[proxyId].userData = userData;
+		m_nodes[proxyId].height = 0;
+		insertLeaf(proxyId);
+		++m_proxyCount;
+		return proxyId;
+	}
+
+	void destroyProxy(int proxyId)
+	{
+		assert(m_nodes[proxyId].isLeaf());
+		removeLeaf(proxyId);
+		freeNode(proxyId);
+		--m_proxyCount;
+	}
+
+	//Refit a leaf with its new bounds. Returns true if the leaf had to be re-inserted in the tree.
+	bool moveProxy(int proxyId, const glm::vec3& min, const glm::vec3& max)
+	{
+		assert(m_nodes[proxyId].isLeaf());
+		Node& leaf = m_nodes[proxyId];
+		if (glm::all(glm::lessThanEqual(leaf.min, min)) && glm::all(glm::greaterThanEqual(leaf.max, max)))
+			return false;
+
+		removeLeaf(proxyId);
+		m_nodes[proxyId].min = min - glm::vec3(m_margin);
+		m_nodes[proxyId].max = max + glm::vec3(m_margin);
+		insertLeaf(proxyId);
+		return true;
+	}
+
+	void* getUserData(int proxyId) const
+	{
+		return m_nodes[proxyId].userData;
+	}
+
+	int getHeight() const
+	{
+		return m_root == nullNode ? 0 : m_nodes[m_root].height;
+	}
+
+	unsigned int getProxyCount() const
+	{
+		return m_proxyCount;
+	}
+
+	//Call callback(userData) for every leaf that intersects the frustum. Each visited node is only tested against the
+	//planes its parent straddles: subtrees outside a plane are pruned and subtrees inside all planes are accepted
+	//without testing their children. Leaves are tested with their fat box, so the result is conservative.
+	template<typename TCallback>
+	void queryFrustum(const Frustum& frustum, TCallback&& callback, BVHStats& stats) const
+	{
+		if (m_root == nullNode)
+			return;
+
+		const Plane* planes[6] = { &frustum.leftFace, &frustum.rightFace, &frustum.topFace,
+			&frustum.bottomFace, &frustum.nearFace, &frustum.farFace };
+
+		m_stack.clear();
+		m_stack.push_back({ m_root, 0x3F });
+		while (!m_stack.empty())
+		{
+			const StackEntry entry = m_stack.back();
+			m_stack.pop_back();
+
+			const Node& node = m_nodes[entry.node];
+			unsigned int mask = entry.planeMask;
+			if (mask)
+			{
+				++stats.tested;
+				const glm::vec3 center = (node.max + node.min) * 0.5f;
+				const glm::vec3 extents = node.max - center;
+
+				bool outside = false;
+				for (unsigned int i = 0; i < 6; ++i)
+				{
+					if (!(mask & (1u << i)))
+						continue;
+
+					// Compute the projection interval radius of the box onto the plane normal
+					const float r = glm::dot(extents, glm::abs(planes[i]->normal));
+					const float d = planes[i]->getSignedDistanceToPlane(center);
+					if (d < -r)
+					{
+						outside = true;
+						break;
+					}
+					if (d >= r)
+						mask &= ~(1u << i);
+				}
+				if (outside)
+					continue;
+			}
+
+			if (node.isLeaf())
+			{
+				++stats.visible;
+				callback(node.userData);
+			}
+			else
+			{
+				m_stack.push_back({ node.child1, mask });
+				m_stack.push_back({ node.child2, mask });
+			}
+		}
+	}
+
+private:
+	struct Node
+	{
+		glm::vec3 min{ 0.f };
+		glm::vec3 max{ 0.f };
+		void* userData = nullptr;
+
+		int parent = nullNode; //Next free node when the node is in the free list
+		int child1 = nullNode;
+		int child2 = nullNode;
+
+		int height = -1; //Leaf = 0, free node = -1
+
+		bool isLeaf() const
+		{
+			return child1 == nullNode;
+		}
+	};
+
+	struct StackEntry
+	{
+		int node;
+		unsigned int planeMask;
+	};
+
+	std::vector<Node> m_nodes;
+	mutable std::vector<StackEntry> m_stack;
+	int m_root = nullNode;
+	int m_freeList = nullNode;
+	unsigned int m_proxyCount = 0;
+	float m_margin;
+
+	static float surfaceArea(const glm::vec3& min, const glm::vec3& max)
+	{
+		const glm::vec3 d = max - min;
+		return 2.f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	int allocateNode()
+	{
+		if (m_freeList == nullNode)
+		{
+			m_nodes.emplace_back();
+			return static_cast<int>(m_nodes.size()) - 1;
+		}
+
+		const int nodeId = m_freeList;
+		m_freeList = m_nodes[nodeId].parent;
+		m_nodes[nodeId] = Node{};
+		return nodeId;
+	}
+
+	void freeNode(int nodeId)
+	{
+		m_nodes[nodeId].parent = m_freeList;
+		m_nodes[nodeId].height = -1;
+		m_freeList = nodeId;
+	}
+
+	void refit(int nodeId)
+	{
+		Node& node = m_nodes[nodeId];
+		const Node& child1 = m_nodes[node.child1];
+		const Node& child2 = m_nodes[node.child2];
+		node.min = glm::min(child1.min, child2.min);
+		node.max = glm::max(child1.max, child2.max);
+		node.height = 1 + std::max(child1.height, child2.height);
+	}
+
+	void insertLeaf(int leaf)
+	{
+		if (m_root == nullNode)
+		{
+			m_root = leaf;
+			m_nodes[m_root].parent = nullNode;
+			return;
+		}
+
+		//Find the best sibling with the surface area heuristic
+		const glm::vec3 leafMin = m_nodes[leaf].min;
+		const glm::vec3 leafMax = m_nodes[leaf].max;
+		int index = m_root;
+		while (!m_nodes[index].isLeaf())
+		{
+			const Node& node = m_nodes[index];
+			const float area = surfaceArea(node.min, node.max);
+			const float combinedArea = surfaceArea(glm::min(node.min, leafMin), glm::max(node.max, leafMax));
+
+			//Cost of creating a new parent for this node and the new leaf
+			const float cost = 2.f * combinedArea;
+
+			//Minimum cost of pushing the leaf further down the tree
+			const float inheritanceCost = 2.f * (combinedArea - area);
+
+			auto descendCost = [&](int childId)
+			{
+				const Node& child = m_nodes[childId];
+				const float newArea = surfaceArea(glm::min(child.min, leafMin), glm::max(child.max, leafMax));
+				if (child.isLeaf())
+					return newArea + inheritanceCost;
+				return newArea - surfaceArea(child.min, child.max) + inheritanceCost;
+			};
+
+			const float cost1 = descendCost(node.child1);
+			const float cost2 = descendCost(node.child2);
+
+			if (cost < cost1 && cost < cost2)
+				break;
+
+			index = cost1 < cost2 ? node.child1 : node.child2;
+		}
+
+		//Create a new parent for the sibling and the leaf
+		const int sibling = index;
+		const int oldParent = m_nodes[sibling].parent;
+		const int newParent = allocateNode();
+		m_nodes[newParent].parent = oldParent;
+		m_nodes[newParent].child1 = sibling;
+		m_nodes[newParent].child2 = leaf;
+		m_nodes[sibling].parent = newParent;
+		m_nodes[leaf].parent = newParent;
+
+		if (oldParent != nullNode)
+		{
+			if (m_nodes[oldParent].child1 == sibling)
+				m_nodes[oldParent].child1 = newParent;
+			else
+				m_nodes[oldParent].child2 = newParent;
+		}
+		else
+		{
+			m_root = newParent;
+		}
+
+		//Walk back up the tree fixing heights and bounds
+		fixUpwards(newParent);
+	}
+
+	void removeLeaf(int leaf)
+	{
+		if (leaf == m_root)
+		{
+			m_root = nullNode;
+			return;
+		}
+
+		const int parent = m_nodes[leaf].parent;
+		const int grandParent = m_nodes[parent].parent;
+		const int sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+		if (grandParent != nullNode)
+		{
+			//Destroy parent and connect sibling to grandParent
+			if (m_nodes[grandParent].child1 == parent)
+				m_nodes[grandParent].child1 = sibling;
+			else
+				m_nodes[grandParent].child2 = sibling;
+			m_nodes[sibling].parent = grandParent;
+			freeNode(parent);
+
+			fixUpwards(grandParent);
+		}
+		else
+		{
+			m_root = sibling;
+			m_nodes[sibling].parent = nullNode;
+			freeNode(parent);
+		}
+	}
+
+	void fixUpwards(int index)
+	{
+		while (index != nullNode)
+		{
+			index = balance(index);
+			refit(index);
+			index = m_nodes[index].parent;
+		}
+	}
+
+	//Perform a left or right rotation if node A is imbalanced. Returns the new root index of the subtree.
+	int balance(int iA)
+	{
+		Node& A = m_nodes[iA];
+		if (A.isLeaf() || A.height < 2)
+			return iA;
+
+		const int iB = A.child1;
+		const int iC = A.child2;
+		const int heightDelta = m_nodes[iC].height - m_nodes[iB].height;
+
+		if (heightDelta > 1)
+			return rotate(iA, iC);
+		if (heightDelta < -1)
+			return rotate(iA, iB);
+		return iA;
+	}
+
+	//Promote iHigh (the taller child of iA) in place of iA
+	int rotate(int iA, int iHigh)
+	{
+		Node& A = m_nodes[iA];
+		Node& H = m_nodes[iHigh];
+		const int iF = H.child1;
+		const int iG = H.child2;
+
+		//Swap A and H
+		H.child1 = iA;
+		H.parent = A.parent;
+		A.parent = iHigh;
+
+		//A's old parent should point to H
+		if (H.parent != nullNode)
+		{
+			if (m_nodes[H.parent].child1 == iA)
+				m_nodes[H.parent].child1 = iHigh;
+			else
+				m_nodes[H.parent].child2 = iHigh;
+		}
+		else
+		{
+			m_root = iHigh;
+		}
+
+		//Keep the taller grandchild under H, hand the other one to A
+		const bool fTaller = m_nodes[iF].height > m_nodes[iG].height;
+		const int iKeep = fTaller ? iF : iG;
+		const int iMove = fTaller ? iG : iF;
+
+		H.child2 = iKeep;
+		if (A.child1 == iHigh)
+			A.child1 = iMove;
+		else
+			A.child2 = iMove;
+		m_nodes[iMove].parent = iA;
+
+		refit(iA);
+		refit(iHigh);
+		return iHigh;
+	}
+};
+#endif
@@ -0,0 +1,234 @@
+#ifndef CDLOD_H
+#define CDLOD_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/instance_buffer.h>
+#include <learnopengl/heightmap_pyramid.h>
+#include <learnopengl/heightmap_tile_cache.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef> // offsetof
+#include <cmath>
+
+// most LOD levels the terrain shader has morph ranges for
+#define CDLOD_MAX_LEVELS 16
+
+struct CDLODStats {
+    unsigned int visitedNodes = 0;
+    unsigned int selectedPatches = 0;
+    unsigned int triangles = 0;
+};
+
+// per patch instance data: first level-0 sample (row, column), size in samples and level, then the layer of the tile
+// cache it reads its heights from, the tile's first level-0 sample and the level-0 samples between its texels
+struct CDLODPatch {
+    glm::vec4 patch;
+    glm::vec4 tile;
+};
+
+// Continuous distance-dependent level of detail terrain (Strugar 2009). The heightmap is covered by a quadtree whose
+// leaves are patchResolution x patchResolution samples, every level up doubling the node size. Each frame the tree is
+// walked from the root: nodes outside the frustum are dropped, nodes entirely out of the LOD range of the level below
+// are drawn as one patch, the others are refined. Every selected patch is the same shared grid mesh scaled over its node,
+// all of them drawn with a single instanced call. The vertex shader reads the heights from a texture and morphs the
+// vertices of a patch towards the grid of the next level as they approach the end of their range, so levels meet
+// without cracks or popping.
+//
+// The heights come from a cooked HeightmapPyramid: node bounds from the height ranges stored in it, and a patch of level
+// l reads the tile of level l covering it from the tile cache, or a coarser one until that is streamed in.
+class CDLODTerrain {
+public:
+    unsigned int PatchResolution;
+    unsigned int LevelCount;
+    float LodRanges[CDLOD_MAX_LEVELS]; // a node of level l is drawn up to LodRanges[l] from the camera
+    HeightmapTileCache Tiles;
+
+    // lodRange0 is the distance up to which the finest level is used, each level doubles it. 0 picks a range from the
+    // leaf size that keeps neighbouring patches within one level of each other. The pyramid must outlive the terrain
+    // and its tiles must be a whole number of patches.
+    CDLODTerrain(const HeightmapPyramid &pyramid, float lodRange0 = 0.0f, unsigned int tileLayers = 256)
+        : PatchResolution(pyramid.Header.patchResolution), LevelCount(std::min(pyramid.LevelCount(), (unsigned int)CDLOD_MAX_LEVELS)),
+          Tiles(pyramid, tileLayers), pyramid(pyramid),
+          patches(InstanceLayout(sizeof(CDLODPatch))
+              .Add(FIRST_INSTANCE_ATTRIBUTE, 4, GL_FLOAT, offsetof(CDLODPatch, patch))
+              .Add(FIRST_INSTANCE_ATTRIBUTE + 1, 4, GL_FLOAT, offsetof(CDLODPatch, tile)), GL_STREAM_DRAW)
+    {
+        if (lodRange0 <= 0.0f)
+            lodRange0 = 2.0f * PatchResolution * pyramid.Header.sampleSpacing;
+        for (unsigned int level = 0; level < CDLOD_MAX_LEVELS; level++)
+            LodRanges[level] = lodRange0 * float(1u << level);
+
+        createGridMesh();
+    }
+
+    // select the patches for this camera and draw them. The shader is the CDLOD terrain shader, its "view" and
+    // "projection" are left to the caller.
+    void Draw(Shader &shader, const Frustum &frustum, const glm::vec3 &cameraPosition, CDLODStats &stats)
+    {
+        selected.clear();
+        stats.visitedNodes = 0;
+        Tiles.BeginFrame();
+        const unsigned int top = LevelCount - 1;
+        for (unsigned int z = 0; z < pyramid.Layout().NodesZ(top); z++)
+            for (unsigned int x = 0; x < pyramid.Layout().NodesX(top); x++)
+                selectNode(top, x, z, frustum, cameraPosition, stats);
+        // after the selection, so the tiles it just used are not the ones evicted for the new ones
+        Tiles.Update();
+        stats.selectedPatches = static_cast<unsigned int>(selected.size());
+        stats.triangles = stats.selectedPatches * PatchResolution * PatchResolution * 2;
+        if (selected.empty())
+            return;
+
+        patches.Update(selected);
+
+        shader.use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, Tiles.TextureArray);
+        shader.setInt("heightTiles", 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, Tiles.ShadingArray);
+        shader.setInt("shadingTiles", 1);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setFloat("tileSize", static_cast<float>(pyramid.Header.tileSize));
+        shader.setVec2("heightmapSize", glm::vec2(pyramid.Header.rows, pyramid.Header.columns));
+        shader.setVec2("terrainOrigin", pyramid.Origin());
+        shader.setFloat("sampleSpacing", pyramid.Header.sampleSpacing);
+        shader.setFloat("heightScale", pyramid.Header.heightScale);
+        shader.setFloat("heightOffset", pyramid.Header.heightOffset);
+        shader.setFloat("patchResolution", static_cast<float>(PatchResolution));
+        shader.setVec3("cameraPosition", cameraPosition);
+        for (unsigned int level = 0; level < LevelCount; level++)
+        {
+            // morph over the last third of the range of the level
+            const float previous = level == 0 ? 0.0f : LodRanges[level - 1];
+            const float start = previous + (LodRanges[level] - previous) * 0.66f;
+            shader.setVec2("morphRanges[" + std::to_string(level) + "]", glm::vec2(start, 1.0f / (LodRanges[level] - start)));
+        }
+
+        glBindVertexArray(gridVAO);
+        glDrawElementsInstanced(GL_TRIANGLES, gridIndexCount, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(selected.size()));
+        glBindVertexArray(0);
+    }
+
+    // world space bounds of node (x, z) of a level
+    void GetNodeBounds(unsigned int level, unsigned int x, unsigned int z, glm::vec3 &minimum, glm::vec3 &maximum) const
+    {
+        const HeightRange &range = pyramid.Range(level, x, z);
+        const float nodeSize = float(PatchResolution << level) * pyramid.Header.sampleSpacing;
+        const glm::vec2 origin = pyramid.Origin();
+        minimum = glm::vec3(origin.x + x * nodeSize, pyramid.ToHeight(range.minimum), origin.y + z * nodeSize);
+        maximum = glm::vec3(minimum.x + nodeSize, pyramid.ToHeight(range.maximum), minimum.z + nodeSize);
+    }
+
+private:
+    const HeightmapPyramid &pyramid;
+    InstanceBuffer<CDLODPatch> patches;
+    std::vector<CDLODPatch> selected;
+    unsigned int gridVAO, gridVBO, gridEBO;
+    unsigned int gridIndexCount;
+
+    bool nodeExists(unsigned int level, unsigned int x, unsigned int z) const
+    {
+        return x < pyramid.Layout().NodesX(level) && z < pyramid.Layout().NodesZ(level);
+    }
+
+    void selectNode(unsigned int level, unsigned int x, unsigned int z, const Frustum &frustum, const glm::vec3 &cameraPosition, CDLODStats &stats)
+    {
+        stats.visitedNodes++;
+        glm::vec3 minimum, maximum;
+        GetNodeBounds(level, x, z, minimum, maximum);
+        if (!isBoxOnFrustum(frustum, minimum, maximum))
+            return;
+
+        // drawn as a whole when it's the finest level or when no part of it is close enough for the level below
+        if (level == 0 || !isBoxInSphere(minimum, maximum, cameraPosition, LodRanges[level - 1]))
+        {
+            addPatch(level, x, z);
+            return;
+        }
+
+        for (unsigned int child = 0; child < 4; child++)
+        {
+            const unsigned int childX = x * 2 + (child & 1);
+            const unsigned int childZ = z * 2 + (child >> 1);
+            if (nodeExists(level - 1, childX, childZ))
+                selectNode(level - 1, childX, childZ, frustum, cameraPosition, stats);
+        }
+    }
+
+    void addPatch(unsigned int level, unsigned int x, unsigned int z)
+    {
+        const unsigned int nodeSamples = PatchResolution << level;
+        const HeightmapTileRef tile = Tiles.Request(level, x * nodeSamples, z * nodeSamples);
+        CDLODPatch patch;
+        patch.patch = glm::vec4(x * nodeSamples, z * nodeSamples, nodeSamples, level);
+        patch.tile = glm::vec4(tile.layer, tile.originRow, tile.originColumn, tile.spacing);
+        selected.push_back(patch);
+    }
+
+    // true if any part of the box is closer than radius to center
+    static bool isBoxInSphere(const glm::vec3 &minimum, const glm::vec3 &maximum, const glm::vec3 &center, float radius)
+    {
+        const glm::vec3 closest = glm::clamp(center, minimum, maximum);
+        const glm::vec3 offset = closest - center;
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+
+    static bool isBoxOnFrustum(const Frustum &frustum, const glm::vec3 &minimum, const glm::vec3 &maximum)
+    {
+        const glm::vec3 center = (minimum + maximum) * 0.5f;
+        const glm::vec3 extents = (maximum - minimum) * 0.5f;
+        const Plane *planes[6] = { &frustum.leftFace, &frustum.rightFace, &frustum.topFace,
+            &frustum.bottomFace, &frustum.nearFace, &frustum.farFace };
+        for (const Plane *plane : planes)
+        {
+            const float r = glm::dot(extents, glm::abs(plane->normal));
+            if (plane->getSignedDistanceToPlane(center) < -r)
+                return false;
+        }
+        return true;
+    }
+
+    // (PatchResolution + 1)^2 vertices in [0, 1]^2, shared by every patch
+    void createGridMesh()
+    {
+        std::vector<glm::vec2> vertices;
+        for (unsigned int x = 0; x <= PatchResolution; x++)
+            for (unsigned int z = 0; z <= PatchResolution; z++)
+                vertices.push_back(glm::vec2(x, z) / float(PatchResolution));
+
+        std::vector<unsigned int> indices;
+        const unsigned int stride = PatchResolution + 1;
+        for (unsigned int x = 0; x < PatchResolution; x++)
+        {
+            for (unsigned int z = 0; z < PatchResolution; z++)
+            {
+                const unsigned int i = x * stride + z;
+                indices.insert(indices.end(), { i, i + 1, i + stride, i + 1, i + stride + 1, i + stride });
+            }
+        }
+        gridIndexCount = static_cast<unsigned int>(indices.size());
+
+        glGenVertexArrays(1, &gridVAO);
+        glGenBuffers(1, &gridVBO);
+        glGenBuffers(1, &gridEBO);
+        glBindVertexArray(gridVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        patches.SetupAttributes();
+        glBindVertexArray(0);
+    }
+};
+#endif
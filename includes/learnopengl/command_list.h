@@ -0,0 +1,159 @@
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp> //glm::mat4
+#include <vector> //std::vector
+#include <cstring> //std::memcpy
+#include <cstdint> //uint32_t
+#include <cassert> //assert
+
+#include <learnopengl/mesh.h>
+
+// Linear buffer of API-agnostic render commands. Recording only writes plain data and never touches OpenGL, so
+// worker threads can each fill their own list; execute() must then be called from the thread owning the GL context.
+// Every list is replayed on its own, so it must record useShader before any command that needs a shader.
+class CommandList
+{
+public:
+	enum CommandType : uint32_t
+	{
+		CMD_USE_SHADER,
+		CMD_SET_MAT4,
+		CMD_BIND_TEXTURES,
+		CMD_DRAW_MESH
+	};
+
+	void reset()
+	{
+		m_buffer.clear();
+		m_commandCount = 0;
+	}
+
+	void useShader(Shader& shader)
+	{
+		push(CMD_USE_SHADER, ShaderCommand{ &shader });
+	}
+
+	//name is stored by pointer and must outlive the list (a string literal in practice)
+	void setMat4(const char* name, const glm::mat4& value)
+	{
+		push(CMD_SET_MAT4, Mat4Command{ name, value });
+	}
+
+	void bindTextures(Mesh& mesh)
+	{
+		push(CMD_BIND_TEXTURES, MeshCommand{ &mesh });
+	}
+
+	void drawMesh(Mesh& mesh)
+	{
+		push(CMD_DRAW_MESH, MeshCommand{ &mesh });
+	}
+
+	unsigned int getCommandCount() const
+	{
+		return m_commandCount;
+	}
+
+	size_t getByteSize() const
+	{
+		return m_buffer.size();
+	}
+
+	//Replay the commands. VAO binds are skipped while consecutive draws use the same mesh.
+	void execute() const
+	{
+		Shader* currentShader = nullptr;
+		unsigned int currentVAO = 0;
+		size_t offset = 0;
+		while (offset < m_buffer.size())
+		{
+			CommandHeader header;
+			std::memcpy(&header, &m_buffer[offset], sizeof(CommandHeader));
+			const unsigned char* payload = &m_buffer[offset + sizeof(CommandHeader)];
+			offset += sizeof(CommandHeader) + header.size;
+
+			switch (header.type)
+			{
+			case CMD_USE_SHADER:
+			{
+				ShaderCommand command;
+				std::memcpy(&command, payload, sizeof(command));
+				currentShader = command.shader;
+				currentShader->use();
+				break;
+			}
+			case CMD_SET_MAT4:
+			{
+				Mat4Command command;
+				std::memcpy(&command, payload, sizeof(command));
+				assert(currentShader && "CommandList: setMat4 recorded before useShader");
+				currentShader->setMat4(command.name, command.value);
+				break;
+			}
+			case CMD_BIND_TEXTURES:
+			{
+				MeshCommand command;
+				std::memcpy(&command, payload, sizeof(command));
+				assert(currentShader && "CommandList: bindTextures recorded before useShader");
+				command.mesh->BindTextures(*currentShader);
+				break;
+			}
+			case CMD_DRAW_MESH:
+			{
+				MeshCommand command;
+				std::memcpy(&command, payload, sizeof(command));
+				if (command.mesh->VAO != currentVAO)
+				{
+					currentVAO = command.mesh->VAO;
+					glBindVertexArray(currentVAO);
+				}
+				glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(command.mesh->indices.size()), GL_UNSIGNED_INT, 0);
+				break;
+			}
+			}
+		}
+
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+private:
+	struct CommandHeader
+	{
+		CommandType type;
+		uint32_t size;
+	};
+
+	struct ShaderCommand
+	{
+		Shader* shader;
+	};
+
+	struct Mat4Command
+	{
+		const char* name;
+		glm::mat4 value;
+	};
+
+	struct MeshCommand
+	{
+		Mesh* mesh;
+	};
+
+	std::vector<unsigned char> m_buffer;
+	unsigned int m_commandCount = 0;
+
+	template<typename TPayload>
+	void push(CommandType type, const TPayload& payload)
+	{
+		const CommandHeader header{ type, static_cast<uint32_t>(sizeof(TPayload)) };
+		const size_t offset = m_buffer.size();
+		m_buffer.resize(offset + sizeof(CommandHeader) + sizeof(TPayload));
+		std::memcpy(&m_buffer[offset], &header, sizeof(CommandHeader));
+		std::memcpy(&m_buffer[offset + sizeof(CommandHeader)], &payload, sizeof(TPayload));
+		++m_commandCount;
+	}
+};
+#endif
@@ -0,0 +1,129 @@
+#ifndef DEPTH_STREAM_H
+#define DEPTH_STREAM_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <vector>
+
+// Depth only passes (shadow maps, depth prepasses, occlusion queries) read nothing but positions, yet an interleaved
+// vertex buffer makes the vertex fetch pull the whole vertex through the cache for them. A depth stream is a copy of
+// the geometry for those passes: 12 byte positions, tightly packed, plus the bone indices and weights of skinned
+// meshes in a second buffer. Vertices that only differed in attributes depth passes do not read are welded into one,
+// so the stream usually has far fewer vertices than the mesh as well. Attribute locations match Mesh's, 0 for the
+// position and 5 and 6 for the skinning data, so the same vertex shaders work with either VAO.
+struct DepthStream
+{
+    unsigned int VAO = 0;
+    unsigned int positionVBO = 0;
+    unsigned int skinVBO = 0; // 0 unless skinned
+    unsigned int EBO = 0;
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+};
+
+// the skinning data of a depth stream vertex, laid out like the end of Mesh's Vertex
+struct DepthSkin
+{
+    int   BoneIDs[4];
+    float Weights[4];
+};
+
+// Weld the triangles of indices over positions (and skin, if not empty) into unique vertices and upload them. Only
+// bitwise equal vertices are merged, which is all the duplicates split along normal or texture seams.
+DepthStream createDepthStream(const std::vector<glm::vec3>& positions, const std::vector<DepthSkin>& skin, const std::vector<unsigned int>& indices)
+{
+    const bool skinned = !skin.empty();
+    std::vector<glm::vec3> weldedPositions;
+    std::vector<DepthSkin> weldedSkin;
+    std::vector<unsigned int> weldedIndices;
+    weldedIndices.reserve(indices.size());
+    std::vector<unsigned int> remap(positions.size(), ~0u);
+    std::map<std::array<unsigned int, 11>, unsigned int> unique;
+    for (unsigned int index : indices)
+    {
+        if (remap[index] == ~0u)
+        {
+            std::array<unsigned int, 11> key = {};
+            std::memcpy(key.data(), &positions[index], sizeof(glm::vec3));
+            if (skinned)
+                std::memcpy(key.data() + 3, &skin[index], sizeof(DepthSkin));
+            auto it = unique.find(key);
+            if (it == unique.end())
+            {
+                it = unique.insert({ key, (unsigned int)weldedPositions.size() }).first;
+                weldedPositions.push_back(positions[index]);
+                if (skinned)
+                    weldedSkin.push_back(skin[index]);
+            }
+            remap[index] = it->second;
+        }
+        weldedIndices.push_back(remap[index]);
+    }
+
+    DepthStream stream;
+    stream.vertexCount = (unsigned int)weldedPositions.size();
+    stream.indexCount = (unsigned int)weldedIndices.size();
+    glGenVertexArrays(1, &stream.VAO);
+    glGenBuffers(1, &stream.positionVBO);
+    glGenBuffers(1, &stream.EBO);
+
+    glBindVertexArray(stream.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, weldedPositions.size() * sizeof(glm::vec3), weldedPositions.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    if (skinned)
+    {
+        glGenBuffers(1, &stream.skinVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, stream.skinVBO);
+        glBufferData(GL_ARRAY_BUFFER, weldedSkin.size() * sizeof(DepthSkin), weldedSkin.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_INT, sizeof(DepthSkin), (void*)offsetof(DepthSkin, BoneIDs));
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(DepthSkin), (void*)offsetof(DepthSkin, Weights));
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stream.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, weldedIndices.size() * sizeof(unsigned int), weldedIndices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return stream;
+}
+
+// the depth stream of non-indexed triangles in an interleaved float array, the position being the first 3 floats of
+// every vertex; stride in floats
+DepthStream createDepthStream(const float* vertices, unsigned int vertexCount, unsigned int stride)
+{
+    std::vector<glm::vec3> positions(vertexCount);
+    std::vector<unsigned int> indices(vertexCount);
+    for (unsigned int i = 0; i < vertexCount; i++)
+    {
+        positions[i] = glm::vec3(vertices[i * stride], vertices[i * stride + 1], vertices[i * stride + 2]);
+        indices[i] = i;
+    }
+    return createDepthStream(positions, std::vector<DepthSkin>(), indices);
+}
+
+// draw instanceCount instances of the stream's triangles
+void drawDepthStream(const DepthStream& stream, unsigned int instanceCount = 1)
+{
+    glBindVertexArray(stream.VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, stream.indexCount, GL_UNSIGNED_INT, 0, instanceCount);
+    glBindVertexArray(0);
+}
+
+void deleteDepthStream(DepthStream& stream)
+{
+    glDeleteVertexArrays(1, &stream.VAO);
+    glDeleteBuffers(1, &stream.positionVBO);
+    if (stream.skinVBO != 0)
+        glDeleteBuffers(1, &stream.skinVBO);
+    glDeleteBuffers(1, &stream.EBO);
+    stream = DepthStream();
+}
+#endif
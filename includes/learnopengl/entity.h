@@ -6,6 +6,12 @@
 #include <array> //std::array
 #include <memory> //std::unique_ptr
 
+#include <learnopengl/frustum.h>
+#include <learnopengl/bvh.h>
+#include <learnopengl/batch_culling.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/command_list.h>
+
 class Transform
 {
 protected:
@@ -122,36 +128,6 @@ public:
 	}
 };
 
-struct Plane
-{
-	glm::vec3 normal = { 0.f, 1.f, 0.f }; // unit vector
-	float     distance = 0.f;        // Distance with origin
-
-	Plane() = default;
-
-	Plane(const glm::vec3& p1, const glm::vec3& norm)
-		: normal(glm::normalize(norm)),
-		distance(glm::dot(normal, p1))
-	{}
-
-	float getSignedDistanceToPlane(const glm::vec3& point) const
-	{
-		return glm::dot(normal, point) - distance;
-	}
-};
-
-struct Frustum
-{
-	Plane topFace;
-	Plane bottomFace;
-
-	Plane rightFace;
-	Plane leftFace;
-
-	Plane farFace;
-	Plane nearFace;
-};
-
 struct BoundingVolume
 {
 	virtual bool isOnFrustum(const Frustum& camFrustum, const Transform& transform) const = 0;
@@ -233,17 +209,10 @@ struct SquareAABB : public BoundingVolume
 		const glm::vec3 up = transform.getUp() * extent;
 		const glm::vec3 forward = transform.getForward() * extent;
 
-		const float newIi = std::abs(glm::dot(glm::vec3{ 1.f, 0.f, 0.f }, right)) +
-			std::abs(glm::dot(glm::vec3{ 1.f, 0.f, 0.f }, up)) +
-			std::abs(glm::dot(glm::vec3{ 1.f, 0.f, 0.f }, forward));
-
-		const float newIj = std::abs(glm::dot(glm::vec3{ 0.f, 1.f, 0.f }, right)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 1.f, 0.f }, up)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 1.f, 0.f }, forward));
-
-		const float newIk = std::abs(glm::dot(glm::vec3{ 0.f, 0.f, 1.f }, right)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 0.f, 1.f }, up)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 0.f, 1.f }, forward));
+		// Projection of the oriented extents on the world axes
+		const float newIi = std::abs(right.x) + std::abs(up.x) + std::abs(forward.x);
+		const float newIj = std::abs(right.y) + std::abs(up.y) + std::abs(forward.y);
+		const float newIk = std::abs(right.z) + std::abs(up.z) + std::abs(forward.z);
 
 		const SquareAABB globalAABB(globalCenter, std::max(std::max(newIi, newIj), newIk));
 
@@ -303,17 +272,10 @@ struct AABB : public BoundingVolume
 		const glm::vec3 up = transform.getUp() * extents.y;
 		const glm::vec3 forward = transform.getForward() * extents.z;
 
-		const float newIi = std::abs(glm::dot(glm::vec3{ 1.f, 0.f, 0.f }, right)) +
-			std::abs(glm::dot(glm::vec3{ 1.f, 0.f, 0.f }, up)) +
-			std::abs(glm::dot(glm::vec3{ 1.f, 0.f, 0.f }, forward));
-
-		const float newIj = std::abs(glm::dot(glm::vec3{ 0.f, 1.f, 0.f }, right)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 1.f, 0.f }, up)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 1.f, 0.f }, forward));
-
-		const float newIk = std::abs(glm::dot(glm::vec3{ 0.f, 0.f, 1.f }, right)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 0.f, 1.f }, up)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 0.f, 1.f }, forward));
+		// Projection of the oriented extents on the world axes
+		const float newIi = std::abs(right.x) + std::abs(up.x) + std::abs(forward.x);
+		const float newIj = std::abs(right.y) + std::abs(up.y) + std::abs(forward.y);
+		const float newIk = std::abs(right.z) + std::abs(up.z) + std::abs(forward.z);
 
 		const AABB globalAABB(globalCenter, newIi, newIj, newIk);
 
@@ -396,6 +358,17 @@ public:
 	Model* pModel = nullptr;
 	std::unique_ptr<AABB> boundingVolume;
 
+	//World space bounds cached by the last transform update
+	AABB worldAABB{ glm::vec3(0.f), 0.f, 0.f, 0.f };
+
+	//Optional bounding volume hierarchy this entity is registered in
+	DynamicBVH* pBVH = nullptr;
+	int bvhProxy = DynamicBVH::nullNode;
+
+	//Optional SoA bounds array used by the batch culling kernels
+	BoundsSoA* pBoundsSoA = nullptr;
+	unsigned int boundsIndex = 0;
+
 
 	// constructor, expects a filepath to a 3D model.
 	Entity(Model& model) : pModel{ &model }
@@ -404,7 +377,7 @@ public:
 		//boundingVolume = std::make_unique<Sphere>(generateSphereBV(model));
 	}
 
-	AABB getGlobalAABB()
+	AABB getGlobalAABB() const
 	{
 		//Get global scale thanks to our transform
 		const glm::vec3 globalCenter{ transform.getModelMatrix() * glm::vec4(boundingVolume->center, 1.f) };
@@ -414,19 +387,11 @@ public:
 		const glm::vec3 up = transform.getUp() * boundingVolume->extents.y;
 		const glm::vec3 forward = transform.getForward() * boundingVolume->extents.z;
 
-		const float newIi = std::abs(glm::dot(glm::vec3{ 1.f, 0.f, 0.f }, right)) +
-			std::abs(glm::dot(glm::vec3{ 1.f, 0.f, 0.f }, up)) +
-			std::abs(glm::dot(glm::vec3{ 1.f, 0.f, 0.f }, forward));
-
-		const float newIj = std::abs(glm::dot(glm::vec3{ 0.f, 1.f, 0.f }, right)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 1.f, 0.f }, up)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 1.f, 0.f }, forward));
-
-		const float newIk = std::abs(glm::dot(glm::vec3{ 0.f, 0.f, 1.f }, right)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 0.f, 1.f }, up)) +
-			std::abs(glm::dot(glm::vec3{ 0.f, 0.f, 1.f }, forward));
-
-		return AABB(globalCenter, newIi, newIj, newIk);
+		// Projection of the oriented extents on the world axes
+		return AABB(globalCenter,
+			std::abs(right.x) + std::abs(up.x) + std::abs(forward.x),
+			std::abs(right.y) + std::abs(up.y) + std::abs(forward.y),
+			std::abs(right.z) + std::abs(up.z) + std::abs(forward.z));
 	}
 
 	//Add child. Argument input is argument of any constructor that you create. By default you can use the default constructor and don't put argument input.
@@ -437,6 +402,58 @@ public:
 		children.back()->parent = this;
 	}
 
+	//Register self and children as leaves of the BVH. Their proxies are refit each time their transform is updated.
+	void addSelfAndChildToBVH(DynamicBVH& bvh)
+	{
+		pBVH = &bvh;
+		bvhProxy = bvh.createProxy(worldAABB.center - worldAABB.extents, worldAABB.center + worldAABB.extents, this);
+
+		for (auto&& child : children)
+		{
+			child->addSelfAndChildToBVH(bvh);
+		}
+	}
+
+	//Remove self and children from the BVH they were registered in. The BVH is owned by the caller, entities never
+	//touch it on destruction, so unregister them before dropping them from a BVH that lives on.
+	void removeSelfAndChildFromBVH()
+	{
+		if (pBVH)
+		{
+			pBVH->destroyProxy(bvhProxy);
+			pBVH = nullptr;
+			bvhProxy = DynamicBVH::nullNode;
+		}
+
+		for (auto&& child : children)
+		{
+			child->removeSelfAndChildFromBVH();
+		}
+	}
+
+	//Register self and children in the SoA bounds array. Their entry is rewritten each time their transform is updated.
+	void addSelfAndChildToBoundsSoA(BoundsSoA& bounds)
+	{
+		pBoundsSoA = &bounds;
+		boundsIndex = bounds.add(worldAABB.center, worldAABB.extents, this);
+
+		for (auto&& child : children)
+		{
+			child->addSelfAndChildToBoundsSoA(bounds);
+		}
+	}
+
+	//Append self and children to a flat list, in depth first order
+	void collectSelfAndChild(std::vector<Entity*>& entities)
+	{
+		entities.push_back(this);
+
+		for (auto&& child : children)
+		{
+			child->collectSelfAndChild(entities);
+		}
+	}
+
 	//Update transform if it was changed
 	void updateSelfAndChild()
 	{
@@ -459,6 +476,12 @@ public:
 		else
 			transform.computeModelMatrix();
 
+		worldAABB = getGlobalAABB();
+		if (pBVH)
+			pBVH->moveProxy(bvhProxy, worldAABB.center - worldAABB.extents, worldAABB.center + worldAABB.extents);
+		if (pBoundsSoA)
+			pBoundsSoA->set(boundsIndex, worldAABB.center, worldAABB.extents);
+
 		for (auto&& child : children)
 		{
 			child->forceUpdateSelfAndChild();
@@ -466,6 +489,22 @@ public:
 	}
 
 
+	//Same traversal as drawSelfAndChild, but visible entities are emitted to the render queue instead of drawn
+	void submitSelfAndChild(const Frustum& frustum, RenderQueue& queue, Shader& ourShader, unsigned int& display, unsigned int& total)
+	{
+		if (boundingVolume->isOnFrustum(frustum, transform))
+		{
+			queue.submit(*pModel, ourShader, transform.getModelMatrix());
+			display++;
+		}
+		total++;
+
+		for (auto&& child : children)
+		{
+			child->submitSelfAndChild(frustum, queue, ourShader, display, total);
+		}
+	}
+
 	void drawSelfAndChild(const Frustum& frustum, Shader& ourShader, unsigned int& display, unsigned int& total)
 	{
 		if (boundingVolume->isOnFrustum(frustum, transform))
@@ -482,4 +521,56 @@ public:
 		}
 	}
 };
+
+//Gather the entities of the BVH that intersect the frustum. Only the nodes straddling the frustum are tested.
+void gatherVisibleFromBVH(const DynamicBVH& bvh, const Frustum& frustum, std::vector<Entity*>& visibleEntities, BVHStats& stats)
+{
+	bvh.queryFrustum(frustum, [&visibleEntities](void* userData)
+		{
+			visibleEntities.push_back(static_cast<Entity*>(userData));
+		}, stats);
+}
+
+//Gather the entities of the SoA bounds array that intersect the frustum, tested 4 or 8 at a time.
+//visibleIndices is scratch memory reused between frames.
+void gatherVisibleFromBoundsSoA(const BoundsSoA& bounds, const Frustum& frustum, std::vector<Entity*>& visibleEntities, std::vector<unsigned int>& visibleIndices)
+{
+	visibleIndices.resize(bounds.count + 8);
+	const unsigned int visibleCount = cullBounds(frustum, bounds, visibleIndices.data());
+	for (unsigned int i = 0; i < visibleCount; ++i)
+		visibleEntities.push_back(static_cast<Entity*>(bounds.userData[visibleIndices[i]]));
+}
+
+//Record the draws of the entities [begin, end) whose cached world bounds intersect the frustum and return their count.
+//Only reads entity data and writes to the command list, so each worker thread can record its own slice.
+unsigned int recordVisibleEntities(Entity* const* entities, unsigned int begin, unsigned int end, const Frustum& frustum, CommandList& commandList)
+{
+	unsigned int display = 0;
+	for (unsigned int i = begin; i < end; ++i)
+	{
+		const AABB& bounds = entities[i]->worldAABB;
+		if (!(bounds.isOnOrForwardPlane(frustum.leftFace) &&
+			bounds.isOnOrForwardPlane(frustum.rightFace) &&
+			bounds.isOnOrForwardPlane(frustum.topFace) &&
+			bounds.isOnOrForwardPlane(frustum.bottomFace) &&
+			bounds.isOnOrForwardPlane(frustum.nearFace) &&
+			bounds.isOnOrForwardPlane(frustum.farFace)))
+			continue;
+
+		commandList.setMat4("model", entities[i]->transform.getModelMatrix());
+		for (Mesh& mesh : entities[i]->pModel->meshes)
+		{
+			commandList.bindTextures(mesh);
+			commandList.drawMesh(mesh);
+		}
+		display++;
+	}
+	return display;
+}
+
+void submitEntities(const std::vector<Entity*>& entities, RenderQueue& queue, Shader& ourShader)
+{
+	for (Entity* entity : entities)
+		queue.submit(*entity->pModel, ourShader, entity->transform.getModelMatrix());
+}
 #endif
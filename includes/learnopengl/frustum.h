@@ -0,0 +1,63 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp> //glm::vec3
+
+struct Plane
+{
+	glm::vec3 normal = { 0.f, 1.f, 0.f }; // unit vector
+	float     distance = 0.f;        // Distance with origin
+
+	Plane() = default;
+
+	Plane(const glm::vec3& p1, const glm::vec3& norm)
+		: normal(glm::normalize(norm)),
+		distance(glm::dot(normal, p1))
+	{}
+
+	float getSignedDistanceToPlane(const glm::vec3& point) const
+	{
+		return glm::dot(normal, point) - distance;
+	}
+};
+
+struct Frustum
+{
+	Plane topFace;
+	Plane bottomFace;
+
+	Plane rightFace;
+	Plane leftFace;
+
+	Plane farFace;
+	Plane nearFace;
+};
+
+//Extract the six planes of a view-projection matrix (Gribb & Hartmann). Normals point inside the frustum.
+//With a combined projection * view matrix the planes are in world space, with projection * view * model in model space.
+Frustum createFrustumFromMatrix(const glm::mat4& m)
+{
+	const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+	auto makePlane = [](const glm::vec4& coefficients)
+	{
+		const float length = glm::length(glm::vec3(coefficients));
+		Plane plane;
+		plane.normal = glm::vec3(coefficients) / length;
+		plane.distance = -coefficients.w / length;
+		return plane;
+	};
+
+	Frustum frustum;
+	frustum.leftFace = makePlane(row3 + row0);
+	frustum.rightFace = makePlane(row3 - row0);
+	frustum.bottomFace = makePlane(row3 + row1);
+	frustum.topFace = makePlane(row3 - row1);
+	frustum.nearFace = makePlane(row3 + row2);
+	frustum.farFace = makePlane(row3 - row2);
+	return frustum;
+}
+#endif
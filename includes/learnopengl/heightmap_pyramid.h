@@ -0,0 +1,395 @@
+#ifndef HEIGHTMAP_PYRAMID_H
+#define HEIGHTMAP_PYRAMID_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <learnopengl/terrain_shading.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// most levels a pyramid can have, a 2^20 samples wide terrain with 32 sample patches needs 16
+#define HEIGHTMAP_PYRAMID_MAX_LEVELS 16
+
+// Read only memory mapping of a whole file. Pages are only read from disk when touched, so files larger than RAM work.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    bool Open(const char *path)
+    {
+        Close();
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        size = static_cast<size_t>(fileSize.QuadPart);
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL)
+            data = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+        descriptor = open(path, O_RDONLY);
+        if (descriptor < 0)
+            return false;
+        struct stat status;
+        fstat(descriptor, &status);
+        size = static_cast<size_t>(status.st_size);
+        void *view = size > 0 ? mmap(NULL, size, PROT_READ, MAP_SHARED, descriptor, 0) : MAP_FAILED;
+        if (view != MAP_FAILED)
+            data = static_cast<const unsigned char*>(view);
+#endif
+        if (!data)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data)
+            munmap(const_cast<unsigned char*>(data), size);
+        if (descriptor >= 0)
+            close(descriptor);
+        descriptor = -1;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const unsigned char *Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int descriptor = -1;
+#endif
+};
+
+// lowest and highest sample of a terrain node
+struct HeightRange {
+    uint16_t minimum;
+    uint16_t maximum;
+};
+
+// How a heightmap is cooked and where it sits in the world: sample (row, column) of level 0 is at
+// origin + (row * sampleSpacing, sample / 65535 * heightScale + heightOffset, column * sampleSpacing).
+struct HeightmapPyramidSettings {
+    unsigned int tileSize = 256;        // samples per tile side, tiles store one more row and column shared with their neighbours
+    unsigned int patchResolution = 32;  // samples per side of the finest terrain nodes the height ranges are computed for
+    float sampleSpacing = 1.0f;
+    float heightScale = 1.0f;
+    float heightOffset = 0.0f;
+    glm::vec2 origin = glm::vec2(0.0f);
+    unsigned int aoRadius = 16;         // samples the ambient occlusion looks for horizons over, 0 for none
+};
+
+// On disk layout, little endian:
+//  header
+//  for every level, the HeightRange of its nodes (nodesX * nodesZ, z major)
+//  for every level, its tiles ((tileSize + 1)^2 samples, row major), tile (x, z) being the (x * tilesZ + z)th
+//  for every level, the shading of its tiles: the same texels packed by packTerrainShading (normal and occlusion)
+//  Levels start on 4096 byte boundaries so a tile never shares a page with the height ranges.
+struct HeightmapPyramidHeader {
+    char magic[4];                      // "HPYR"
+    uint32_t version;
+    uint32_t rows;                      // of level 0
+    uint32_t columns;
+    uint32_t tileSize;
+    uint32_t patchResolution;
+    uint32_t levelCount;
+    uint32_t aoRadius;
+    float sampleSpacing;
+    float heightScale;
+    float heightOffset;
+    float originX;
+    float originZ;
+    uint32_t padding[3];
+    uint64_t rangeOffsets[HEIGHTMAP_PYRAMID_MAX_LEVELS];
+    uint64_t tileOffsets[HEIGHTMAP_PYRAMID_MAX_LEVELS];
+    uint64_t shadingOffsets[HEIGHTMAP_PYRAMID_MAX_LEVELS];
+};
+
+// Dimensions of the levels. Level l keeps every 2^l th sample of level 0 (no filtering), so the vertices of a coarser
+// terrain patch land exactly on samples of the finer levels and the levels stay crack free when morphing between them.
+struct HeightmapPyramidLayout {
+    unsigned int rows, columns, tileSize, patchResolution, levelCount;
+
+    HeightmapPyramidLayout(unsigned int rows, unsigned int columns, unsigned int tileSize, unsigned int patchResolution)
+        : rows(rows), columns(columns), tileSize(tileSize), patchResolution(patchResolution), levelCount(1)
+    {
+        while ((NodesX(levelCount - 1) > 1 || NodesZ(levelCount - 1) > 1) && levelCount < HEIGHTMAP_PYRAMID_MAX_LEVELS)
+            levelCount++;
+    }
+
+    unsigned int LevelRows(unsigned int level) const { return ((rows - 1) >> level) + 1; }
+    unsigned int LevelColumns(unsigned int level) const { return ((columns - 1) >> level) + 1; }
+    unsigned int TilesX(unsigned int level) const { return std::max(1u, (LevelRows(level) - 1 + tileSize - 1) / tileSize); }
+    unsigned int TilesZ(unsigned int level) const { return std::max(1u, (LevelColumns(level) - 1 + tileSize - 1) / tileSize); }
+    unsigned int NodesX(unsigned int level) const { return std::max(1u, (rows - 1 + (patchResolution << level) - 1) / (patchResolution << level)); }
+    unsigned int NodesZ(unsigned int level) const { return std::max(1u, (columns - 1 + (patchResolution << level) - 1) / (patchResolution << level)); }
+    size_t TileSamples() const { return (size_t)(tileSize + 1) * (tileSize + 1); }
+};
+
+// A cooked heightmap, memory mapped. Only the pages of the tiles that are read get loaded.
+class HeightmapPyramid {
+public:
+    HeightmapPyramidHeader Header;
+
+    bool Open(const char *path)
+    {
+        if (!file.Open(path) || file.Size() < sizeof(HeightmapPyramidHeader))
+            return false;
+        std::memcpy(&Header, file.Data(), sizeof(HeightmapPyramidHeader));
+        if (std::memcmp(Header.magic, "HPYR", 4) != 0 || Header.version != 2 || Header.levelCount > HEIGHTMAP_PYRAMID_MAX_LEVELS)
+        {
+            file.Close();
+            return false;
+        }
+        layout = HeightmapPyramidLayout(Header.rows, Header.columns, Header.tileSize, Header.patchResolution);
+        return true;
+    }
+
+    const HeightmapPyramidLayout &Layout() const { return layout; }
+    unsigned int LevelCount() const { return Header.levelCount; }
+    size_t FileSize() const { return file.Size(); }
+
+    glm::vec2 Origin() const { return glm::vec2(Header.originX, Header.originZ); }
+
+    float ToHeight(uint16_t sample) const
+    {
+        return sample / 65535.0f * Header.heightScale + Header.heightOffset;
+    }
+
+    // height range of node (x, z) of a level
+    const HeightRange &Range(unsigned int level, unsigned int x, unsigned int z) const
+    {
+        const HeightRange *ranges = reinterpret_cast<const HeightRange*>(file.Data() + Header.rangeOffsets[level]);
+        return ranges[(size_t)z * layout.NodesX(level) + x];
+    }
+
+    // (tileSize + 1)^2 samples, row major
+    const uint16_t *Tile(unsigned int level, unsigned int tileX, unsigned int tileZ) const
+    {
+        const size_t index = (size_t)tileX * layout.TilesZ(level) + tileZ;
+        return reinterpret_cast<const uint16_t*>(file.Data() + Header.tileOffsets[level] + index * layout.TileSamples() * sizeof(uint16_t));
+    }
+
+    // normals and occlusion of a tile, (tileSize + 1)^2 RGBA8 texels
+    const uint32_t *ShadingTile(unsigned int level, unsigned int tileX, unsigned int tileZ) const
+    {
+        const size_t index = (size_t)tileX * layout.TilesZ(level) + tileZ;
+        return reinterpret_cast<const uint32_t*>(file.Data() + Header.shadingOffsets[level] + index * layout.TileSamples() * sizeof(uint32_t));
+    }
+
+    // sample (row, column) of a level, in the coordinates of that level
+    uint16_t Sample(unsigned int level, unsigned int row, unsigned int column) const
+    {
+        row = std::min(row, layout.LevelRows(level) - 1);
+        column = std::min(column, layout.LevelColumns(level) - 1);
+        const unsigned int tileX = std::min(row / layout.tileSize, layout.TilesX(level) - 1);
+        const unsigned int tileZ = std::min(column / layout.tileSize, layout.TilesZ(level) - 1);
+        return Tile(level, tileX, tileZ)[(size_t)(row - tileX * layout.tileSize) * (layout.tileSize + 1) + (column - tileZ * layout.tileSize)];
+    }
+
+private:
+    MappedFile file;
+    HeightmapPyramidLayout layout = HeightmapPyramidLayout(2, 2, 1, 1);
+};
+
+// Cook rows * columns samples (row major) into a pyramid file. The samples are read tile by tile and the output is
+// written as it goes, so a memory mapped raw source larger than RAM can be cooked.
+bool cookHeightmapPyramid(const uint16_t *samples, unsigned int rows, unsigned int columns, const char *outputPath, const HeightmapPyramidSettings &settings = HeightmapPyramidSettings())
+{
+    // a terrain patch must read all its samples from a single tile
+    if (rows < 2 || columns < 2 || settings.patchResolution == 0 || settings.tileSize % settings.patchResolution != 0)
+        return false;
+    const HeightmapPyramidLayout layout(rows, columns, settings.tileSize, settings.patchResolution);
+    FILE *output = std::fopen(outputPath, "wb");
+    if (!output)
+        return false;
+
+    HeightmapPyramidHeader header = {};
+    std::memcpy(header.magic, "HPYR", 4);
+    header.version = 2;
+    header.rows = rows;
+    header.columns = columns;
+    header.tileSize = settings.tileSize;
+    header.patchResolution = settings.patchResolution;
+    header.levelCount = layout.levelCount;
+    header.sampleSpacing = settings.sampleSpacing;
+    header.heightScale = settings.heightScale;
+    header.heightOffset = settings.heightOffset;
+    header.originX = settings.origin.x;
+    header.originZ = settings.origin.y;
+    header.aoRadius = settings.aoRadius;
+
+    auto align = [](uint64_t offset) { return (offset + 4095) & ~uint64_t(4095); };
+    uint64_t offset = sizeof(HeightmapPyramidHeader);
+    for (unsigned int level = 0; level < layout.levelCount; level++)
+    {
+        header.rangeOffsets[level] = offset;
+        offset += (uint64_t)layout.NodesX(level) * layout.NodesZ(level) * sizeof(HeightRange);
+    }
+    for (unsigned int level = 0; level < layout.levelCount; level++)
+    {
+        offset = align(offset);
+        header.tileOffsets[level] = offset;
+        offset += (uint64_t)layout.TilesX(level) * layout.TilesZ(level) * layout.TileSamples() * sizeof(uint16_t);
+    }
+    for (unsigned int level = 0; level < layout.levelCount; level++)
+    {
+        offset = align(offset);
+        header.shadingOffsets[level] = offset;
+        offset += (uint64_t)layout.TilesX(level) * layout.TilesZ(level) * layout.TileSamples() * sizeof(uint32_t);
+    }
+    std::fwrite(&header, sizeof(header), 1, output);
+
+    // height ranges of the finest nodes, which cover patchResolution + 1 samples per side and share their border
+    // samples with their neighbours, then of every level up from the one below
+    std::vector<std::vector<HeightRange>> ranges(layout.levelCount);
+    const unsigned int patch = settings.patchResolution;
+    ranges[0].assign((size_t)layout.NodesX(0) * layout.NodesZ(0), HeightRange{ 0xFFFF, 0 });
+    for (unsigned int row = 0; row < rows; row++)
+    {
+        const unsigned int firstX = row == 0 ? 0 : (row - 1) / patch;
+        const unsigned int lastX = std::min(row / patch, layout.NodesX(0) - 1);
+        const uint16_t *sampleRow = samples + (size_t)row * columns;
+        for (unsigned int x = firstX; x <= lastX; x++)
+        {
+            for (unsigned int z = 0; z < layout.NodesZ(0); z++)
+            {
+                const unsigned int first = z * patch;
+                const unsigned int last = std::min(first + patch, columns - 1);
+                HeightRange &range = ranges[0][(size_t)z * layout.NodesX(0) + x];
+                for (unsigned int column = first; column <= last; column++)
+                {
+                    range.minimum = std::min(range.minimum, sampleRow[column]);
+                    range.maximum = std::max(range.maximum, sampleRow[column]);
+                }
+            }
+        }
+    }
+    for (unsigned int level = 1; level < layout.levelCount; level++)
+    {
+        ranges[level].assign((size_t)layout.NodesX(level) * layout.NodesZ(level), HeightRange{ 0xFFFF, 0 });
+        for (unsigned int z = 0; z < layout.NodesZ(level - 1); z++)
+        {
+            for (unsigned int x = 0; x < layout.NodesX(level - 1); x++)
+            {
+                const HeightRange &child = ranges[level - 1][(size_t)z * layout.NodesX(level - 1) + x];
+                HeightRange &range = ranges[level][(size_t)(z / 2) * layout.NodesX(level) + x / 2];
+                range.minimum = std::min(range.minimum, child.minimum);
+                range.maximum = std::max(range.maximum, child.maximum);
+            }
+        }
+    }
+    for (unsigned int level = 0; level < layout.levelCount; level++)
+        std::fwrite(ranges[level].data(), sizeof(HeightRange), ranges[level].size(), output);
+
+    // tiles, past the end of a level the last row/column is repeated
+    std::vector<uint16_t> tile(layout.TileSamples());
+    uint64_t written = header.rangeOffsets[layout.levelCount - 1] + ranges[layout.levelCount - 1].size() * sizeof(HeightRange);
+    for (unsigned int level = 0; level < layout.levelCount; level++)
+    {
+        const std::vector<char> padding(header.tileOffsets[level] - written, 0);
+        std::fwrite(padding.data(), 1, padding.size(), output);
+        for (unsigned int tileX = 0; tileX < layout.TilesX(level); tileX++)
+        {
+            for (unsigned int tileZ = 0; tileZ < layout.TilesZ(level); tileZ++)
+            {
+                for (unsigned int i = 0; i <= settings.tileSize; i++)
+                {
+                    const unsigned int row = std::min(tileX * settings.tileSize + i, layout.LevelRows(level) - 1) << level;
+                    for (unsigned int j = 0; j <= settings.tileSize; j++)
+                    {
+                        const unsigned int column = std::min(tileZ * settings.tileSize + j, layout.LevelColumns(level) - 1) << level;
+                        tile[(size_t)i * (settings.tileSize + 1) + j] = samples[(size_t)row * columns + column];
+                    }
+                }
+                std::fwrite(tile.data(), sizeof(uint16_t), tile.size(), output);
+            }
+        }
+        written = header.tileOffsets[level] + (uint64_t)layout.TilesX(level) * layout.TilesZ(level) * layout.TileSamples() * sizeof(uint16_t);
+    }
+
+    // shading, from the heights of the level itself around each tile so coarse tiles get the normals of their own
+    // triangles, all cores shading the rows of a tile
+    ThreadPool pool;
+    const unsigned int margin = std::max(1u, settings.aoRadius);
+    TerrainHeightWindow window(settings.tileSize + 1, settings.tileSize + 1, margin);
+    std::vector<uint32_t> shading(layout.TileSamples());
+    for (unsigned int level = 0; level < layout.levelCount; level++)
+    {
+        const std::vector<char> padding(header.shadingOffsets[level] - written, 0);
+        std::fwrite(padding.data(), 1, padding.size(), output);
+        const int lastRow = static_cast<int>(layout.LevelRows(level)) - 1;
+        const int lastColumn = static_cast<int>(layout.LevelColumns(level)) - 1;
+        for (unsigned int tileX = 0; tileX < layout.TilesX(level); tileX++)
+        {
+            for (unsigned int tileZ = 0; tileZ < layout.TilesZ(level); tileZ++)
+            {
+                for (int i = -(int)margin; i < (int)(window.rows + margin); i++)
+                {
+                    const int row = std::min(std::max((int)(tileX * settings.tileSize) + i, 0), lastRow) << level;
+                    for (int j = -(int)margin; j < (int)(window.columns + margin); j++)
+                    {
+                        const int column = std::min(std::max((int)(tileZ * settings.tileSize) + j, 0), lastColumn) << level;
+                        window.At(i, j) = samples[(size_t)row * columns + column] / 65535.0f * settings.heightScale + settings.heightOffset;
+                    }
+                }
+                computeTerrainShading(window, settings.sampleSpacing * float(1u << level), settings.aoRadius, shading.data(), pool);
+                std::fwrite(shading.data(), sizeof(uint32_t), shading.size(), output);
+            }
+        }
+        written = header.shadingOffsets[level] + (uint64_t)layout.TilesX(level) * layout.TilesZ(level) * layout.TileSamples() * sizeof(uint32_t);
+    }
+
+    const bool ok = std::ferror(output) == 0;
+    std::fclose(output);
+    return ok;
+}
+#endif
@@ -0,0 +1,271 @@
+#ifndef HEIGHTMAP_TILE_CACHE_H
+#define HEIGHTMAP_TILE_CACHE_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <learnopengl/heightmap_pyramid.h>
+
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+
+struct HeightmapTileCacheStats {
+    unsigned int residentTiles = 0;
+    unsigned int pendingTiles = 0;      // requested and not resident yet, queued or being read
+    unsigned int uploadedTiles = 0;     // during the last Update
+    unsigned int fallbackPatches = 0;   // patches drawn with a coarser tile than their own since the last BeginFrame
+};
+
+// the tile a patch is drawn with, a layer of the cache's texture array covering level-0 samples
+// [originRow, originRow + tileSize * spacing] x [originColumn, originColumn + tileSize * spacing]
+struct HeightmapTileRef {
+    unsigned int layer;
+    unsigned int originRow;
+    unsigned int originColumn;
+    unsigned int spacing;
+};
+
+// Keeps the tiles of a HeightmapPyramid the camera currently needs in the layers of a GL_R16 texture array, their
+// normals and occlusion in the same layer of a GL_RGBA8 one. Tiles
+// that are asked for and not resident are read from the memory mapped file on worker threads, which is where the
+// page faults happen, and uploaded by Update() on the GL thread, a bounded number per frame. Until then Request()
+// hands out the closest resident ancestor, the single tile of the coarsest level never being evicted so there always
+// is one. When the layers run out the least recently used tile goes.
+//
+// Per frame: BeginFrame(), Request() for every patch, Update().
+class HeightmapTileCache {
+public:
+    unsigned int TextureArray;
+    unsigned int ShadingArray;
+    unsigned int LayerCount;
+
+    HeightmapTileCache(const HeightmapPyramid &pyramid, unsigned int layerCount = 256, unsigned int workerCount = 2)
+        : LayerCount(std::max(2u, layerCount)), pyramid(pyramid), layers(LayerCount)
+    {
+        TextureArray = createArray(GL_R16, GL_RED, GL_UNSIGNED_SHORT);
+        ShadingArray = createArray(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+
+        for (unsigned int layer = 0; layer < LayerCount; layer++)
+            freeLayers.push_back(LayerCount - 1 - layer);
+
+        // the root is read right away and pinned
+        LoadedTile root;
+        root.key = tileKey(pyramid.LevelCount() - 1, 0, 0);
+        readTile(root);
+        upload(root, true);
+
+        for (unsigned int i = 0; i < std::max(1u, workerCount); i++)
+            workers.emplace_back(&HeightmapTileCache::workerLoop, this);
+    }
+
+    ~HeightmapTileCache()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+        glDeleteTextures(1, &TextureArray);
+        glDeleteTextures(1, &ShadingArray);
+    }
+
+    void BeginFrame()
+    {
+        frame++;
+        wanted.clear();
+        stats.fallbackPatches = 0;
+    }
+
+    // the tile to draw a patch of a level with, whose first level-0 sample is (row, column). Its own tile when resident,
+    // otherwise the closest resident ancestor, the own tile then being loaded.
+    HeightmapTileRef Request(unsigned int level, unsigned int row, unsigned int column)
+    {
+        const HeightmapPyramidLayout &layout = pyramid.Layout();
+        const unsigned int tileX = (row >> level) / layout.tileSize;
+        const unsigned int tileZ = (column >> level) / layout.tileSize;
+        for (unsigned int ancestor = level; ancestor < pyramid.LevelCount(); ancestor++)
+        {
+            const uint64_t key = tileKey(ancestor, tileX >> (ancestor - level), tileZ >> (ancestor - level));
+            auto found = resident.find(key);
+            if (found == resident.end())
+            {
+                wanted.push_back(key);
+                continue;
+            }
+            if (ancestor != level)
+                stats.fallbackPatches++;
+            Layer &layer = layers[found->second];
+            layer.lastUsed = frame;
+            const unsigned int size = layout.tileSize << ancestor;
+            return HeightmapTileRef{ found->second, (tileX >> (ancestor - level)) * size, (tileZ >> (ancestor - level)) * size, 1u << ancestor };
+        }
+        // not reached, the root is always resident
+        return HeightmapTileRef{ 0, 0, 0, 1u << (pyramid.LevelCount() - 1) };
+    }
+
+    // upload up to maxUploads finished tiles and hand this frame's missing tiles to the workers, coarsest first
+    void Update(unsigned int maxUploads = 8)
+    {
+        std::vector<LoadedTile> finished;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const size_t count = std::min<size_t>(maxUploads, completed.size());
+            finished.assign(std::make_move_iterator(completed.begin()), std::make_move_iterator(completed.begin() + count));
+            completed.erase(completed.begin(), completed.begin() + count);
+
+            // requests still waiting for a worker are withdrawn and queued again if still wanted, tiles a worker is
+            // reading stay in loading and are not asked for twice
+            for (uint64_t key : requests)
+                loading.erase(key);
+            requests.clear();
+            std::sort(wanted.begin(), wanted.end(), std::greater<uint64_t>()); // the level is in the high bits
+            wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+            for (uint64_t key : wanted)
+            {
+                if (loading.insert(key).second)
+                    requests.push_back(key);
+            }
+        }
+        if (!wanted.empty())
+            wakeUp.notify_all();
+
+        stats.uploadedTiles = 0;
+        for (LoadedTile &tile : finished)
+        {
+            if (upload(tile, false))
+                stats.uploadedTiles++;
+            loading.erase(tile.key);
+        }
+        stats.residentTiles = static_cast<unsigned int>(resident.size());
+        stats.pendingTiles = static_cast<unsigned int>(loading.size());
+    }
+
+    const HeightmapTileCacheStats &GetStats() const { return stats; }
+
+private:
+    struct Layer {
+        uint64_t key = 0;
+        uint64_t lastUsed = 0;
+        bool pinned = false;
+    };
+
+    struct LoadedTile {
+        uint64_t key;
+        std::vector<uint16_t> samples;
+        std::vector<uint32_t> shading;
+    };
+
+    const HeightmapPyramid &pyramid;
+    std::vector<Layer> layers;
+    std::vector<unsigned int> freeLayers;
+    std::unordered_map<uint64_t, unsigned int> resident; // tile key to layer
+    std::unordered_set<uint64_t> loading;                // queued or being read
+    std::vector<uint64_t> wanted;
+    uint64_t frame = 0;
+    HeightmapTileCacheStats stats;
+
+    // shared with the workers, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::deque<uint64_t> requests;
+    std::vector<LoadedTile> completed;
+    std::vector<std::thread> workers;
+    bool quit = false;
+
+    static uint64_t tileKey(unsigned int level, unsigned int tileX, unsigned int tileZ)
+    {
+        return (uint64_t(level) << 48) | (uint64_t(tileX) << 24) | uint64_t(tileZ);
+    }
+
+    void readTile(LoadedTile &tile) const
+    {
+        const unsigned int level = static_cast<unsigned int>(tile.key >> 48);
+        const unsigned int tileX = static_cast<unsigned int>((tile.key >> 24) & 0xFFFFFF);
+        const unsigned int tileZ = static_cast<unsigned int>(tile.key & 0xFFFFFF);
+        tile.samples.resize(pyramid.Layout().TileSamples());
+        std::memcpy(tile.samples.data(), pyramid.Tile(level, tileX, tileZ), tile.samples.size() * sizeof(uint16_t));
+        tile.shading.resize(pyramid.Layout().TileSamples());
+        std::memcpy(tile.shading.data(), pyramid.ShadingTile(level, tileX, tileZ), tile.shading.size() * sizeof(uint32_t));
+    }
+
+    // put a tile into a free layer or the least recently used one, false if every layer is in use this frame
+    bool upload(const LoadedTile &tile, bool pin)
+    {
+        unsigned int target;
+        if (!freeLayers.empty())
+        {
+            target = freeLayers.back();
+            freeLayers.pop_back();
+        }
+        else
+        {
+            target = LayerCount;
+            for (unsigned int layer = 0; layer < LayerCount; layer++)
+            {
+                if (!layers[layer].pinned && layers[layer].lastUsed < frame && (target == LayerCount || layers[layer].lastUsed < layers[target].lastUsed))
+                    target = layer;
+            }
+            if (target == LayerCount)
+                return false;
+            resident.erase(layers[target].key);
+        }
+
+        layers[target].key = tile.key;
+        layers[target].lastUsed = frame;
+        layers[target].pinned = pin;
+        resident[tile.key] = target;
+
+        const unsigned int tileSamples = pyramid.Layout().tileSize + 1;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, TextureArray);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, target, tileSamples, tileSamples, 1, GL_RED, GL_UNSIGNED_SHORT, tile.samples.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, ShadingArray);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, target, tileSamples, tileSamples, 1, GL_RGBA, GL_UNSIGNED_BYTE, tile.shading.data());
+        return true;
+    }
+
+    unsigned int createArray(GLenum internalFormat, GLenum format, GLenum type)
+    {
+        const unsigned int tileSamples = pyramid.Layout().tileSize + 1;
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, tileSamples, tileSamples, LayerCount, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            LoadedTile tile;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this]() { return quit || !requests.empty(); });
+                if (quit)
+                    return;
+                tile.key = requests.front();
+                requests.pop_front();
+            }
+            readTile(tile);
+            std::lock_guard<std::mutex> lock(mutex);
+            completed.push_back(std::move(tile));
+        }
+    }
+};
+#endif
@@ -0,0 +1,186 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+// Octahedral impostor of a model: the model is rendered once from gridSize x gridSize view directions laid out on an
+// octahedral map (a hemi-octahedron when only the upper hemisphere is ever seen), each view being one frame of an albedo,
+// a normal and a depth atlas. At runtime a distant instance is a single camera facing quad that blends the frames of
+// the views closest to its view direction.
+//
+// Frame (i, j) looks at the model from DecodeDirection((i, j) / (gridSize - 1)), with the model's +y as up vector (or
+// +z when looking along y). The atlases hold, for every texel:
+//  albedo : rgb diffuse color, a coverage
+//  normal : object space normal * 0.5 + 0.5
+//  depth  : distance in front of the model's center along the view direction, divided by radius (so in [-1, 1])
+class Impostor {
+public:
+    unsigned int AlbedoAtlas;
+    unsigned int NormalAtlas;
+    unsigned int DepthAtlas;
+    unsigned int GridSize;
+    unsigned int FrameResolution;
+    bool Hemisphere;
+    // bounding sphere of the model, in object space
+    glm::vec3 Center;
+    float Radius;
+    // the quad to draw the instances with, corners in [-1, 1] on xy
+    Mesh Quad;
+
+    // bake the impostor of the model. The bake shader receives "view", "projection" (orthographic) and "radius", has
+    // the model's textures bound like Mesh::Draw does and writes albedo, normal and depth to its outputs 0, 1 and 2.
+    Impostor(Model &model, Shader &bakeShader, unsigned int gridSize = 16, unsigned int frameResolution = 64, bool hemisphere = false)
+        : GridSize(gridSize), FrameResolution(frameResolution), Hemisphere(hemisphere), Quad(createQuad())
+    {
+        computeBounds(model);
+        bake(model, bakeShader);
+    }
+
+    // view direction (from the model towards the viewer, object space) of the point uv in [0, 1]^2 of the octahedral map
+    static glm::vec3 DecodeDirection(glm::vec2 uv, bool hemisphere)
+    {
+        glm::vec2 p = uv * 2.0f - 1.0f;
+        if (hemisphere)
+            p = glm::vec2(p.x + p.y, p.x - p.y) * 0.5f;
+        glm::vec3 direction(p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y);
+        if (direction.y < 0.0f)
+        {
+            // lower half of the octahedron, folded over the diagonals
+            const float x = (1.0f - std::abs(direction.z)) * (direction.x >= 0.0f ? 1.0f : -1.0f);
+            const float z = (1.0f - std::abs(direction.x)) * (direction.z >= 0.0f ? 1.0f : -1.0f);
+            direction.x = x;
+            direction.z = z;
+        }
+        return glm::normalize(direction);
+    }
+
+    // bind the atlases to texture units 0 to 2 and set the uniforms the impostor shader needs to pick and blend frames
+    void Bind(Shader &shader)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, AlbedoAtlas);
+        shader.setInt("albedoAtlas", 0);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, NormalAtlas);
+        shader.setInt("normalAtlas", 1);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, DepthAtlas);
+        shader.setInt("depthAtlas", 2);
+        glActiveTexture(GL_TEXTURE0);
+
+        shader.setFloat("gridSize", static_cast<float>(GridSize));
+        shader.setBool("hemisphere", Hemisphere);
+        shader.setVec3("impostorCenter", Center);
+        shader.setFloat("impostorRadius", Radius);
+    }
+
+private:
+    static Mesh createQuad()
+    {
+        vector<Vertex> vertices(4);
+        const glm::vec2 corners[4] = { glm::vec2(-1.0f, -1.0f), glm::vec2(1.0f, -1.0f), glm::vec2(1.0f, 1.0f), glm::vec2(-1.0f, 1.0f) };
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            vertices[i] = Vertex();
+            vertices[i].Position = glm::vec3(corners[i], 0.0f);
+            vertices[i].Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+            vertices[i].TexCoords = corners[i] * 0.5f + 0.5f;
+        }
+        return Mesh(vertices, { 0, 1, 2, 0, 2, 3 }, {});
+    }
+
+    void computeBounds(const Model &model)
+    {
+        glm::vec3 minimum(std::numeric_limits<float>::max()), maximum(-std::numeric_limits<float>::max());
+        for (const Mesh &mesh : model.meshes)
+        {
+            for (const Vertex &vertex : mesh.vertices)
+            {
+                minimum = glm::min(minimum, vertex.Position);
+                maximum = glm::max(maximum, vertex.Position);
+            }
+        }
+        Center = (minimum + maximum) * 0.5f;
+        Radius = 0.0f;
+        for (const Mesh &mesh : model.meshes)
+            for (const Vertex &vertex : mesh.vertices)
+                Radius = std::max(Radius, glm::length(vertex.Position - Center));
+    }
+
+    void bake(Model &model, Shader &bakeShader)
+    {
+        const unsigned int atlasSize = GridSize * FrameResolution;
+        AlbedoAtlas = createAtlas(atlasSize, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        NormalAtlas = createAtlas(atlasSize, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        DepthAtlas = createAtlas(atlasSize, GL_R16F, GL_RED, GL_FLOAT);
+
+        unsigned int fbo, depthRBO;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, AlbedoAtlas, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, NormalAtlas, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, DepthAtlas, 0);
+        unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+        glDrawBuffers(3, attachments);
+        glGenRenderbuffers(1, &depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Impostor framebuffer not complete!" << std::endl;
+
+        GLint previousViewport[4];
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        glViewport(0, 0, atlasSize, atlasSize);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // the model's center sits in the middle of the depth range, 2 * Radius in front of the camera
+        const glm::mat4 projection = glm::ortho(-Radius, Radius, -Radius, Radius, Radius, 3.0f * Radius);
+        bakeShader.use();
+        bakeShader.setMat4("projection", projection);
+        bakeShader.setFloat("radius", Radius);
+        for (unsigned int y = 0; y < GridSize; y++)
+        {
+            for (unsigned int x = 0; x < GridSize; x++)
+            {
+                const glm::vec3 direction = DecodeDirection(glm::vec2(x, y) / float(GridSize - 1), Hemisphere);
+                const glm::vec3 up = std::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+                bakeShader.setMat4("view", glm::lookAt(Center + direction * 2.0f * Radius, Center, up));
+                glViewport(x * FrameResolution, y * FrameResolution, FrameResolution, FrameResolution);
+                model.Draw(bakeShader);
+            }
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+        glDeleteRenderbuffers(1, &depthRBO);
+        glDeleteFramebuffers(1, &fbo);
+    }
+
+    static unsigned int createAtlas(unsigned int size, GLenum internalFormat, GLenum format, GLenum type)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size, size, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+};
+#endif
@@ -0,0 +1,129 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Mesh uses the attribute locations 0 to 6 for its own vertex data, instance attributes should start here.
+#define FIRST_INSTANCE_ATTRIBUTE 7
+
+// a single per-instance vertex attribute read from an instance buffer
+struct InstanceAttribute {
+    unsigned int location;
+    int          components; // 1 to 4
+    GLenum       type;       // GL_FLOAT, GL_HALF_FLOAT, GL_INT, GL_UNSIGNED_INT, GL_SHORT, ...
+    bool         normalized; // integer types read as normalized floats
+    bool         integer;    // integer types read as ints/uints in the shader (glVertexAttribIPointer)
+    unsigned int offset;     // in bytes, from the start of an instance
+    unsigned int divisor;    // instances per attribute value, usually 1
+};
+
+// describes how one instance record is laid out in its buffer
+class InstanceLayout {
+public:
+    std::vector<InstanceAttribute> attributes;
+    unsigned int stride;
+
+    InstanceLayout(unsigned int stride) : stride(stride) {}
+
+    InstanceLayout &Add(unsigned int location, int components, GLenum type, unsigned int offset, bool normalized = false, bool integer = false)
+    {
+        attributes.push_back({ location, components, type, normalized, integer, offset, 1 });
+        return *this;
+    }
+
+    // a mat4 takes 4 consecutive attribute locations, one per column
+    InstanceLayout &AddMat4(unsigned int location, unsigned int offset)
+    {
+        for (unsigned int i = 0; i < 4; i++)
+            Add(location + i, 4, GL_FLOAT, offset + i * sizeof(glm::vec4));
+        return *this;
+    }
+};
+
+// a GPU buffer holding one record per instance, which meshes bind as instanced vertex attributes
+class InstanceStream {
+public:
+    unsigned int ID = 0;
+    InstanceLayout layout;
+    unsigned int count = 0;    // instances currently stored
+    unsigned int capacity = 0; // instances the buffer storage can hold
+
+    InstanceStream(const InstanceLayout &layout, GLenum usage) : layout(layout), usage(usage)
+    {
+        glGenBuffers(1, &ID);
+    }
+
+    // upload count records. The buffer object keeps its name when it grows, so the VAOs it is attached to stay valid.
+    void Update(const void *data, unsigned int instanceCount)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        if (instanceCount > capacity)
+        {
+            capacity = instanceCount;
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * layout.stride, data, usage);
+        }
+        else
+        {
+            // orphan the previous storage so we don't wait on draws still reading it
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)capacity * layout.stride, NULL, usage);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)instanceCount * layout.stride, data);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        count = instanceCount;
+    }
+
+    // overwrite the records [first, first + instanceCount) in place, which lets several owners sub-allocate ranges of one
+    // stream. The range must fit in the current capacity.
+    void UpdateRange(const void *data, unsigned int first, unsigned int instanceCount)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)first * layout.stride, (GLsizeiptr)instanceCount * layout.stride, data);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // set up the instanced attributes of this stream in the currently bound VAO
+    void SetupAttributes() const
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, ID);
+        for (const InstanceAttribute &attribute : layout.attributes)
+        {
+            glEnableVertexAttribArray(attribute.location);
+            if (attribute.integer)
+                glVertexAttribIPointer(attribute.location, attribute.components, attribute.type, layout.stride, (void*)(size_t)attribute.offset);
+            else
+                glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized ? GL_TRUE : GL_FALSE, layout.stride, (void*)(size_t)attribute.offset);
+            glVertexAttribDivisor(attribute.location, attribute.divisor);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+private:
+    GLenum usage;
+};
+
+// typed front end of an instance stream, T being the per-instance record
+template<typename T>
+class InstanceBuffer : public InstanceStream {
+public:
+    InstanceBuffer(const InstanceLayout &layout, GLenum usage = GL_DYNAMIC_DRAW) : InstanceStream(layout, usage) {}
+
+    void Update(const T *instances, unsigned int instanceCount)
+    {
+        InstanceStream::Update(instances, instanceCount);
+    }
+
+    void Update(const std::vector<T> &instances)
+    {
+        InstanceStream::Update(instances.data(), static_cast<unsigned int>(instances.size()));
+    }
+
+    void UpdateRange(const T *instances, unsigned int first, unsigned int instanceCount)
+    {
+        InstanceStream::UpdateRange(instances, first, instanceCount);
+    }
+};
+#endif
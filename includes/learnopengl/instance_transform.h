@@ -0,0 +1,45 @@
+#ifndef INSTANCE_TRANSFORM_H
+#define INSTANCE_TRANSFORM_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstddef> // offsetof
+
+#include <learnopengl/instance_buffer.h>
+
+// rigid, uniformly scaled instance transform in 32 bytes instead of the 64 of a mat4.
+// the vertex shader rebuilds the world position as position + scale * rotate(rotation, aPos):
+//
+//     layout (location = 7) in vec4 aInstancePositionScale;
+//     layout (location = 8) in vec4 aInstanceRotation;
+//     vec3 rotated = aPos + 2.0 * cross(aInstanceRotation.xyz, cross(aInstanceRotation.xyz, aPos) + aInstanceRotation.w * aPos);
+//     vec3 worldPos = aInstancePositionScale.xyz + aInstancePositionScale.w * rotated;
+struct CompactTransform {
+    glm::vec3 position;
+    float     scale;
+    glm::vec4 rotation; // unit quaternion, xyz the vector part and w the scalar part (the GLSL vec4 order)
+
+    CompactTransform() : position(0.0f), scale(1.0f), rotation(0.0f, 0.0f, 0.0f, 1.0f) {}
+
+    CompactTransform(const glm::vec3 &position, float scale, const glm::quat &rotation)
+        : position(position), scale(scale), rotation(rotation.x, rotation.y, rotation.z, rotation.w) {}
+
+    glm::mat4 ToMatrix() const
+    {
+        glm::mat4 matrix = glm::mat4_cast(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z)) * scale;
+        matrix[3] = glm::vec4(position, 1.0f);
+        return matrix;
+    }
+};
+
+static_assert(sizeof(CompactTransform) == 32, "CompactTransform must match the std430/vertex layout of two vec4s");
+
+// the two vec4 attributes of a CompactTransform, starting at location
+InstanceLayout CompactTransformLayout(unsigned int location = FIRST_INSTANCE_ATTRIBUTE)
+{
+    return InstanceLayout(sizeof(CompactTransform))
+        .Add(location, 4, GL_FLOAT, offsetof(CompactTransform, position))
+        .Add(location + 1, 4, GL_FLOAT, offsetof(CompactTransform, rotation));
+}
+#endif
@@ -0,0 +1,222 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIGHT_CLUSTERS_SSE
+#include <emmintrin.h>
+#endif
+
+#include <learnopengl/thread_pool.h>
+
+// The view frustum is split into CLUSTER_GRID_X x CLUSTER_GRID_Y screen tiles and CLUSTER_GRID_Z depth slices, the
+// slices growing exponentially from the near to the far plane so froxels stay roughly cubic. The lighting shaders
+// index the grid the same way, so they must use the same counts. CLUSTER_GRID_X must be a multiple of 4.
+const unsigned int CLUSTER_GRID_X = 16;
+const unsigned int CLUSTER_GRID_Y = 9;
+const unsigned int CLUSTER_GRID_Z = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+
+// Assigns light spheres to the froxels they touch. Every froxel gets a contiguous run of the light indices, so a
+// fragment only loops over the lights of its own cluster. Cluster (x, y, z) is at x + (y + z * CLUSTER_GRID_Y) *
+// CLUSTER_GRID_X, x going left to right and y bottom to top on screen, z away from the camera.
+class LightClusterBuilder {
+public:
+    // per cluster the offset of its first light index and how many it has
+    std::vector<glm::uvec2> clusters;
+    // the light indices of all clusters, back to back
+    std::vector<unsigned int> indices;
+    // the slice of a fragment view depth units in front of the camera is floor(log(depth) * sliceScale + sliceBias)
+    float sliceScale = 0.0f;
+    float sliceBias = 0.0f;
+
+    LightClusterBuilder() : clusters(CLUSTER_COUNT), clusterLights(CLUSTER_COUNT) {}
+
+    // Rebuild the clusters of the perspective camera for the spheres (world position, radius w). The spheres are
+    // moved to view space and sorted into slices on the pool, then every row of froxels of a slice is tested against
+    // the spheres in that slice in parallel, 4 froxels at a time.
+    void Build(const std::vector<glm::vec4> &spheres, const glm::mat4 &view, float fovy, float aspect, float nearPlane, float farPlane, ThreadPool &pool)
+    {
+        if (fovy != froxelFovy || aspect != froxelAspect || nearPlane != froxelNear || farPlane != froxelFar)
+            buildFroxels(fovy, aspect, nearPlane, farPlane);
+
+        // view space spheres and the slices they cover; a sphere outside the depth range covers none
+        const unsigned int lightCount = (unsigned int)spheres.size();
+        viewSpheres.resize(lightCount);
+        firstSlice.resize(lightCount);
+        lastSlice.resize(lightCount);
+        pool.parallelFor(lightCount, [&](unsigned int begin, unsigned int end, unsigned int) {
+            for (unsigned int i = begin; i < end; ++i)
+            {
+                const glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(spheres[i]), 1.0f));
+                const float radius = spheres[i].w;
+                const float depth = -center.z;
+                viewSpheres[i] = glm::vec4(center, radius);
+                if (depth + radius < nearPlane || depth - radius > farPlane)
+                {
+                    firstSlice[i] = 1;
+                    lastSlice[i] = 0;
+                    continue;
+                }
+                firstSlice[i] = Slice(std::max(depth - radius, nearPlane));
+                lastSlice[i] = Slice(std::min(depth + radius, farPlane));
+            }
+        });
+
+        for (unsigned int z = 0; z < CLUSTER_GRID_Z; ++z)
+            sliceLights[z].clear();
+        for (unsigned int i = 0; i < lightCount; ++i)
+            for (unsigned int z = firstSlice[i]; z <= lastSlice[i]; ++z)
+                sliceLights[z].push_back(i);
+
+        // a row of froxels only writes its own clusters' lists
+        pool.parallelFor(CLUSTER_GRID_Y * CLUSTER_GRID_Z, [&](unsigned int begin, unsigned int end, unsigned int) {
+            for (unsigned int row = begin; row < end; ++row)
+                assignRow(row);
+        });
+
+        unsigned int offset = 0;
+        for (unsigned int i = 0; i < CLUSTER_COUNT; ++i)
+        {
+            const unsigned int count = (unsigned int)clusterLights[i].size();
+            clusters[i] = glm::uvec2(offset, count);
+            offset += count;
+        }
+        indices.resize(offset);
+        pool.parallelFor(CLUSTER_COUNT, [&](unsigned int begin, unsigned int end, unsigned int) {
+            for (unsigned int i = begin; i < end; ++i)
+                std::copy(clusterLights[i].begin(), clusterLights[i].end(), indices.begin() + clusters[i].x);
+        });
+    }
+
+    // the depth slice of a view depth (distance in front of the camera) between the near and far plane
+    unsigned int Slice(float depth) const
+    {
+        const int slice = (int)std::floor(std::log(depth) * sliceScale + sliceBias);
+        return (unsigned int)std::min(std::max(slice, 0), (int)CLUSTER_GRID_Z - 1);
+    }
+
+private:
+    // view space AABBs of the froxels, indexed like the clusters
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    // and of every row of froxels, to skip the rows a sphere misses at once
+    std::vector<glm::vec3> rowCenter, rowExtent;
+    float froxelFovy = 0.0f, froxelAspect = 0.0f, froxelNear = 0.0f, froxelFar = 0.0f;
+
+    std::vector<glm::vec4> viewSpheres;
+    std::vector<unsigned int> firstSlice, lastSlice;
+    std::vector<unsigned int> sliceLights[CLUSTER_GRID_Z];
+    std::vector<std::vector<unsigned int>> clusterLights;
+
+    void buildFroxels(float fovy, float aspect, float nearPlane, float farPlane)
+    {
+        froxelFovy = fovy;
+        froxelAspect = aspect;
+        froxelNear = nearPlane;
+        froxelFar = farPlane;
+        const float logRange = std::log(farPlane / nearPlane);
+        sliceScale = CLUSTER_GRID_Z / logRange;
+        sliceBias = -float(CLUSTER_GRID_Z) * std::log(nearPlane) / logRange;
+
+        for (std::vector<float> *array : { &centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ })
+            array->resize(CLUSTER_COUNT);
+        rowCenter.resize(CLUSTER_GRID_Y * CLUSTER_GRID_Z);
+        rowExtent.resize(CLUSTER_GRID_Y * CLUSTER_GRID_Z);
+
+        // half the size of the frustum's cross section at a depth of 1
+        const float tanY = std::tan(fovy * 0.5f);
+        const float tanX = tanY * aspect;
+        for (unsigned int z = 0; z < CLUSTER_GRID_Z; ++z)
+        {
+            const float sliceNear = nearPlane * std::pow(farPlane / nearPlane, float(z) / CLUSTER_GRID_Z);
+            const float sliceFar = nearPlane * std::pow(farPlane / nearPlane, float(z + 1) / CLUSTER_GRID_Z);
+            for (unsigned int y = 0; y < CLUSTER_GRID_Y; ++y)
+            {
+                const float bottom = (-1.0f + 2.0f * y / CLUSTER_GRID_Y) * tanY;
+                const float top = (-1.0f + 2.0f * (y + 1) / CLUSTER_GRID_Y) * tanY;
+                glm::vec3 rowMin(0.0f), rowMax(0.0f);
+                for (unsigned int x = 0; x < CLUSTER_GRID_X; ++x)
+                {
+                    const float left = (-1.0f + 2.0f * x / CLUSTER_GRID_X) * tanX;
+                    const float right = (-1.0f + 2.0f * (x + 1) / CLUSTER_GRID_X) * tanX;
+                    // the froxel's sides are planes through the eye, so its corners are the near and far ones
+                    const glm::vec3 minimum(std::min(left * sliceNear, left * sliceFar), std::min(bottom * sliceNear, bottom * sliceFar), -sliceFar);
+                    const glm::vec3 maximum(std::max(right * sliceNear, right * sliceFar), std::max(top * sliceNear, top * sliceFar), -sliceNear);
+                    const unsigned int i = x + (y + z * CLUSTER_GRID_Y) * CLUSTER_GRID_X;
+                    centerX[i] = (minimum.x + maximum.x) * 0.5f;
+                    centerY[i] = (minimum.y + maximum.y) * 0.5f;
+                    centerZ[i] = (minimum.z + maximum.z) * 0.5f;
+                    extentX[i] = (maximum.x - minimum.x) * 0.5f;
+                    extentY[i] = (maximum.y - minimum.y) * 0.5f;
+                    extentZ[i] = (maximum.z - minimum.z) * 0.5f;
+                    rowMin = x == 0 ? minimum : glm::min(rowMin, minimum);
+                    rowMax = x == 0 ? maximum : glm::max(rowMax, maximum);
+                }
+                rowCenter[y + z * CLUSTER_GRID_Y] = (rowMin + rowMax) * 0.5f;
+                rowExtent[y + z * CLUSTER_GRID_Y] = (rowMax - rowMin) * 0.5f;
+            }
+        }
+    }
+
+    // squared distance from a point to an AABB, 0 inside
+    static float distanceSquared(const glm::vec3 &point, const glm::vec3 &center, const glm::vec3 &extent)
+    {
+        const glm::vec3 outside = glm::max(glm::abs(point - center) - extent, glm::vec3(0.0f));
+        return glm::dot(outside, outside);
+    }
+
+    void assignRow(unsigned int row)
+    {
+        const unsigned int first = row * CLUSTER_GRID_X;
+        for (unsigned int x = 0; x < CLUSTER_GRID_X; ++x)
+            clusterLights[first + x].clear();
+
+        for (unsigned int light : sliceLights[row / CLUSTER_GRID_Y])
+        {
+            const glm::vec4 &sphere = viewSpheres[light];
+            const float radiusSquared = sphere.w * sphere.w;
+            if (distanceSquared(glm::vec3(sphere), rowCenter[row], rowExtent[row]) > radiusSquared)
+                continue;
+#ifdef LIGHT_CLUSTERS_SSE
+            const __m128 signMask = _mm_set1_ps(-0.f);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 sx = _mm_set1_ps(sphere.x);
+            const __m128 sy = _mm_set1_ps(sphere.y);
+            const __m128 sz = _mm_set1_ps(sphere.z);
+            const __m128 r2 = _mm_set1_ps(radiusSquared);
+            for (unsigned int x = 0; x < CLUSTER_GRID_X; x += 4)
+            {
+                const unsigned int i = first + x;
+                // max(|s - c| - e, 0) per axis
+                __m128 dx = _mm_sub_ps(_mm_andnot_ps(signMask, _mm_sub_ps(sx, _mm_loadu_ps(&centerX[i]))), _mm_loadu_ps(&extentX[i]));
+                __m128 dy = _mm_sub_ps(_mm_andnot_ps(signMask, _mm_sub_ps(sy, _mm_loadu_ps(&centerY[i]))), _mm_loadu_ps(&extentY[i]));
+                __m128 dz = _mm_sub_ps(_mm_andnot_ps(signMask, _mm_sub_ps(sz, _mm_loadu_ps(&centerZ[i]))), _mm_loadu_ps(&extentZ[i]));
+                dx = _mm_max_ps(dx, zero);
+                dy = _mm_max_ps(dy, zero);
+                dz = _mm_max_ps(dz, zero);
+                const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+                const unsigned int mask = (unsigned int)_mm_movemask_ps(_mm_cmple_ps(d2, r2));
+                for (unsigned int lane = 0; lane < 4; ++lane)
+                    if (mask & (1u << lane))
+                        clusterLights[i + lane].push_back(light);
+            }
+#else
+            for (unsigned int x = 0; x < CLUSTER_GRID_X; ++x)
+            {
+                const unsigned int i = first + x;
+                const glm::vec3 center(centerX[i], centerY[i], centerZ[i]);
+                const glm::vec3 extent(extentX[i], extentY[i], extentZ[i]);
+                if (distanceSquared(glm::vec3(sphere), center, extent) <= radiusSquared)
+                    clusterLights[i].push_back(light);
+            }
+#endif
+        }
+    }
+};
+#endif
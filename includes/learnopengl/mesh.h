@@ -7,9 +7,12 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/instance_buffer.h>
+#include <learnopengl/depth_stream.h>
 
 #include <string>
 #include <vector>
+#include <map>
 using namespace std;
 
 #define MAX_BONE_INFLUENCE 4
@@ -37,6 +40,15 @@ struct Texture {
     string path;
 };
 
+// layout of the commands read by glDrawElementsIndirect and glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int          baseVertex;
+    unsigned int baseInstance;
+};
+
 class Mesh {
 public:
     // mesh Data
@@ -44,6 +56,10 @@ public:
     vector<unsigned int> indices;
     vector<Texture>      textures;
     unsigned int VAO;
+    // instance buffer currently feeding each instanced attribute location of the VAO
+    map<unsigned int, unsigned int> instanceAttributes;
+    // positions only (and bone data), for depth only passes; empty until SetupDepthStream
+    DepthStream depthStream;
 
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
@@ -58,6 +74,115 @@ public:
 
     // render the mesh
     void Draw(Shader &shader) 
+    {
+        BindTextures(shader);
+
+        // draw mesh
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render instanceCount instances of the mesh, the per-instance attributes being read from the given streams
+    void DrawInstanced(Shader &shader, unsigned int instanceCount, const vector<const InstanceStream*> &streams)
+    {
+        AttachInstanceStreams(streams);
+        BindTextures(shader);
+
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0, instanceCount);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render the mesh with the DrawElementsIndirectCommand found at byteOffset in the bound GL_DRAW_INDIRECT_BUFFER.
+    // the instance streams must have been attached before, baseInstance of the command offsets into them.
+    void DrawIndirect(Shader &shader, size_t byteOffset)
+    {
+        BindTextures(shader);
+
+        glBindVertexArray(VAO);
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)byteOffset);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // render the mesh in a depth only pass (shadow maps, depth prepasses, occlusion queries), reading the position
+    // stream when the mesh has one. Binds no textures.
+    void DrawDepth(unsigned int instanceCount = 1)
+    {
+        if (depthStream.VAO != 0)
+        {
+            drawDepthStream(depthStream, instanceCount);
+            return;
+        }
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0, instanceCount);
+        glBindVertexArray(0);
+    }
+
+    // build the depth stream DrawDepth reads, keeping the bone indices and weights when the depth pass skins the mesh
+    void SetupDepthStream(bool skinning = false)
+    {
+        if (depthStream.VAO != 0)
+            deleteDepthStream(depthStream);
+        vector<glm::vec3> positions(vertices.size());
+        vector<DepthSkin> skin(skinning ? vertices.size() : 0);
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            positions[i] = vertices[i].Position;
+            if (skinning)
+            {
+                memcpy(skin[i].BoneIDs, vertices[i].m_BoneIDs, sizeof(skin[i].BoneIDs));
+                memcpy(skin[i].Weights, vertices[i].m_Weights, sizeof(skin[i].Weights));
+            }
+        }
+        depthStream = createDepthStream(positions, skin, indices);
+    }
+
+    // render drawCount consecutive commands starting at byteOffset in the bound GL_DRAW_INDIRECT_BUFFER with a single call
+    void MultiDrawIndirect(Shader &shader, size_t byteOffset, unsigned int drawCount)
+    {
+        BindTextures(shader);
+
+        glBindVertexArray(VAO);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)byteOffset, drawCount, 0);
+        glBindVertexArray(0);
+
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // set up the instanced attributes of the streams in the VAO. This only touches the VAO the first time a stream is used
+    // (or when another stream took over its attribute locations), updating the stream contents needs no VAO change.
+    void AttachInstanceStreams(const vector<const InstanceStream*> &streams)
+    {
+        for (const InstanceStream *stream : streams)
+        {
+            bool attached = true;
+            for (const InstanceAttribute &attribute : stream->layout.attributes)
+            {
+                auto it = instanceAttributes.find(attribute.location);
+                if (it == instanceAttributes.end() || it->second != stream->ID)
+                    attached = false;
+            }
+            if (attached)
+                continue;
+
+            glBindVertexArray(VAO);
+            stream->SetupAttributes();
+            glBindVertexArray(0);
+            for (const InstanceAttribute &attribute : stream->layout.attributes)
+                instanceAttributes[attribute.location] = stream->ID;
+        }
+    }
+
+    // bind the mesh textures to consecutive texture units and point the samplers of the shader to them
+    void BindTextures(Shader &shader)
     {
         // bind appropriate textures
         unsigned int diffuseNr  = 1;
@@ -84,14 +209,6 @@ public:
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
-        
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
 private:
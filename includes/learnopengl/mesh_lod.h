@@ -0,0 +1,86 @@
+#ifndef MESH_LOD_H
+#define MESH_LOD_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+// Builds a coarser level of detail of a mesh by vertex clustering: vertices are snapped to a uniform grid of cellSize,
+// every vertex of a cell is merged into their average and triangles that collapse are dropped. This is crude compared
+// to edge collapse, but fast and good enough for objects covering a few pixels.
+Mesh generateClusteredLOD(const Mesh &mesh, float cellSize)
+{
+    struct Cluster {
+        Vertex sum;
+        unsigned int count;
+        unsigned int index;
+    };
+
+    unordered_map<uint64_t, Cluster> clusters;
+    vector<unsigned int> remap(mesh.vertices.size());
+    vector<Vertex> vertices;
+
+    for (unsigned int i = 0; i < mesh.vertices.size(); i++)
+    {
+        const Vertex &vertex = mesh.vertices[i];
+        const glm::ivec3 cell = glm::ivec3(glm::floor(vertex.Position / cellSize)) + glm::ivec3(1 << 20);
+        const uint64_t key = (uint64_t(cell.x) & 0x1FFFFF) | (uint64_t(cell.y) & 0x1FFFFF) << 21 | (uint64_t(cell.z) & 0x1FFFFF) << 42;
+
+        auto it = clusters.find(key);
+        if (it == clusters.end())
+        {
+            Cluster cluster;
+            cluster.sum = vertex;
+            cluster.count = 1;
+            cluster.index = static_cast<unsigned int>(vertices.size());
+            vertices.push_back(vertex);
+            it = clusters.emplace(key, cluster).first;
+        }
+        else
+        {
+            Cluster &cluster = it->second;
+            cluster.sum.Position += vertex.Position;
+            cluster.sum.Normal += vertex.Normal;
+            cluster.sum.TexCoords += vertex.TexCoords;
+            cluster.sum.Tangent += vertex.Tangent;
+            cluster.sum.Bitangent += vertex.Bitangent;
+            cluster.count++;
+        }
+        remap[i] = it->second.index;
+    }
+
+    // merged vertices become the average of their cluster
+    for (auto &entry : clusters)
+    {
+        const Cluster &cluster = entry.second;
+        const float invCount = 1.0f / cluster.count;
+        Vertex &vertex = vertices[cluster.index];
+        vertex.Position = cluster.sum.Position * invCount;
+        // normals of opposite faces can cancel out, the vertex then keeps the first normal of its cluster
+        if (glm::dot(cluster.sum.Normal, cluster.sum.Normal) > 0.0f)
+            vertex.Normal = glm::normalize(cluster.sum.Normal);
+        vertex.TexCoords = cluster.sum.TexCoords * invCount;
+        vertex.Tangent = cluster.sum.Tangent * invCount;
+        vertex.Bitangent = cluster.sum.Bitangent * invCount;
+    }
+
+    vector<unsigned int> indices;
+    for (unsigned int i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        const unsigned int a = remap[mesh.indices[i]];
+        const unsigned int b = remap[mesh.indices[i + 1]];
+        const unsigned int c = remap[mesh.indices[i + 2]];
+        if (a == b || b == c || a == c)
+            continue;
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    }
+
+    return Mesh(vertices, indices, mesh.textures);
+}
+#endif
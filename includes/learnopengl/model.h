@@ -44,6 +44,27 @@ public:
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // draws instanceCount instances of the model, per-instance attributes being read from the given instance streams
+    void DrawInstanced(Shader &shader, unsigned int instanceCount, const vector<const InstanceStream*> &streams)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instanceCount, streams);
+    }
+
+    // draws the model in a depth only pass, from the meshes' position streams once SetupDepthStreams built them
+    void DrawDepth(unsigned int instanceCount = 1)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawDepth(instanceCount);
+    }
+
+    // gives every mesh a tightly packed position stream for depth only passes, with bone data if they skin the model
+    void SetupDepthStreams(bool skinning = false)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].SetupDepthStream(skinning);
+    }
     
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
@@ -47,6 +47,20 @@ public:
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
+
+    // draws the model in a depth only pass, from the meshes' position and bone streams once SetupDepthStreams built them
+    void DrawDepth(unsigned int instanceCount = 1)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawDepth(instanceCount);
+    }
+
+    // gives every mesh a tightly packed position stream for depth only passes, with the bone data to skin it
+    void SetupDepthStreams(bool skinning = true)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].SetupDepthStream(skinning);
+    }
     
 	auto& GetBoneInfoMap() { return m_BoneInfoMap; }
 	int& GetBoneCount() { return m_BoneCounter; }
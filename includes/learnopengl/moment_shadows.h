@@ -0,0 +1,116 @@
+#ifndef MOMENT_SHADOWS_H
+#define MOMENT_SHADOWS_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <iostream>
+#include <cmath>
+
+// Exponential variance shadow maps (EVSM): instead of depth, a shadow map holds the first two moments of two
+// exponential warps of it, exp(c+ d) and -exp(-c- d) with d the depth mapped to [-1, 1]. Unlike depth these can be
+// filtered like any other texture, so a map is blurred with a separable gaussian and mipmapped once after it is
+// rendered, and lighting takes a single trilinear fetch where PCF takes a depth comparison per tap. The exponents are
+// the usual ones for 32-bit float maps; the shaders must use the same.
+const float EVSM_POSITIVE_EXPONENT = 40.0f;
+const float EVSM_NEGATIVE_EXPONENT = 5.0f;
+
+// the moments of a depth in [0, 1], a map being cleared to the moments of 1
+glm::vec4 evsmMoments(float depth)
+{
+    const float warped = depth * 2.0f - 1.0f;
+    const float positive = std::exp(EVSM_POSITIVE_EXPONENT * warped);
+    const float negative = -std::exp(-EVSM_NEGATIVE_EXPONENT * warped);
+    return glm::vec4(positive, positive * positive, negative, negative * negative);
+}
+
+// RGBA32F texture array of layers moment maps with their full mip chain, filtered trilinearly
+unsigned int createMomentMapArray(unsigned int resolution, unsigned int layers)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA32F, resolution, resolution, layers, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    return texture;
+}
+
+// Separable gaussian blur of single layers of a moment map array, horizontally into a scratch layer and vertically
+// back. The blur shader draws a full screen triangle from gl_VertexID and receives "image", "layer", "direction" (a
+// texel along the blurred axis) and "radius" (in texels). Rebuild the array's mipmaps once its layers are blurred.
+class MomentShadowBlur {
+public:
+    MomentShadowBlur(unsigned int resolution)
+        : resolution(resolution)
+    {
+        scratch = createMomentMapArray(resolution, 1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, scratch);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, scratch, 0, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Moment blur framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glGenVertexArrays(1, &VAO);
+    }
+
+    ~MomentShadowBlur()
+    {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteTextures(1, &scratch);
+    }
+
+    MomentShadowBlur(const MomentShadowBlur&) = delete;
+    MomentShadowBlur& operator=(const MomentShadowBlur&) = delete;
+
+    // blur level 0 of the layer in place, the map being resolution x resolution; uses texture unit 0 and leaves the
+    // viewport at the map's size
+    void Blur(Shader &blurShader, unsigned int momentMap, unsigned int layer, int radius)
+    {
+        const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+        glViewport(0, 0, resolution, resolution);
+        blurShader.use();
+        blurShader.setInt("image", 0);
+        blurShader.setInt("radius", radius);
+        glActiveTexture(GL_TEXTURE0);
+        glBindVertexArray(VAO);
+
+        // horizontally into the scratch layer
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, scratch, 0, 0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, momentMap);
+        blurShader.setFloat("layer", float(layer));
+        blurShader.setVec2("direction", glm::vec2(1.0f / resolution, 0.0f));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        // and vertically back
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, momentMap, 0, layer);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, scratch);
+        blurShader.setFloat("layer", 0.0f);
+        blurShader.setVec2("direction", glm::vec2(0.0f, 1.0f / resolution));
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glBindVertexArray(0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+    }
+
+private:
+    unsigned int resolution;
+    unsigned int scratch;
+    unsigned int FBO;
+    unsigned int VAO;
+};
+#endif
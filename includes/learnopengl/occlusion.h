@@ -0,0 +1,325 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp> //glm::vec3, glm::mat4
+#include <vector> //std::vector
+#include <algorithm> //std::min, std::max
+#include <limits> //std::numeric_limits
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE
+#include <emmintrin.h>
+#endif
+
+#include <learnopengl/thread_pool.h>
+
+// Software occlusion culling. A few occluder meshes are rasterized on the CPU into a small depth buffer (depth is
+// z/w mapped to [0, 1], 1 being the far plane), screen tiles being rasterized in parallel on a thread pool. A min/max depth hierarchy is
+// then built and bounding boxes are tested against it: a box is occluded when its nearest depth is behind the farthest
+// occluder depth over the whole screen rectangle it covers. Nothing here touches OpenGL.
+class OcclusionBuffer
+{
+public:
+	OcclusionBuffer(unsigned int width = 256, unsigned int height = 192, unsigned int tileSize = 32)
+		: m_width{ width }, m_height{ height }, m_tileSize{ tileSize },
+		m_tilesX{ (width + tileSize - 1) / tileSize }, m_tilesY{ (height + tileSize - 1) / tileSize }
+	{
+		m_tileBins.resize(m_tilesX * m_tilesY);
+
+		//Level 0 of the hierarchy is the depth buffer itself
+		unsigned int levelWidth = width, levelHeight = height;
+		while (true)
+		{
+			m_levelSizes.push_back({ levelWidth, levelHeight });
+			m_hiZMin.emplace_back(levelWidth * levelHeight, 1.f);
+			m_hiZMax.emplace_back(levelWidth * levelHeight, 1.f);
+			if (levelWidth == 1 && levelHeight == 1)
+				break;
+			levelWidth = std::max(1u, (levelWidth + 1) / 2);
+			levelHeight = std::max(1u, (levelHeight + 1) / 2);
+		}
+	}
+
+	//Clear the depth buffer and the occluders of the previous frame
+	void beginFrame(const glm::mat4& viewProjection)
+	{
+		m_viewProjection = viewProjection;
+		m_triangles.clear();
+		for (auto&& bin : m_tileBins)
+			bin.clear();
+	}
+
+	//Transform, project and bin the triangles of an occluder mesh. Triangles crossing the near plane are dropped,
+	//which is conservative since missing occluders can only make more objects visible.
+	void addOccluder(const glm::vec3* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, const glm::mat4& model)
+	{
+		const glm::mat4 modelViewProjection = m_viewProjection * model;
+		m_projected.resize(vertexCount);
+		for (unsigned int i = 0; i < vertexCount; ++i)
+			m_projected[i] = modelViewProjection * glm::vec4(vertices[i], 1.f);
+
+		for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+		{
+			const glm::vec4& c0 = m_projected[indices[i]];
+			const glm::vec4& c1 = m_projected[indices[i + 1]];
+			const glm::vec4& c2 = m_projected[indices[i + 2]];
+			if (c0.w <= nearW || c1.w <= nearW || c2.w <= nearW)
+				continue;
+
+			addTriangle(toScreen(c0), toScreen(c1), toScreen(c2));
+		}
+	}
+
+	//Add the box [min, max] given in the model space of the matrix as an occluder
+	void addOccluderBox(const glm::mat4& model, const glm::vec3& min, const glm::vec3& max)
+	{
+		const glm::vec3 vertices[8] = {
+			{ min.x, min.y, min.z }, { max.x, min.y, min.z }, { min.x, max.y, min.z }, { max.x, max.y, min.z },
+			{ min.x, min.y, max.z }, { max.x, min.y, max.z }, { min.x, max.y, max.z }, { max.x, max.y, max.z }
+		};
+		static const unsigned int indices[36] = {
+			0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, // -z, +z
+			0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5, // -x, +x
+			0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7  // -y, +y
+		};
+		addOccluder(vertices, 8, indices, 36, model);
+	}
+
+	//Rasterize the binned occluders, the pool's threads each taking a contiguous run of screen tiles, then build the
+	//min/max hierarchy. Tiles never share pixels, so they need no synchronization.
+	void rasterize(ThreadPool& pool)
+	{
+		pool.parallelFor(static_cast<unsigned int>(m_tileBins.size()), [this](unsigned int begin, unsigned int end, unsigned int)
+			{
+				for (unsigned int tile = begin; tile < end; ++tile)
+					rasterizeTile(tile);
+			});
+
+		buildHierarchy();
+	}
+
+	//Test a world space AABB. Returns false only if the box is guaranteed to be hidden by the occluders.
+	bool isVisible(const glm::vec3& min, const glm::vec3& max) const
+	{
+		glm::vec2 rectMin(std::numeric_limits<float>::max());
+		glm::vec2 rectMax(-std::numeric_limits<float>::max());
+		glm::vec3 nearest(0.f, 0.f, 1.f);
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			const glm::vec3 corner((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z);
+			const glm::vec4 clip = m_viewProjection * glm::vec4(corner, 1.f);
+			//The box crosses the near plane, the camera is likely inside it
+			if (clip.w <= nearW)
+				return true;
+
+			const glm::vec3 screen = toScreen(clip);
+			rectMin = glm::min(rectMin, glm::vec2(screen));
+			rectMax = glm::max(rectMax, glm::vec2(screen));
+			if (screen.z < nearest.z)
+				nearest = screen;
+		}
+
+		const int x0 = std::max(0, static_cast<int>(rectMin.x));
+		const int y0 = std::max(0, static_cast<int>(rectMin.y));
+		const int x1 = std::min(static_cast<int>(m_width) - 1, static_cast<int>(rectMax.x));
+		const int y1 = std::min(static_cast<int>(m_height) - 1, static_cast<int>(rectMax.y));
+		if (x0 > x1 || y0 > y1)
+			return true; //Off screen, leave it to frustum culling
+
+		//Pick the finest level where the rectangle covers at most 4x4 texels
+		unsigned int level = 0;
+		while (level + 1 < m_levelSizes.size() && std::max(x1 - x0, y1 - y0) >> level >= 4)
+			++level;
+
+		//Quick accept: the nearest corner is in front of every occluder of its texel
+		if (nearest.x >= 0.f && nearest.y >= 0.f && nearest.x < m_width && nearest.y < m_height)
+		{
+			const unsigned int levelWidth = m_levelSizes[level].x;
+			const unsigned int texel = (static_cast<unsigned int>(nearest.y) >> level) * levelWidth + (static_cast<unsigned int>(nearest.x) >> level);
+			if (nearest.z < m_hiZMin[level][texel])
+				return true;
+		}
+
+		const unsigned int levelWidth = m_levelSizes[level].x;
+		for (int y = y0 >> level; y <= (y1 >> level); ++y)
+		{
+			for (int x = x0 >> level; x <= (x1 >> level); ++x)
+			{
+				if (nearest.z <= m_hiZMax[level][y * levelWidth + x])
+					return true;
+			}
+		}
+		return false;
+	}
+
+	unsigned int getTriangleCount() const
+	{
+		return static_cast<unsigned int>(m_triangles.size());
+	}
+
+	unsigned int getWidth() const
+	{
+		return m_width;
+	}
+
+	unsigned int getHeight() const
+	{
+		return m_height;
+	}
+
+	//Rasterized depth, row 0 being the bottom of the screen
+	const std::vector<float>& getDepth() const
+	{
+		return m_hiZMin[0];
+	}
+
+private:
+	static constexpr float nearW = 1e-4f;
+
+	struct ScreenTriangle
+	{
+		glm::vec3 v0, v1, v2;
+	};
+
+	unsigned int m_width, m_height;
+	unsigned int m_tileSize, m_tilesX, m_tilesY;
+
+	glm::mat4 m_viewProjection{ 1.f };
+	std::vector<glm::vec4> m_projected;
+	std::vector<ScreenTriangle> m_triangles;
+	std::vector<std::vector<unsigned int>> m_tileBins;
+
+	std::vector<glm::uvec2> m_levelSizes;
+	std::vector<std::vector<float>> m_hiZMin; //Nearest occluder depth per texel
+	std::vector<std::vector<float>> m_hiZMax; //Farthest occluder depth per texel
+
+	glm::vec3 toScreen(const glm::vec4& clip) const
+	{
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		return { (ndc.x * 0.5f + 0.5f) * m_width, (ndc.y * 0.5f + 0.5f) * m_height, glm::clamp(ndc.z * 0.5f + 0.5f, 0.f, 1.f) };
+	}
+
+	void addTriangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2)
+	{
+		const float minX = std::min(v0.x, std::min(v1.x, v2.x));
+		const float maxX = std::max(v0.x, std::max(v1.x, v2.x));
+		const float minY = std::min(v0.y, std::min(v1.y, v2.y));
+		const float maxY = std::max(v0.y, std::max(v1.y, v2.y));
+		if (maxX < 0.f || maxY < 0.f || minX >= m_width || minY >= m_height)
+			return;
+
+		const unsigned int index = static_cast<unsigned int>(m_triangles.size());
+		m_triangles.push_back({ v0, v1, v2 });
+
+		const unsigned int tileX0 = static_cast<unsigned int>(std::max(0.f, minX)) / m_tileSize;
+		const unsigned int tileY0 = static_cast<unsigned int>(std::max(0.f, minY)) / m_tileSize;
+		const unsigned int tileX1 = std::min(static_cast<unsigned int>(maxX) / m_tileSize, m_tilesX - 1);
+		const unsigned int tileY1 = std::min(static_cast<unsigned int>(maxY) / m_tileSize, m_tilesY - 1);
+		for (unsigned int ty = tileY0; ty <= tileY1; ++ty)
+			for (unsigned int tx = tileX0; tx <= tileX1; ++tx)
+				m_tileBins[ty * m_tilesX + tx].push_back(index);
+	}
+
+	void rasterizeTile(unsigned int tile)
+	{
+		std::vector<float>& depth = m_hiZMin[0];
+		const int tileX0 = (tile % m_tilesX) * m_tileSize;
+		const int tileY0 = (tile / m_tilesX) * m_tileSize;
+		const int tileX1 = std::min(tileX0 + static_cast<int>(m_tileSize), static_cast<int>(m_width)) - 1;
+		const int tileY1 = std::min(tileY0 + static_cast<int>(m_tileSize), static_cast<int>(m_height)) - 1;
+
+		for (int y = tileY0; y <= tileY1; ++y)
+			std::fill(depth.begin() + y * m_width + tileX0, depth.begin() + y * m_width + tileX1 + 1, 1.f);
+
+		for (unsigned int index : m_tileBins[tile])
+		{
+			glm::vec3 v0 = m_triangles[index].v0;
+			glm::vec3 v1 = m_triangles[index].v1;
+			glm::vec3 v2 = m_triangles[index].v2;
+
+			//Both windings are rasterized, make the area positive
+			float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+			if (area == 0.f)
+				continue;
+			if (area < 0.f)
+			{
+				std::swap(v1, v2);
+				area = -area;
+			}
+
+			//Edge functions e(x, y) = a * x + b * y + c, positive inside the triangle
+			const float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = v1.x * v2.y - v1.y * v2.x;
+			const float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = v2.x * v0.y - v2.y * v0.x;
+			const float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = v0.x * v1.y - v0.y * v1.x;
+
+			//Depth plane z(x, y) = zA * x + zB * y + zC
+			const float invArea = 1.f / area;
+			const float zA = (a0 * v0.z + a1 * v1.z + a2 * v2.z) * invArea;
+			const float zB = (b0 * v0.z + b1 * v1.z + b2 * v2.z) * invArea;
+			const float zC = (c0 * v0.z + c1 * v1.z + c2 * v2.z) * invArea;
+
+			const int minX = std::max(tileX0, static_cast<int>(std::min(v0.x, std::min(v1.x, v2.x))));
+			const int maxX = std::min(tileX1, static_cast<int>(std::max(v0.x, std::max(v1.x, v2.x))));
+			const int minY = std::max(tileY0, static_cast<int>(std::min(v0.y, std::min(v1.y, v2.y))));
+			const int maxY = std::min(tileY1, static_cast<int>(std::max(v0.y, std::max(v1.y, v2.y))));
+			if (minX > maxX || minY > maxY)
+				continue;
+
+			for (int y = minY; y <= maxY; ++y)
+			{
+				const float py = y + 0.5f;
+				float* row = &depth[y * m_width];
+				int x = minX;
+#ifdef OCCLUSION_SSE
+				const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+				const __m128 zero = _mm_setzero_ps();
+				for (; x + 3 <= maxX; x += 4)
+				{
+					const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+					const __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), _mm_set1_ps(b0 * py + c0));
+					const __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), _mm_set1_ps(b1 * py + c1));
+					const __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), _mm_set1_ps(b2 * py + c2));
+					const __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+
+					const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), px), _mm_set1_ps(zB * py + zC));
+					const __m128 previous = _mm_loadu_ps(row + x);
+					const __m128 nearest = _mm_min_ps(previous, z);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+				}
+#endif
+				for (; x <= maxX; ++x)
+				{
+					const float px = x + 0.5f;
+					if (a0 * px + b0 * py + c0 >= 0.f && a1 * px + b1 * py + c1 >= 0.f && a2 * px + b2 * py + c2 >= 0.f)
+						row[x] = std::min(row[x], zA * px + zB * py + zC);
+				}
+			}
+		}
+	}
+
+	void buildHierarchy()
+	{
+		m_hiZMax[0] = m_hiZMin[0];
+		for (unsigned int level = 1; level < m_levelSizes.size(); ++level)
+		{
+			const glm::uvec2 size = m_levelSizes[level];
+			const glm::uvec2 parentSize = m_levelSizes[level - 1];
+			for (unsigned int y = 0; y < size.y; ++y)
+			{
+				for (unsigned int x = 0; x < size.x; ++x)
+				{
+					const unsigned int px0 = x * 2, px1 = std::min(x * 2 + 1, parentSize.x - 1);
+					const unsigned int py0 = y * 2, py1 = std::min(y * 2 + 1, parentSize.y - 1);
+					const std::vector<float>& parentMin = m_hiZMin[level - 1];
+					const std::vector<float>& parentMax = m_hiZMax[level - 1];
+
+					m_hiZMin[level][y * size.x + x] = std::min(std::min(parentMin[py0 * parentSize.x + px0], parentMin[py0 * parentSize.x + px1]),
+						std::min(parentMin[py1 * parentSize.x + px0], parentMin[py1 * parentSize.x + px1]));
+					m_hiZMax[level][y * size.x + x] = std::max(std::max(parentMax[py0 * parentSize.x + px0], parentMax[py0 * parentSize.x + px1]),
+						std::max(parentMax[py1 * parentSize.x + px0], parentMax[py1 * parentSize.x + px1]));
+				}
+			}
+		}
+	}
+};
+#endif
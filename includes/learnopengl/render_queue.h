@@ -0,0 +1,182 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp> //glm::mat4
+#include <vector> //std::vector
+#include <map> //std::map
+#include <cstdint> //uint64_t
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/model.h>
+
+struct RenderQueueStats
+{
+	unsigned int draws = 0;
+	unsigned int programChanges = 0;
+	unsigned int materialChanges = 0;
+	unsigned int meshChanges = 0;
+
+	//State changes an immediate-mode traversal would have issued (program, textures and VAO for every draw)
+	unsigned int stateChangesSaved() const
+	{
+		return draws * 3 - (programChanges + materialChanges + meshChanges);
+	}
+};
+
+// Deferred draw submission. Culling emits compact packets with a 64-bit sort key, the queue is radix sorted and then
+// submitted while skipping redundant program, texture and vertex array binds.
+//
+// Key layout, from the most significant bit:
+//  pass (4) | program (8) | material (16) | reserved (12) | depth (24)
+// Opaque draws are sorted front-to-back inside each program/material bucket for early-Z, transparent draws are sorted
+// back-to-front (their depth is inverted). A material is a mesh's whole texture set, numbered the first time the queue
+// sees it; past 65536 materials the key bits alias, which only costs sorting quality, flush compares the full number.
+class RenderQueue
+{
+public:
+	enum Pass
+	{
+		PASS_OPAQUE = 0,
+		PASS_TRANSPARENT = 1
+	};
+
+	struct DrawPacket
+	{
+		uint64_t key;
+		Mesh* mesh;
+		Shader* shader;
+		unsigned int transformIndex;
+		unsigned int material;
+	};
+
+	//Start a new frame. Depth in the keys is the view distance along cameraFront normalized by farPlane.
+	void begin(const glm::vec3& cameraPosition, const glm::vec3& cameraFront, float farPlane)
+	{
+		m_cameraPosition = cameraPosition;
+		m_cameraFront = cameraFront;
+		m_invFarPlane = 1.f / farPlane;
+		m_packets.clear();
+		m_transforms.clear();
+	}
+
+	//Emit one packet per mesh of the model
+	void submit(Model& model, Shader& shader, const glm::mat4& transform, Pass pass = PASS_OPAQUE)
+	{
+		const unsigned int transformIndex = static_cast<unsigned int>(m_transforms.size());
+		m_transforms.push_back(transform);
+
+		const float viewDepth = glm::dot(glm::vec3(transform[3]) - m_cameraPosition, m_cameraFront) * m_invFarPlane;
+		uint64_t depth = static_cast<uint64_t>(glm::clamp(viewDepth, 0.f, 1.f) * depthMask);
+		if (pass == PASS_TRANSPARENT)
+			depth = depthMask - depth;
+
+		for (Mesh& mesh : model.meshes)
+		{
+			const unsigned int material = getMaterial(mesh);
+			const uint64_t key = (static_cast<uint64_t>(pass) & 0xF) << 60 |
+				(static_cast<uint64_t>(shader.ID) & 0xFF) << 52 |
+				(static_cast<uint64_t>(material) & 0xFFFF) << 36 |
+				(depth & depthMask);
+			m_packets.push_back({ key, &mesh, &shader, transformIndex, material });
+		}
+	}
+
+	//Stable LSD radix sort on the keys, 8 bits per pass. Passes where every key shares the same digit are skipped.
+	void sort()
+	{
+		m_sortBuffer.resize(m_packets.size());
+		for (unsigned int shift = 0; shift < 64; shift += 8)
+		{
+			unsigned int histogram[256] = {};
+			for (const DrawPacket& packet : m_packets)
+				++histogram[(packet.key >> shift) & 0xFF];
+
+			if (!m_packets.empty() && histogram[(m_packets[0].key >> shift) & 0xFF] == m_packets.size())
+				continue;
+
+			unsigned int offset = 0;
+			for (unsigned int& count : histogram)
+			{
+				const unsigned int bucketSize = count;
+				count = offset;
+				offset += bucketSize;
+			}
+			for (const DrawPacket& packet : m_packets)
+				m_sortBuffer[histogram[(packet.key >> shift) & 0xFF]++] = packet;
+			m_packets.swap(m_sortBuffer);
+		}
+	}
+
+	//Issue the draws in key order. The "model" uniform is set per draw, other uniforms are left to the caller.
+	void flush(RenderQueueStats& stats)
+	{
+		Shader* currentShader = nullptr;
+		unsigned int currentMaterial = ~0u;
+		unsigned int currentVAO = 0;
+		for (const DrawPacket& packet : m_packets)
+		{
+			if (packet.shader != currentShader)
+			{
+				currentShader = packet.shader;
+				currentShader->use();
+				currentMaterial = ~0u;
+				++stats.programChanges;
+			}
+
+			if (packet.material != currentMaterial)
+			{
+				currentMaterial = packet.material;
+				packet.mesh->BindTextures(*currentShader);
+				++stats.materialChanges;
+			}
+
+			if (packet.mesh->VAO != currentVAO)
+			{
+				currentVAO = packet.mesh->VAO;
+				glBindVertexArray(currentVAO);
+				++stats.meshChanges;
+			}
+
+			currentShader->setMat4("model", m_transforms[packet.transformIndex]);
+			glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(packet.mesh->indices.size()), GL_UNSIGNED_INT, 0);
+			++stats.draws;
+		}
+
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	const std::vector<DrawPacket>& getPackets() const
+	{
+		return m_packets;
+	}
+
+private:
+	static constexpr uint64_t depthMask = (1ull << 24) - 1;
+
+	std::vector<DrawPacket> m_packets;
+	std::vector<DrawPacket> m_sortBuffer;
+	std::vector<glm::mat4> m_transforms;
+
+	//Material numbers by texture set (the texture ids in binding order), kept across frames
+	std::map<std::vector<unsigned int>, unsigned int> m_materials;
+	std::vector<unsigned int> m_textureIds;
+
+	unsigned int getMaterial(const Mesh& mesh)
+	{
+		m_textureIds.clear();
+		for (const Texture& texture : mesh.textures)
+			m_textureIds.push_back(texture.id);
+
+		auto it = m_materials.find(m_textureIds);
+		if (it == m_materials.end())
+			it = m_materials.insert({ m_textureIds, static_cast<unsigned int>(m_materials.size()) }).first;
+		return it->second;
+	}
+
+	glm::vec3 m_cameraPosition{ 0.f };
+	glm::vec3 m_cameraFront{ 0.f, 0.f, -1.f };
+	float m_invFarPlane = 1.f;
+};
+#endif
@@ -43,6 +43,9 @@ public:
             // convert stream into string
             vertexCode = vShaderStream.str();
             fragmentCode = fShaderStream.str();			
+            // expand the #include "file" lines
+            vertexCode = resolveIncludes(vertexCode, vertexPath);
+            fragmentCode = resolveIncludes(fragmentCode, fragmentPath);
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
@@ -51,6 +54,7 @@ public:
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
                 geometryCode = gShaderStream.str();
+                geometryCode = resolveIncludes(geometryCode, geometryPath);
             }
         }
         catch (std::ifstream::failure& e)
@@ -162,6 +166,36 @@ public:
     }
 
 private:
+    // GLSL has no #include, so replace every line of the form #include "file" by that file (and whatever it includes
+    // in turn), the file's path being relative to the shader's.
+    // ------------------------------------------------------------------------
+    std::string resolveIncludes(const std::string &code, const std::string &path)
+    {
+        const std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+        const std::string directive = "#include \"";
+        std::istringstream lines(code);
+        std::stringstream result;
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            if (line.compare(0, directive.size(), directive) != 0)
+            {
+                result << line << "\n";
+                continue;
+            }
+            const std::string includePath = directory + line.substr(directive.size(), line.find('"', directive.size()) - directive.size());
+            std::ifstream includeFile(includePath);
+            if (!includeFile)
+            {
+                std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND: " << includePath << std::endl;
+                continue;
+            }
+            std::stringstream includeStream;
+            includeStream << includeFile.rdbuf();
+            result << resolveIncludes(includeStream.str(), includePath);
+        }
+        return result.str();
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
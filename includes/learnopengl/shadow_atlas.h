@@ -0,0 +1,373 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <iostream>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// square region of the atlas, in texels
+struct ShadowAtlasTile
+{
+    unsigned int x = 0;
+    unsigned int y = 0;
+    unsigned int size = 0;
+};
+
+// Buddy allocator of square power of two tiles over a size x size atlas: a tile of level l is size >> l texels wide
+// and splits into the 4 tiles of level l + 1 it covers. Freeing a tile merges it back with its 3 siblings when they
+// are all free, and free tiles are handed out lowest address first so the allocations stay packed.
+class ShadowAtlasAllocator {
+public:
+    ShadowAtlasAllocator(unsigned int size, unsigned int minTileSize)
+        : size(size), levelCount(1)
+    {
+        while ((size >> levelCount) >= minTileSize && levelCount < 16)
+            levelCount++;
+        freeTiles.resize(levelCount);
+        freeTiles[0].insert(0);
+    }
+
+    unsigned int Size() const { return size; }
+    unsigned int MinTileSize() const { return size >> (levelCount - 1); }
+
+    // tileSize is rounded up to a power of two, false when no tile of that size is left
+    bool Allocate(unsigned int tileSize, ShadowAtlasTile &tile)
+    {
+        const unsigned int level = levelOf(tileSize);
+        uint32_t index;
+        if (!allocate(level, index))
+            return false;
+        tile.size = size >> level;
+        tile.x = (index >> 16) * tile.size;
+        tile.y = (index & 0xFFFF) * tile.size;
+        usedTexels += (size_t)tile.size * tile.size;
+        return true;
+    }
+
+    void Free(const ShadowAtlasTile &tile)
+    {
+        const unsigned int level = levelOf(tile.size);
+        free(level, ((tile.x / tile.size) << 16) | (tile.y / tile.size));
+        usedTexels -= (size_t)tile.size * tile.size;
+    }
+
+    // fraction of the atlas handed out
+    float Usage() const { return float(usedTexels) / (float(size) * size); }
+
+private:
+    unsigned int size;
+    unsigned int levelCount;
+    size_t usedTexels = 0;
+    // free tiles of every level, as (column << 16) | row in tiles of that level
+    std::vector<std::set<uint32_t>> freeTiles;
+
+    unsigned int levelOf(unsigned int tileSize) const
+    {
+        unsigned int level = 0;
+        while (level + 1 < levelCount && (size >> (level + 1)) >= tileSize)
+            level++;
+        return level;
+    }
+
+    bool allocate(unsigned int level, uint32_t &index)
+    {
+        if (!freeTiles[level].empty())
+        {
+            index = *freeTiles[level].begin();
+            freeTiles[level].erase(freeTiles[level].begin());
+            return true;
+        }
+        uint32_t parent;
+        if (level == 0 || !allocate(level - 1, parent))
+            return false;
+        // split the parent, keep its first quarter and free the 3 others
+        const uint32_t x = (parent >> 16) * 2, y = (parent & 0xFFFF) * 2;
+        index = (x << 16) | y;
+        freeTiles[level].insert((x << 16) | (y + 1));
+        freeTiles[level].insert(((x + 1) << 16) | y);
+        freeTiles[level].insert(((x + 1) << 16) | (y + 1));
+        return true;
+    }
+
+    void free(unsigned int level, uint32_t index)
+    {
+        if (level > 0)
+        {
+            const uint32_t x = (index >> 16) & ~1u, y = (index & 0xFFFF) & ~1u;
+            const uint32_t siblings[4] = { (x << 16) | y, (x << 16) | (y + 1), ((x + 1) << 16) | y, ((x + 1) << 16) | (y + 1) };
+            bool merge = true;
+            for (uint32_t sibling : siblings)
+                merge = merge && (sibling == index || freeTiles[level].count(sibling) != 0);
+            if (merge)
+            {
+                for (uint32_t sibling : siblings)
+                    freeTiles[level].erase(sibling);
+                free(level - 1, ((x / 2) << 16) | (y / 2));
+                return;
+            }
+        }
+        freeTiles[level].insert(index);
+    }
+};
+
+// a light's wish for this frame: faces is 6 for a point light and 1 for a spot light, tileSize the resolution its
+// importance on screen asks for
+struct ShadowAtlasRequest
+{
+    unsigned int light = 0;
+    unsigned int faces = 1;
+    float tileSize = 0.0f;
+};
+
+// the tiles a light holds, renderFaces being the faces it has to render this frame (a bit per face)
+struct ShadowAtlasAllocation
+{
+    unsigned int faces = 0;
+    ShadowAtlasTile tiles[6];
+    unsigned int renderFaces = 0;
+    unsigned int dirtyFaces = 0;
+    unsigned int lastUsed = 0;
+};
+
+// Shadow maps of many point and spot lights carved out of a single depth texture. Every frame the visible lights
+// request tiles at the resolution their screen importance asks for. A light keeps its tiles, and their contents, for
+// as long as its resolution does not change by more than about a factor 2 and nothing invalidated them, so a light
+// only renders when it is new, resized or when the light or a caster in its faces moved. When the atlas is full the
+// least recently used lights not requested this frame are evicted, and after that the request is shrunk.
+class ShadowAtlas {
+public:
+    unsigned int Texture;
+    unsigned int FBO;
+
+    struct Stats
+    {
+        unsigned int resident = 0;    // lights holding tiles
+        unsigned int shadowed = 0;    // requested lights that got tiles this frame
+        unsigned int renderFaces = 0; // faces to render this frame
+        unsigned int evictions = 0;   // lights evicted this frame
+        float usage = 0.0f;
+    };
+
+    // a depth texture of size x size texels, compared against when sampled so a sampler2DShadow filters 2x2 taps
+    ShadowAtlas(unsigned int size = 8192, unsigned int minTileSize = 64, unsigned int maxTileSize = 1024)
+        : allocator(size, minTileSize), maxTileSize(maxTileSize)
+    {
+        glGenTextures(1, &Texture);
+        glBindTexture(GL_TEXTURE_2D, Texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, size, size, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, Texture, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::FRAMEBUFFER:: Shadow atlas framebuffer is not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~ShadowAtlas()
+    {
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteTextures(1, &Texture);
+    }
+
+    ShadowAtlas(const ShadowAtlas&) = delete;
+    ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+    unsigned int Size() const { return allocator.Size(); }
+
+    // the casters or the light of these faces moved, they render again the next frame the light is requested
+    void Invalidate(unsigned int light, unsigned int faces)
+    {
+        auto it = allocations.find(light);
+        if (it != allocations.end())
+            it->second.dirtyFaces |= faces;
+    }
+
+    // Fit this frame's requests, most important first, and work out the faces to render. Requests that do not fit
+    // even at the minimum tile size are left without tiles.
+    void Update(std::vector<ShadowAtlasRequest> requests)
+    {
+        frame++;
+        stats = Stats();
+        std::stable_sort(requests.begin(), requests.end(), [](const ShadowAtlasRequest& a, const ShadowAtlasRequest& b) { return a.tileSize > b.tileSize; });
+        // when the requests ask for more than the atlas holds they are all shrunk alike, rather than the first ones
+        // taking everything and the least important going without
+        float demand = 0.0f;
+        for (const ShadowAtlasRequest& request : requests)
+        {
+            const float tileSize = std::min(request.tileSize, float(maxTileSize));
+            demand += request.faces * tileSize * tileSize;
+        }
+        const float capacity = 0.9f * float(allocator.Size()) * allocator.Size();
+        if (demand > capacity)
+        {
+            const float scale = std::sqrt(capacity / demand);
+            for (ShadowAtlasRequest& request : requests)
+                request.tileSize *= scale;
+        }
+        // the lights keeping their tiles are claimed first so the others cannot evict them. A light that wants to grow
+        // only does if the larger tiles are free, it keeps its current ones otherwise
+        std::vector<bool> kept(requests.size(), false);
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            auto it = allocations.find(requests[i].light);
+            if (it == allocations.end())
+                continue;
+            ShadowAtlasAllocation& allocation = it->second;
+            const unsigned int tileSize = tileSizeFor(requests[i].tileSize);
+            if (keepSize(allocation.tiles[0].size, requests[i].tileSize) || tileSize > allocation.tiles[0].size)
+            {
+                ShadowAtlasAllocation grown;
+                if (!keepSize(allocation.tiles[0].size, requests[i].tileSize) && allocateTiles(allocation.faces, tileSize, grown))
+                {
+                    release(allocation);
+                    grown.dirtyFaces = (1u << grown.faces) - 1;
+                    allocation = grown;
+                }
+                allocation.lastUsed = frame;
+                kept[i] = true;
+            }
+            else
+            {
+                release(allocation);
+                allocations.erase(it);
+            }
+        }
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            if (!kept[i])
+            {
+                ShadowAtlasAllocation allocation;
+                if (!allocate(requests[i], allocation))
+                    continue;
+                allocation.dirtyFaces = (1u << allocation.faces) - 1;
+                allocation.lastUsed = frame;
+                allocations.emplace(requests[i].light, allocation);
+            }
+            ShadowAtlasAllocation& allocation = allocations[requests[i].light];
+            allocation.renderFaces = allocation.dirtyFaces;
+            allocation.dirtyFaces = 0;
+            stats.shadowed++;
+            for (unsigned int face = 0; face < allocation.faces; face++)
+                stats.renderFaces += (allocation.renderFaces >> face) & 1;
+        }
+        stats.resident = (unsigned int)allocations.size();
+        stats.usage = allocator.Usage();
+    }
+
+    // the light's tiles if it was given some this frame
+    const ShadowAtlasAllocation* Find(unsigned int light) const
+    {
+        auto it = allocations.find(light);
+        return it != allocations.end() && it->second.lastUsed == frame ? &it->second : nullptr;
+    }
+
+    // xy offset and zw scale of the tile in texture coordinates
+    glm::vec4 TileRect(const ShadowAtlasTile& tile) const
+    {
+        const float size = float(allocator.Size());
+        return glm::vec4(tile.x / size, tile.y / size, tile.size / size, tile.size / size);
+    }
+
+    // bind the atlas, restrict rendering to the tile and clear it; the scissor test is left enabled
+    void BeginTile(const ShadowAtlasTile& tile)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(tile.x, tile.y, tile.size, tile.size);
+        glScissor(tile.x, tile.y, tile.size, tile.size);
+        glEnable(GL_SCISSOR_TEST);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+
+    const Stats& GetStats() const { return stats; }
+
+private:
+    ShadowAtlasAllocator allocator;
+    unsigned int maxTileSize;
+    std::unordered_map<unsigned int, ShadowAtlasAllocation> allocations;
+    unsigned int frame = 0;
+    Stats stats;
+
+    // power of two tile size for a wanted resolution
+    unsigned int tileSizeFor(float wanted) const
+    {
+        unsigned int tileSize = allocator.MinTileSize();
+        while (tileSize * 2 <= maxTileSize && tileSize * 2 <= wanted)
+            tileSize *= 2;
+        return tileSize;
+    }
+
+    // hysteresis so a light moving across a size boundary does not reallocate, and so re-render, back and forth
+    bool keepSize(unsigned int current, float wanted) const
+    {
+        return tileSizeFor(wanted) == current || (wanted >= current * 0.75f && wanted < current * 2.5f);
+    }
+
+    void release(const ShadowAtlasAllocation& allocation)
+    {
+        for (unsigned int face = 0; face < allocation.faces; face++)
+            allocator.Free(allocation.tiles[face]);
+    }
+
+    bool allocateTiles(unsigned int faces, unsigned int tileSize, ShadowAtlasAllocation& allocation)
+    {
+        for (unsigned int face = 0; face < faces; face++)
+        {
+            if (!allocator.Allocate(tileSize, allocation.tiles[face]))
+            {
+                for (unsigned int allocated = 0; allocated < face; allocated++)
+                    allocator.Free(allocation.tiles[allocated]);
+                return false;
+            }
+        }
+        allocation.faces = faces;
+        return true;
+    }
+
+    // the least recently used light not requested this frame, false if every light was
+    bool evictOne()
+    {
+        auto oldest = allocations.end();
+        for (auto it = allocations.begin(); it != allocations.end(); ++it)
+        {
+            if (it->second.lastUsed != frame && (oldest == allocations.end() || it->second.lastUsed < oldest->second.lastUsed))
+                oldest = it;
+        }
+        if (oldest == allocations.end())
+            return false;
+        release(oldest->second);
+        allocations.erase(oldest);
+        stats.evictions++;
+        return true;
+    }
+
+    bool allocate(const ShadowAtlasRequest& request, ShadowAtlasAllocation& allocation)
+    {
+        for (unsigned int tileSize = tileSizeFor(request.tileSize); tileSize >= allocator.MinTileSize(); tileSize /= 2)
+        {
+            do
+            {
+                if (allocateTiles(request.faces, tileSize, allocation))
+                    return true;
+            } while (evictOne());
+        }
+        return false;
+    }
+};
+#endif
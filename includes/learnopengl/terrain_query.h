@@ -0,0 +1,308 @@
+#ifndef TERRAIN_QUERY_H
+#define TERRAIN_QUERY_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/heightmap_pyramid.h>
+#include <learnopengl/thread_pool.h>
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+
+struct TerrainRayHit {
+    float distance;
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+
+// Height, normal and ray queries against the level 0 surface of a HeightmapPyramid, the surface between four samples
+// being their bilinear interpolation. Samples are read straight from the mapped tiles.
+//
+// Rays march a min/max pyramid over the cells between samples: level k holds the height range of blocks of 2^k x 2^k
+// cells (level 0 is not stored, a cell's range is that of its 4 corners). A block the ray passes over entirely is
+// skipped in one step and the march climbs a level, otherwise it descends, so open terrain is crossed in a handful of
+// steps. In the cells it reaches the ray is intersected exactly with the bilinear patch. The pyramid costs about one
+// byte per sample.
+class TerrainQuery {
+public:
+    explicit TerrainQuery(const HeightmapPyramid &pyramid)
+        : pyramid(pyramid), layout(pyramid.Layout()), rows(pyramid.Header.rows), columns(pyramid.Header.columns),
+          tileSize(pyramid.Header.tileSize), spacing(pyramid.Header.sampleSpacing), origin(pyramid.Origin())
+    {
+        buildRanges();
+    }
+
+    // bilinear height of the terrain at world (x, z), clamped to its border
+    float GetHeight(float x, float z) const
+    {
+        float u, v;
+        float h[4];
+        cellAt(x, z, u, v, h);
+        return bilinear(h, u, v);
+    }
+
+    // normal of the bilinear surface at world (x, z)
+    glm::vec3 GetNormal(float x, float z) const
+    {
+        float u, v;
+        float h[4];
+        cellAt(x, z, u, v, h);
+        return surfaceNormal(h, u, v);
+    }
+
+    // angle between the surface and the horizontal plane at world (x, z), in radians
+    float GetSlope(float x, float z) const
+    {
+        return std::acos(glm::clamp(GetNormal(x, z).y, -1.0f, 1.0f));
+    }
+
+    // first point of the terrain along the ray within maxDistance (in units of direction, which needn't be normalized)
+    bool Raycast(const glm::vec3 &rayOrigin, const glm::vec3 &direction, float maxDistance, TerrainRayHit &hit) const
+    {
+        // to sample space: x along rows, z along columns, y stays in world units
+        const glm::vec3 o((rayOrigin.x - origin.x) / spacing, rayOrigin.y, (rayOrigin.z - origin.y) / spacing);
+        const glm::vec3 d(direction.x / spacing, direction.y, direction.z / spacing);
+
+        // clip to the box of the whole terrain, a little taller so a hit on its floor (flat sea) isn't clipped by rounding
+        const HeightRange &all = ranges.back()[0];
+        const glm::vec3 boxMin(0.0f, pyramid.ToHeight(all.minimum) - 1e-3f, 0.0f);
+        const glm::vec3 boxMax(float(rows - 1), pyramid.ToHeight(all.maximum) + 1e-3f, float(columns - 1));
+        float t = 0.0f, tEnd = maxDistance;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (std::abs(d[axis]) < 1e-12f)
+            {
+                if (o[axis] < boxMin[axis] || o[axis] > boxMax[axis])
+                    return false;
+                continue;
+            }
+            float t0 = (boxMin[axis] - o[axis]) / d[axis];
+            float t1 = (boxMax[axis] - o[axis]) / d[axis];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            t = std::max(t, t0);
+            tEnd = std::min(tEnd, t1);
+        }
+        if (t > tEnd)
+            return false;
+
+        const int top = static_cast<int>(ranges.size());
+        int level = top;
+        // a step that crosses from one cell into the next without skipping any, vertical rays cross a single cell
+        const float inverseX = 1.0f / d.x, inverseZ = 1.0f / d.z;
+        const float nudge = 1e-4f / std::max(std::max(std::abs(d.x), std::abs(d.z)), 1e-12f);
+        while (t <= tEnd)
+        {
+            const glm::vec3 p = o + d * t;
+            // block of the level containing p, leaning in the direction of travel on its borders
+            const float size = float(1u << level);
+            const unsigned int cellX = cellIndex(p.x, d.x, rows - 1);
+            const unsigned int cellZ = cellIndex(p.z, d.z, columns - 1);
+            const unsigned int blockX = cellX >> level, blockZ = cellZ >> level;
+
+            // where the ray leaves the block
+            float tExit = tEnd;
+            if (d.x != 0.0f)
+                tExit = std::min(tExit, ((blockX + (d.x > 0.0f ? 1 : 0)) * size - o.x) * inverseX);
+            if (d.z != 0.0f)
+                tExit = std::min(tExit, ((blockZ + (d.z > 0.0f ? 1 : 0)) * size - o.z) * inverseZ);
+
+            if (level == 0)
+            {
+                float h[4];
+                cellHeights(cellX, cellZ, h);
+                float tHit;
+                if (intersectCell(h, glm::vec3(p.x - cellX, p.y, p.z - cellZ), d, tExit - t, tHit))
+                {
+                    hit.distance = t + tHit;
+                    const glm::vec3 s = o + d * hit.distance;
+                    hit.position = glm::vec3(origin.x + s.x * spacing, s.y, origin.y + s.z * spacing);
+                    hit.normal = surfaceNormal(h, glm::clamp(s.x - cellX, 0.0f, 1.0f), glm::clamp(s.z - cellZ, 0.0f, 1.0f));
+                    return true;
+                }
+            }
+            else
+            {
+                const HeightRange &range = ranges[level - 1][(size_t)blockZ * blocksX(level) + blockX];
+                const float lowest = std::min(p.y, o.y + d.y * tExit);
+                if (lowest <= pyramid.ToHeight(range.maximum))
+                {
+                    level--;
+                    continue;
+                }
+            }
+            // passed over the block, on to the next one, a level up when that one is in another parent block
+            t = tExit + nudge;
+            const glm::vec3 next = o + d * t;
+            if (level < top && (cellIndex(next.x, d.x, rows - 1) >> (level + 1) != blockX >> 1 || cellIndex(next.z, d.z, columns - 1) >> (level + 1) != blockZ >> 1))
+                level++;
+        }
+        return false;
+    }
+
+    // heights of many positions (world xz), spread over the pool's threads when given one
+    void GetHeights(const glm::vec2 *positions, float *heights, unsigned int count, ThreadPool *pool = nullptr) const
+    {
+        auto job = [&](unsigned int begin, unsigned int end, unsigned int) {
+            for (unsigned int i = begin; i < end; i++)
+                heights[i] = GetHeight(positions[i].x, positions[i].y);
+        };
+        if (pool)
+            pool->parallelFor(count, job);
+        else
+            job(0, count, 0);
+    }
+
+    // hits[i] is only written when hit[i] is set
+    void Raycasts(const glm::vec3 *origins, const glm::vec3 *directions, unsigned int count, float maxDistance, TerrainRayHit *hits, bool *hit, ThreadPool *pool = nullptr) const
+    {
+        auto job = [&](unsigned int begin, unsigned int end, unsigned int) {
+            for (unsigned int i = begin; i < end; i++)
+                hit[i] = Raycast(origins[i], directions[i], maxDistance, hits[i]);
+        };
+        if (pool)
+            pool->parallelFor(count, job);
+        else
+            job(0, count, 0);
+    }
+
+private:
+    const HeightmapPyramid &pyramid;
+    const HeightmapPyramidLayout &layout;
+    unsigned int rows, columns, tileSize;
+    float spacing;
+    glm::vec2 origin;
+    // ranges[k - 1] holds level k, its blocks (x, z) at z * blocksX(k) + x; the last level is a single block
+    std::vector<std::vector<HeightRange>> ranges;
+
+    unsigned int blocksX(int level) const { return ((rows - 2) >> level) + 1; }
+    unsigned int blocksZ(int level) const { return ((columns - 2) >> level) + 1; }
+
+    static unsigned int cellIndex(float position, float direction, unsigned int cells)
+    {
+        float cell = std::floor(position);
+        // exactly on a border moving backwards: the cell behind it
+        if (direction < 0.0f && cell == position)
+            cell -= 1.0f;
+        return static_cast<unsigned int>(glm::clamp(cell, 0.0f, float(cells - 1)));
+    }
+
+    // heights of the corners of cell (row, column): (row, column), (row + 1, column), (row, column + 1), (row + 1, column + 1)
+    void cellHeights(unsigned int row, unsigned int column, float h[4]) const
+    {
+        // tiles share their last row and column with the next ones, so a cell never straddles two tiles
+        const unsigned int tileX = std::min(row / tileSize, layout.TilesX(0) - 1);
+        const unsigned int tileZ = std::min(column / tileSize, layout.TilesZ(0) - 1);
+        const uint16_t *tile = pyramid.Tile(0, tileX, tileZ);
+        const uint16_t *sample = tile + (size_t)(row - tileX * tileSize) * (tileSize + 1) + (column - tileZ * tileSize);
+        h[0] = pyramid.ToHeight(sample[0]);
+        h[1] = pyramid.ToHeight(sample[tileSize + 1]);
+        h[2] = pyramid.ToHeight(sample[1]);
+        h[3] = pyramid.ToHeight(sample[tileSize + 2]);
+    }
+
+    // cell under world (x, z) and the position in it
+    void cellAt(float x, float z, float &u, float &v, float h[4]) const
+    {
+        const float row = glm::clamp((x - origin.x) / spacing, 0.0f, float(rows - 1));
+        const float column = glm::clamp((z - origin.y) / spacing, 0.0f, float(columns - 1));
+        const unsigned int cellX = std::min(static_cast<unsigned int>(row), rows - 2);
+        const unsigned int cellZ = std::min(static_cast<unsigned int>(column), columns - 2);
+        u = row - cellX;
+        v = column - cellZ;
+        cellHeights(cellX, cellZ, h);
+    }
+
+    static float bilinear(const float h[4], float u, float v)
+    {
+        return h[0] + (h[1] - h[0]) * u + (h[2] - h[0]) * v + (h[0] - h[1] - h[2] + h[3]) * u * v;
+    }
+
+    glm::vec3 surfaceNormal(const float h[4], float u, float v) const
+    {
+        const float twist = h[0] - h[1] - h[2] + h[3];
+        const float dhdx = (h[1] - h[0] + twist * v) / spacing;
+        const float dhdz = (h[2] - h[0] + twist * u) / spacing;
+        return glm::normalize(glm::vec3(-dhdx, 1.0f, -dhdz));
+    }
+
+    // first t in [0, length] where the ray p + d * t (p in cell coordinates) is on or below the bilinear patch. Along
+    // a line the patch is a quadratic in t, so this is the first root of ray height - patch height.
+    static bool intersectCell(const float h[4], const glm::vec3 &p, const glm::vec3 &d, float length, float &t)
+    {
+        const float a = h[1] - h[0], b = h[2] - h[0], twist = h[0] - h[1] - h[2] + h[3];
+        const float A = -twist * d.x * d.z;
+        const float B = d.y - (a * d.x + b * d.z + twist * (p.x * d.z + p.z * d.x));
+        const float C = p.y - bilinear(h, p.x, p.z);
+        if (C <= 0.0f)
+        {
+            t = 0.0f;
+            return true;
+        }
+        if (std::abs(A) < 1e-9f)
+        {
+            if (B >= 0.0f)
+                return false;
+            t = -C / B;
+            return t <= length;
+        }
+        const float discriminant = B * B - 4.0f * A * C;
+        if (discriminant < 0.0f)
+            return false;
+        const float root = std::sqrt(discriminant);
+        float t0 = (-B - root) / (2.0f * A);
+        float t1 = (-B + root) / (2.0f * A);
+        if (t0 > t1)
+            std::swap(t0, t1);
+        t = t0 >= 0.0f ? t0 : t1;
+        return t >= 0.0f && t <= length;
+    }
+
+    void buildRanges()
+    {
+        // level 1 from the samples, each block covering 3 x 3 of them
+        std::vector<HeightRange> level(blocksX(1) * (size_t)blocksZ(1), HeightRange{ 0xFFFF, 0 });
+        for (unsigned int row = 0; row < rows; row++)
+        {
+            const unsigned int firstX = row == 0 ? 0 : std::min((row - 1) / 2, blocksX(1) - 1);
+            const unsigned int lastX = std::min(row / 2, blocksX(1) - 1);
+            for (unsigned int column = 0; column < columns; column++)
+            {
+                const uint16_t sample = pyramid.Sample(0, row, column);
+                const unsigned int firstZ = column == 0 ? 0 : std::min((column - 1) / 2, blocksZ(1) - 1);
+                const unsigned int lastZ = std::min(column / 2, blocksZ(1) - 1);
+                for (unsigned int x = firstX; x <= lastX; x++)
+                {
+                    for (unsigned int z = firstZ; z <= lastZ; z++)
+                    {
+                        HeightRange &range = level[(size_t)z * blocksX(1) + x];
+                        range.minimum = std::min(range.minimum, sample);
+                        range.maximum = std::max(range.maximum, sample);
+                    }
+                }
+            }
+        }
+        ranges.push_back(std::move(level));
+
+        for (int k = 2; blocksX(k - 1) > 1 || blocksZ(k - 1) > 1; k++)
+        {
+            const std::vector<HeightRange> &child = ranges.back();
+            std::vector<HeightRange> parent(blocksX(k) * (size_t)blocksZ(k), HeightRange{ 0xFFFF, 0 });
+            for (unsigned int z = 0; z < blocksZ(k - 1); z++)
+            {
+                for (unsigned int x = 0; x < blocksX(k - 1); x++)
+                {
+                    const HeightRange &childRange = child[(size_t)z * blocksX(k - 1) + x];
+                    HeightRange &range = parent[(size_t)(z / 2) * blocksX(k) + x / 2];
+                    range.minimum = std::min(range.minimum, childRange.minimum);
+                    range.maximum = std::max(range.maximum, childRange.maximum);
+                }
+            }
+            ranges.push_back(std::move(parent));
+        }
+    }
+};
+#endif
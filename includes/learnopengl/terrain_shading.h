@@ -0,0 +1,140 @@
+#ifndef TERRAIN_SHADING_H
+#define TERRAIN_SHADING_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TERRAIN_SHADING_SSE
+#include <emmintrin.h>
+#endif
+
+#include <learnopengl/thread_pool.h>
+
+// Heights in world units of a block of rows x columns samples, with margin extra samples on every side so the kernels
+// can read the neighbours of the samples on the border of the block. Rows run along world x and columns along world z.
+struct TerrainHeightWindow {
+    unsigned int rows = 0;
+    unsigned int columns = 0;
+    unsigned int margin = 0;
+    std::vector<float> heights;
+
+    TerrainHeightWindow() = default;
+    TerrainHeightWindow(unsigned int rows, unsigned int columns, unsigned int margin)
+        : rows(rows), columns(columns), margin(margin), heights((size_t)(rows + 2 * margin) * Stride()) {}
+
+    unsigned int Stride() const { return columns + 2 * margin; }
+
+    // row and column of the block, from -margin to rows/columns + margin - 1
+    float &At(int row, int column) { return heights[(size_t)(row + margin) * Stride() + column + margin]; }
+    const float *Row(int row) const { return &heights[(size_t)(row + margin) * Stride() + margin]; }
+};
+
+// RGBA8 texel: rgb the normal * 0.5 + 0.5, a the ambient occlusion (1 fully open). For a heightfield the tangent along
+// x is normalize(vec3(n.y, -n.x, 0)) and along z normalize(vec3(0, -n.z, n.y)), so they are not stored.
+uint32_t packTerrainShading(const glm::vec3 &normal, float occlusion)
+{
+    const glm::vec4 texel = glm::clamp(glm::vec4(normal * 0.5f + 0.5f, occlusion), 0.0f, 1.0f) * 255.0f + 0.5f;
+    return uint32_t(texel.x) | (uint32_t(texel.y) << 8) | (uint32_t(texel.z) << 16) | (uint32_t(texel.w) << 24);
+}
+
+// the 8 horizon directions, as (row, column) steps
+static const int TERRAIN_HORIZON_DIRECTIONS[8][2] = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+
+// Shade columns [first, last) of a row of the window. The normal comes from central differences. The occlusion is
+// horizon based: along each of the 8 directions the highest elevation angle within aoRadius samples is found, and the
+// occlusion is the average of their sines, so a sample in a narrow valley gets dark and a peak stays at 1.
+void shadeTerrainRowScalar(const TerrainHeightWindow &window, unsigned int row, unsigned int first, unsigned int last, float sampleSpacing, unsigned int aoRadius, uint32_t *out)
+{
+    const int stride = static_cast<int>(window.Stride());
+    const float *center = window.Row(row);
+    for (unsigned int column = first; column < last; column++)
+    {
+        const float *h = center + column;
+        const glm::vec3 normal = glm::normalize(glm::vec3(h[-stride] - h[stride], 2.0f * sampleSpacing, h[-1] - h[1]));
+
+        float occlusion = 0.0f;
+        for (unsigned int d = 0; d < 8 && aoRadius > 0; d++)
+        {
+            const int offset = TERRAIN_HORIZON_DIRECTIONS[d][0] * stride + TERRAIN_HORIZON_DIRECTIONS[d][1];
+            const float stepLength = (d & 1) ? sampleSpacing * 1.41421356f : sampleSpacing;
+            float horizon = 0.0f; // tangent of the highest elevation angle
+            for (unsigned int step = 1; step <= aoRadius; step++)
+                horizon = std::max(horizon, (h[offset * (int)step] - h[0]) / (stepLength * step));
+            occlusion += horizon / std::sqrt(1.0f + horizon * horizon);
+        }
+        out[column] = packTerrainShading(normal, 1.0f - occlusion / 8.0f);
+    }
+}
+
+#ifdef TERRAIN_SHADING_SSE
+// same as shadeTerrainRowScalar, 4 columns at a time
+void shadeTerrainRowSSE(const TerrainHeightWindow &window, unsigned int row, unsigned int first, unsigned int last, float sampleSpacing, unsigned int aoRadius, uint32_t *out)
+{
+    const int stride = static_cast<int>(window.Stride());
+    const float *center = window.Row(row);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 normalY = _mm_set1_ps(2.0f * sampleSpacing);
+    unsigned int column = first;
+    for (; column + 4 <= last; column += 4)
+    {
+        const float *h = center + column;
+        const __m128 h0 = _mm_loadu_ps(h);
+        const __m128 nx = _mm_sub_ps(_mm_loadu_ps(h - stride), _mm_loadu_ps(h + stride));
+        const __m128 nz = _mm_sub_ps(_mm_loadu_ps(h - 1), _mm_loadu_ps(h + 1));
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(normalY, normalY)), _mm_mul_ps(nz, nz)));
+        const __m128 inverseLength = _mm_div_ps(one, length);
+
+        __m128 occlusion = zero;
+        for (unsigned int d = 0; d < 8 && aoRadius > 0; d++)
+        {
+            const int offset = TERRAIN_HORIZON_DIRECTIONS[d][0] * stride + TERRAIN_HORIZON_DIRECTIONS[d][1];
+            const float stepLength = (d & 1) ? sampleSpacing * 1.41421356f : sampleSpacing;
+            __m128 horizon = zero;
+            for (unsigned int step = 1; step <= aoRadius; step++)
+            {
+                const __m128 rise = _mm_sub_ps(_mm_loadu_ps(h + offset * (int)step), h0);
+                horizon = _mm_max_ps(horizon, _mm_mul_ps(rise, _mm_set1_ps(1.0f / (stepLength * step))));
+            }
+            occlusion = _mm_add_ps(occlusion, _mm_div_ps(horizon, _mm_sqrt_ps(_mm_add_ps(one, _mm_mul_ps(horizon, horizon)))));
+        }
+        occlusion = _mm_sub_ps(one, _mm_mul_ps(occlusion, _mm_set1_ps(1.0f / 8.0f)));
+
+        // to [0, 255] and packed as RGBA8
+        auto quantize = [&](__m128 value) {
+            return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(value, zero), one), scale), half));
+        };
+        const __m128i r = quantize(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(nx, inverseLength), half), half));
+        const __m128i g = quantize(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(normalY, inverseLength), half), half));
+        const __m128i b = quantize(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(nz, inverseLength), half), half));
+        const __m128i a = quantize(occlusion);
+        const __m128i texels = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + column), texels);
+    }
+    shadeTerrainRowScalar(window, row, column, last, sampleSpacing, aoRadius, out);
+}
+#endif
+
+// Shade every sample of the block, rows spread over the pool's threads. out holds window.rows * window.columns texels
+// and the window's margin must be at least max(1, aoRadius); aoRadius 0 leaves the occlusion at 1.
+void computeTerrainShading(const TerrainHeightWindow &window, float sampleSpacing, unsigned int aoRadius, uint32_t *out, ThreadPool &pool)
+{
+    pool.parallelFor(window.rows, [&](unsigned int begin, unsigned int end, unsigned int) {
+        for (unsigned int row = begin; row < end; row++)
+        {
+#ifdef TERRAIN_SHADING_SSE
+            shadeTerrainRowSSE(window, row, 0, window.columns, sampleSpacing, aoRadius, out + (size_t)row * window.columns);
+#else
+            shadeTerrainRowScalar(window, row, 0, window.columns, sampleSpacing, aoRadius, out + (size_t)row * window.columns);
+#endif
+        }
+    });
+}
+#endif
@@ -0,0 +1,106 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <thread> //std::thread
+#include <mutex> //std::mutex
+#include <condition_variable> //std::condition_variable
+#include <functional> //std::function
+#include <vector> //std::vector
+#include <algorithm> //std::max
+
+// Persistent worker threads for data parallel jobs. The calling thread takes part in the work, so a pool created
+// with N threads spawns N - 1 workers.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency())
+		: m_threadCount{ std::max(1u, threadCount) }
+	{
+		for (unsigned int i = 1; i < m_threadCount; ++i)
+			m_workers.emplace_back([this, i]() { workerLoop(i); });
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_wakeUp.notify_all();
+		for (auto&& worker : m_workers)
+			worker.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int getThreadCount() const
+	{
+		return m_threadCount;
+	}
+
+	//Split [0, count) into one contiguous slice per thread and call job(begin, end, sliceIndex) for each of them.
+	//Blocks until every slice is done. sliceIndex is in [0, getThreadCount()).
+	void parallelFor(unsigned int count, const std::function<void(unsigned int, unsigned int, unsigned int)>& job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_job = &job;
+			m_count = count;
+			m_pending = m_threadCount - 1;
+			++m_generation;
+		}
+		m_wakeUp.notify_all();
+
+		runSlice(0);
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this]() { return m_pending == 0; });
+		m_job = nullptr;
+	}
+
+private:
+	unsigned int m_threadCount;
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeUp;
+	std::condition_variable m_done;
+	const std::function<void(unsigned int, unsigned int, unsigned int)>* m_job = nullptr;
+	unsigned int m_count = 0;
+	unsigned int m_pending = 0;
+	unsigned int m_generation = 0;
+	bool m_quit = false;
+
+	void runSlice(unsigned int sliceIndex)
+	{
+		const unsigned int begin = static_cast<unsigned int>(static_cast<unsigned long long>(m_count) * sliceIndex / m_threadCount);
+		const unsigned int end = static_cast<unsigned int>(static_cast<unsigned long long>(m_count) * (sliceIndex + 1) / m_threadCount);
+		if (begin < end)
+			(*m_job)(begin, end, sliceIndex);
+	}
+
+	void workerLoop(unsigned int sliceIndex)
+	{
+		unsigned int seenGeneration = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wakeUp.wait(lock, [&]() { return m_quit || m_generation != seenGeneration; });
+				if (m_quit)
+					return;
+				seenGeneration = m_generation;
+			}
+
+			runSlice(sliceIndex);
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				--m_pending;
+			}
+			m_done.notify_one();
+		}
+	}
+};
+#endif
@@ -0,0 +1,179 @@
+#ifndef VISIBILITY_BUFFER_H
+#define VISIBILITY_BUFFER_H
+
+#include <glad/glad.h> // holds all OpenGL type declarations
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/depth_stream.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <utility>
+#include <vector>
+
+// A visibility buffer holds no surface attributes, only which triangle of which instance covers a pixel: the instance
+// in the top bits of a 32-bit texel and the triangle in the VISIBILITY_TRIANGLE_BITS below, all bits set where nothing
+// was drawn. The shaders (visibility_buffer.glsl) must use the same split.
+const unsigned int VISIBILITY_TRIANGLE_BITS = 24;
+const unsigned int VISIBILITY_MAX_TRIANGLES = 1u << VISIBILITY_TRIANGLE_BITS;
+const unsigned int VISIBILITY_MAX_INSTANCES = (1u << (32 - VISIBILITY_TRIANGLE_BITS)) - 1;
+
+// the vertex attributes the shading passes read, tightly packed
+struct VisibilityVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+};
+
+// the run of triangles of one of the model's meshes, whose textures shade them
+struct VisibilityMesh {
+    Mesh *mesh;
+    unsigned int firstTriangle;
+    unsigned int triangleCount;
+};
+
+// All meshes of a model in one vertex and one index buffer, so a triangle is known by its index alone. The visibility
+// pass draws the depth stream, which keeps the triangles in the same order, and stores gl_PrimitiveID; the resolve pass
+// binds the two buffers as storage buffers to fetch that triangle's corners. The VAO feeds positions, normals and
+// texture coordinates at locations 0, 1 and 2 like Mesh does, for passes that rasterize the attributes.
+struct VisibilityGeometry {
+    unsigned int VAO = 0;
+    unsigned int vertexBuffer = 0;
+    unsigned int indexBuffer = 0;
+    unsigned int triangleCount = 0;
+    vector<VisibilityMesh> meshes;
+    DepthStream depthStream;
+};
+
+// the vertex halfway along the edge between a and b
+VisibilityVertex visibilityMidpoint(const VisibilityVertex &a, const VisibilityVertex &b)
+{
+    VisibilityVertex vertex;
+    vertex.Position = (a.Position + b.Position) * 0.5f;
+    const glm::vec3 normal = a.Normal + b.Normal;
+    vertex.Normal = glm::dot(normal, normal) > 0.0f ? glm::normalize(normal) : a.Normal;
+    vertex.TexCoords = (a.TexCoords + b.TexCoords) * 0.5f;
+    return vertex;
+}
+
+// Split every triangle into 4 at its edges' midpoints, the new vertices being shared by the triangles on either side
+// of an edge. The surface does not change, only its triangle density.
+void subdivideTriangles(vector<VisibilityVertex> &vertices, vector<unsigned int> &indices)
+{
+    vector<unsigned int> subdivided;
+    subdivided.reserve(indices.size() * 4);
+    map<pair<unsigned int, unsigned int>, unsigned int> midpoints;
+    auto midpoint = [&](unsigned int a, unsigned int b) {
+        const pair<unsigned int, unsigned int> edge(std::min(a, b), std::max(a, b));
+        auto it = midpoints.find(edge);
+        if (it != midpoints.end())
+            return it->second;
+        const unsigned int index = (unsigned int)vertices.size();
+        // copy the corners first, push_back may move them
+        const VisibilityVertex first = vertices[a], second = vertices[b];
+        vertices.push_back(visibilityMidpoint(first, second));
+        midpoints[edge] = index;
+        return index;
+    };
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        const unsigned int a = indices[i], b = indices[i + 1], c = indices[i + 2];
+        const unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+        // same winding as the triangle
+        const unsigned int triangles[12] = { a, ab, ca,  ab, b, bc,  ca, bc, c,  ab, bc, ca };
+        subdivided.insert(subdivided.end(), triangles, triangles + 12);
+    }
+    indices.swap(subdivided);
+}
+
+// Gather the meshes of the model, every triangle split subdivisions times over (4^subdivisions as many triangles),
+// and upload them. A geometry of more than VISIBILITY_MAX_TRIANGLES triangles can't be told apart in a visibility
+// buffer.
+VisibilityGeometry createVisibilityGeometry(Model &model, unsigned int subdivisions = 0)
+{
+    VisibilityGeometry geometry;
+    vector<VisibilityVertex> vertices;
+    vector<unsigned int> indices;
+    for (Mesh &mesh : model.meshes)
+    {
+        vector<VisibilityVertex> meshVertices(mesh.vertices.size());
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            meshVertices[i].Position = mesh.vertices[i].Position;
+            meshVertices[i].Normal = mesh.vertices[i].Normal;
+            meshVertices[i].TexCoords = mesh.vertices[i].TexCoords;
+        }
+        vector<unsigned int> meshIndices = mesh.indices;
+        for (unsigned int i = 0; i < subdivisions; i++)
+            subdivideTriangles(meshVertices, meshIndices);
+
+        VisibilityMesh range;
+        range.mesh = &mesh;
+        range.firstTriangle = (unsigned int)(indices.size() / 3);
+        range.triangleCount = (unsigned int)(meshIndices.size() / 3);
+        geometry.meshes.push_back(range);
+        // the mesh's indices point past the vertices of the meshes before it
+        const unsigned int baseVertex = (unsigned int)vertices.size();
+        for (unsigned int index : meshIndices)
+            indices.push_back(baseVertex + index);
+        vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+    }
+    geometry.triangleCount = (unsigned int)(indices.size() / 3);
+    if (geometry.triangleCount > VISIBILITY_MAX_TRIANGLES)
+        std::cout << "ERROR::VISIBILITY:: " << geometry.triangleCount << " triangles don't fit in a visibility buffer" << std::endl;
+
+    glGenVertexArrays(1, &geometry.VAO);
+    glGenBuffers(1, &geometry.vertexBuffer);
+    glGenBuffers(1, &geometry.indexBuffer);
+    glBindVertexArray(geometry.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, geometry.vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VisibilityVertex), vertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, geometry.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VisibilityVertex), (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VisibilityVertex), (void*)offsetof(VisibilityVertex, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VisibilityVertex), (void*)offsetof(VisibilityVertex, TexCoords));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    vector<glm::vec3> positions(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+        positions[i] = vertices[i].Position;
+    geometry.depthStream = createDepthStream(positions, vector<DepthSkin>(), indices);
+    return geometry;
+}
+
+// draw instanceCount instances of the triangles of the geometry's mesh with the given index, with all attributes
+void drawVisibilityMesh(const VisibilityGeometry &geometry, unsigned int mesh, unsigned int instanceCount = 1)
+{
+    const VisibilityMesh &range = geometry.meshes[mesh];
+    glBindVertexArray(geometry.VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, range.triangleCount * 3, GL_UNSIGNED_INT, (void*)(range.firstTriangle * 3 * sizeof(unsigned int)), instanceCount);
+    glBindVertexArray(0);
+}
+
+// bind the vertex and index buffers as the storage buffers the resolve pass fetches the corners of triangles from
+void bindVisibilityGeometry(const VisibilityGeometry &geometry, unsigned int vertexBinding, unsigned int indexBinding)
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, vertexBinding, geometry.vertexBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, indexBinding, geometry.indexBuffer);
+}
+
+void deleteVisibilityGeometry(VisibilityGeometry &geometry)
+{
+    glDeleteVertexArrays(1, &geometry.VAO);
+    glDeleteBuffers(1, &geometry.vertexBuffer);
+    glDeleteBuffers(1, &geometry.indexBuffer);
+    deleteDepthStream(geometry.depthStream);
+    geometry = VisibilityGeometry();
+}
+#endif
@@ -0,0 +1,71 @@
+#version 430 core
+
+// must match LOD_COUNT in instance_culling.h
+#define LOD_COUNT 3
+
+layout (local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+// CompactTransform in instance_transform.h
+struct Instance
+{
+    vec4 positionScale;
+    vec4 rotation;
+};
+
+struct DrawElementsIndirectCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int  baseVertex;
+    uint baseInstance;
+};
+
+// every instance of the field, written once at startup
+layout (std430, binding = 0) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+// one command per LOD, instanceCount is reset to 0 before the dispatch
+layout (std430, binding = 1) buffer DrawCommands
+{
+    DrawElementsIndirectCommand commands[];
+};
+
+// surviving instances, LOD i being stored from commands[i].baseInstance
+layout (std430, binding = 2) writeonly buffer VisibleInstances
+{
+    Instance visibleInstances[];
+};
+
+uniform vec4 frustumPlanes[6]; // xyz normal pointing inside, w so that dot(xyz, p) + w is the signed distance
+uniform vec3 cameraPosition;
+uniform float lodDistances[LOD_COUNT - 1];
+uniform float boundingRadius;
+uniform uint instanceCount;
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= instanceCount)
+        return;
+
+    Instance instance = instances[id];
+    vec3 center = instance.positionScale.xyz;
+    float radius = boundingRadius * instance.positionScale.w;
+
+    for (int i = 0; i < 6; ++i)
+    {
+        if (dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w < -radius)
+            return;
+    }
+
+    float distance = length(center - cameraPosition);
+    uint lod = 0;
+    while (lod < LOD_COUNT - 1 && distance > lodDistances[lod])
+        lod++;
+
+    uint slot = atomicAdd(commands[lod].instanceCount, 1);
+    visibleInstances[commands[lod].baseInstance + slot] = instance;
+}
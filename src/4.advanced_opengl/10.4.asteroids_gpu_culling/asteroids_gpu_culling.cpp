@@ -0,0 +1,377 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <stb_image.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_c.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/model.h>
+#include <learnopengl/mesh_lod.h>
+
+#include "instance_culling.h"
+
+#include <iostream>
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(GLFWwindow *window);
+
+// settings
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+
+// instances
+const unsigned int MAX_INSTANCES = 1000000;
+unsigned int amount = 100000; // instances culled and drawn this frame, UP/DOWN doubles/halves it
+bool amountKeyPressed = false;
+bool gpuCulling = true;       // C switches to the CPU reference implementation
+bool gpuCullingKeyPressed = false;
+
+// camera
+Camera camera(glm::vec3(0.0f, 0.0f, 155.0f));
+float lastX = (float)SCR_WIDTH / 2.0;
+float lastY = (float)SCR_HEIGHT / 2.0;
+bool firstMouse = true;
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+int main()
+{
+    // glfw: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // glfw window creation
+    // --------------------
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+
+    // tell GLFW to capture our mouse
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    // glad: load all OpenGL function pointers
+    // ---------------------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    // don't wait for vsync so the measured frame time is the actual cost of the frame
+    glfwSwapInterval(0);
+
+    // configure global opengl state
+    // -----------------------------
+    glEnable(GL_DEPTH_TEST);
+
+    // build and compile shaders
+    // -------------------------
+    Shader asteroidShader("10.4.asteroids.vs", "10.4.asteroids.fs");
+    Shader planetShader("10.4.planet.vs", "10.4.planet.fs");
+    ComputeShader cullingShader("10.4.instance_culling.cs");
+
+    // load models
+    // -----------
+    Model rock(FileSystem::getPath("resources/objects/rock/rock.obj"));
+    Model planet(FileSystem::getPath("resources/objects/planet/planet.obj"));
+
+    // build the levels of detail of the rock (a single mesh) by clustering its vertices on coarser and coarser grids
+    // ---------------------------------------------------------------------------------------------------------------
+    glm::vec3 rockMin(std::numeric_limits<float>::max()), rockMax(-std::numeric_limits<float>::max());
+    float boundingRadius = 0.0f;
+    for (const Vertex& vertex : rock.meshes[0].vertices)
+    {
+        rockMin = glm::min(rockMin, vertex.Position);
+        rockMax = glm::max(rockMax, vertex.Position);
+        boundingRadius = std::max(boundingRadius, glm::length(vertex.Position));
+    }
+    const float rockSize = glm::length(rockMax - rockMin);
+    vector<Mesh> rockLODs;
+    rockLODs.push_back(rock.meshes[0]);
+    rockLODs.push_back(generateClusteredLOD(rock.meshes[0], rockSize * 0.15f));
+    rockLODs.push_back(generateClusteredLOD(rock.meshes[0], rockSize * 0.35f));
+    for (unsigned int lod = 0; lod < LOD_COUNT; lod++)
+        std::cout << "LOD " << lod << " : " << rockLODs[lod].indices.size() / 3 << " triangles" << std::endl;
+
+    // generate a large list of semi-random transformations, stored as position, scale and rotation (32 bytes instead of
+    // the 64 of a matrix) since the rocks are rigid and uniformly scaled
+    // -----------------------------------------------------------------------------------------------------------------
+    CompactTransform* instances;
+    instances = new CompactTransform[MAX_INSTANCES];
+    srand(static_cast<unsigned int>(glfwGetTime())); // initialize random seed
+    float radius = 150.0;
+    float offset = 25.0f;
+    for (unsigned int i = 0; i < MAX_INSTANCES; i++)
+    {
+        // 1. translation: displace along circle with 'radius' in range [-offset, offset]
+        float angle = (float)i / (float)MAX_INSTANCES * 360.0f;
+        float displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+        float x = sin(angle) * radius + displacement;
+        displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+        float y = displacement * 0.4f; // keep height of asteroid field smaller compared to width of x and z
+        displacement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+        float z = cos(angle) * radius + displacement;
+
+        // 2. scale: Scale between 0.05 and 0.25f
+        float scale = static_cast<float>((rand() % 20) / 100.0 + 0.05);
+
+        // 3. rotation: add random rotation around a (semi)randomly picked rotation axis vector
+        float rotAngle = static_cast<float>((rand() % 360));
+        glm::quat rotation = glm::angleAxis(rotAngle, glm::normalize(glm::vec3(0.4f, 0.6f, 0.8f)));
+
+        // 4. now add to list of instances
+        instances[i] = CompactTransform(glm::vec3(x, y, z), scale, rotation);
+    }
+
+    // upload every instance once, the culling shader reads them from there
+    // --------------------------------------------------------------------
+    unsigned int instanceSSBO;
+    glGenBuffers(1, &instanceSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_INSTANCES * sizeof(CompactTransform), &instances[0], GL_STATIC_DRAW);
+
+    // the surviving instances are compacted per LOD in this buffer, LOD i starting at instance i * MAX_INSTANCES.
+    // it's attached to the VAO of every LOD as the instance transform stream, baseInstance of the draw commands selects the region.
+    // ----------------------------------------------------------------------------------------------------------------------
+    InstanceBuffer<CompactTransform> visibleInstances(CompactTransformLayout(FIRST_INSTANCE_ATTRIBUTE), GL_DYNAMIC_DRAW);
+    visibleInstances.Update(nullptr, LOD_COUNT * MAX_INSTANCES);
+    for (unsigned int lod = 0; lod < LOD_COUNT; lod++)
+        rockLODs[lod].AttachInstanceStreams({ &visibleInstances });
+
+    // one indirect draw command per LOD, the culling stage fills in instanceCount
+    // ---------------------------------------------------------------------------
+    DrawElementsIndirectCommand resetCommands[LOD_COUNT];
+    for (unsigned int lod = 0; lod < LOD_COUNT; lod++)
+        resetCommands[lod] = { static_cast<unsigned int>(rockLODs[lod].indices.size()), 0, 0, 0, lod * MAX_INSTANCES };
+    unsigned int commandBuffer;
+    glGenBuffers(1, &commandBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(resetCommands), resetCommands, GL_DYNAMIC_DRAW);
+
+    InstanceCullingParams cullingParams;
+    cullingParams.lodDistances[0] = 30.0f;
+    cullingParams.lodDistances[1] = 90.0f;
+    cullingParams.boundingRadius = boundingRadius;
+    vector<CompactTransform> cpuVisible[LOD_COUNT];
+
+    // statistics, printed every second
+    unsigned int statFrames = 0;
+    double statStart = glfwGetTime();
+
+    // render loop
+    // -----------
+    while (!glfwWindowShouldClose(window))
+    {
+        // per-frame time logic
+        // --------------------
+        float currentFrame = static_cast<float>(glfwGetTime());
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        // input
+        // -----
+        processInput(window);
+
+        // render
+        // ------
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // configure transformation matrices
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+        asteroidShader.use();
+        asteroidShader.setMat4("projection", projection);
+        asteroidShader.setMat4("view", view);
+        planetShader.use();
+        planetShader.setMat4("projection", projection);
+        planetShader.setMat4("view", view);
+
+        // draw planet
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
+        planetShader.setMat4("model", model);
+        planet.Draw(planetShader);
+
+        // cull the meteorites and fill the draw commands
+        // ----------------------------------------------
+        cullingParams.frustum = createFrustumFromMatrix(projection * view);
+        cullingParams.cameraPosition = camera.Position;
+        if (gpuCulling)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(resetCommands), resetCommands);
+
+            cullingShader.use();
+            const Plane* planes[6] = { &cullingParams.frustum.leftFace, &cullingParams.frustum.rightFace, &cullingParams.frustum.topFace,
+                &cullingParams.frustum.bottomFace, &cullingParams.frustum.nearFace, &cullingParams.frustum.farFace };
+            for (unsigned int i = 0; i < 6; i++)
+                cullingShader.setVec4("frustumPlanes[" + std::to_string(i) + "]", glm::vec4(planes[i]->normal, -planes[i]->distance));
+            cullingShader.setVec3("cameraPosition", camera.Position);
+            for (unsigned int i = 0; i < LOD_COUNT - 1; i++)
+                cullingShader.setFloat("lodDistances[" + std::to_string(i) + "]", cullingParams.lodDistances[i]);
+            cullingShader.setFloat("boundingRadius", boundingRadius);
+            glUniform1ui(glGetUniformLocation(cullingShader.ID, "instanceCount"), amount);
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceSSBO);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, visibleInstances.ID);
+            glDispatchCompute((amount + 63) / 64, 1, 1);
+            // the commands and instance attributes are consumed by the draws below, the counts by the stats readback
+            glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        }
+        else
+        {
+            cullInstancesReference(instances, amount, cullingParams, cpuVisible);
+
+            DrawElementsIndirectCommand commands[LOD_COUNT];
+            glBindBuffer(GL_ARRAY_BUFFER, visibleInstances.ID);
+            for (unsigned int lod = 0; lod < LOD_COUNT; lod++)
+            {
+                commands[lod] = resetCommands[lod];
+                commands[lod].instanceCount = static_cast<unsigned int>(cpuVisible[lod].size());
+                if (!cpuVisible[lod].empty())
+                    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)lod * MAX_INSTANCES * sizeof(CompactTransform), cpuVisible[lod].size() * sizeof(CompactTransform), cpuVisible[lod].data());
+            }
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(commands), commands);
+        }
+
+        // draw meteorites, one indirect draw per LOD
+        // ------------------------------------------
+        asteroidShader.use();
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        for (unsigned int lod = 0; lod < LOD_COUNT; lod++)
+            rockLODs[lod].DrawIndirect(asteroidShader, lod * sizeof(DrawElementsIndirectCommand));
+
+        // print the visible instances per LOD and the frame time against the instance count
+        // ---------------------------------------------------------------------------------
+        statFrames++;
+        if (glfwGetTime() - statStart >= 1.0)
+        {
+            DrawElementsIndirectCommand commands[LOD_COUNT];
+            glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(commands), commands);
+            std::cout << (gpuCulling ? "GPU" : "CPU") << " culling, " << amount << " instances : " << (glfwGetTime() - statStart) * 1000.0 / statFrames << " ms/frame, visible";
+            for (unsigned int lod = 0; lod < LOD_COUNT; lod++)
+                std::cout << " LOD" << lod << " " << commands[lod].instanceCount;
+            std::cout << std::endl;
+            statFrames = 0;
+            statStart = glfwGetTime();
+        }
+
+        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+        // -------------------------------------------------------------------------------
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    glfwTerminate();
+    return 0;
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow *window)
+{
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !gpuCullingKeyPressed)
+    {
+        gpuCulling = !gpuCulling;
+        gpuCullingKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+    {
+        gpuCullingKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS && !amountKeyPressed)
+    {
+        amount = std::min(amount * 2, MAX_INSTANCES);
+        amountKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS && !amountKeyPressed)
+    {
+        amount = std::max(amount / 2, 1000u);
+        amountKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_RELEASE && glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_RELEASE)
+    {
+        amountKeyPressed = false;
+    }
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+    // make sure the viewport matches the new window dimensions; note that width and 
+    // height will be significantly larger than specified on retina displays.
+    glViewport(0, 0, width, height);
+}
+
+// glfw: whenever the mouse moves, this callback is called
+// -------------------------------------------------------
+void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
+{
+    float xpos = static_cast<float>(xposIn);
+    float ypos = static_cast<float>(yposIn);
+
+    if (firstMouse)
+    {
+        lastX = xpos;
+        lastY = ypos;
+        firstMouse = false;
+    }
+
+    float xoffset = xpos - lastX;
+    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+
+    lastX = xpos;
+    lastY = ypos;
+
+    camera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    camera.ProcessMouseScroll(static_cast<float>(yoffset));
+}
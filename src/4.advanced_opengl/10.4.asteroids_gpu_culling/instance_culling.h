@@ -0,0 +1,51 @@
+#ifndef INSTANCE_CULLING_H
+#define INSTANCE_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+#include <learnopengl/instance_transform.h>
+
+#include <vector>
+
+// number of levels of detail the culling stage sorts the instances into, must match 10.4.instance_culling.cs
+#define LOD_COUNT 3
+
+struct InstanceCullingParams
+{
+    Frustum frustum;
+    glm::vec3 cameraPosition;
+    float lodDistances[LOD_COUNT - 1]; // an instance farther than lodDistances[i] uses LOD i + 1
+    float boundingRadius;              // of the unscaled model, around its origin
+};
+
+// CPU reference implementation of 10.4.instance_culling.cs: frustum test each instance with its bounding sphere, pick its
+// LOD from the camera distance and append it to the list of that LOD.
+void cullInstancesReference(const CompactTransform* instances, unsigned int count, const InstanceCullingParams& params, std::vector<CompactTransform> visible[LOD_COUNT])
+{
+    const Plane* planes[6] = { &params.frustum.leftFace, &params.frustum.rightFace, &params.frustum.topFace,
+        &params.frustum.bottomFace, &params.frustum.nearFace, &params.frustum.farFace };
+
+    for (unsigned int lod = 0; lod < LOD_COUNT; lod++)
+        visible[lod].clear();
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const CompactTransform& instance = instances[i];
+        const glm::vec3& center = instance.position;
+        const float radius = params.boundingRadius * instance.scale;
+
+        bool inside = true;
+        for (unsigned int p = 0; p < 6 && inside; p++)
+            inside = planes[p]->getSignedDistanceToPlane(center) >= -radius;
+        if (!inside)
+            continue;
+
+        const float distance = glm::length(center - params.cameraPosition);
+        unsigned int lod = 0;
+        while (lod < LOD_COUNT - 1 && distance > params.lodDistances[lod])
+            lod++;
+        visible[lod].push_back(instance);
+    }
+}
+#endif
@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+in vec3 Normal;
+
+uniform sampler2D texture_diffuse1;
+uniform vec3 lightDirection; // towards the light
+
+void main()
+{
+    float diffuse = max(dot(normalize(Normal), lightDirection), 0.0);
+    FragColor = vec4(texture(texture_diffuse1, TexCoords).rgb * (0.3 + 0.7 * diffuse), 1.0);
+}
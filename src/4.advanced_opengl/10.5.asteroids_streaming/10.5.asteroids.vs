@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in vec4 aInstancePositionScale; // xyz position, w uniform scale
+layout (location = 8) in vec4 aInstanceRotation;      // unit quaternion
+
+out vec2 TexCoords;
+out vec3 Normal;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    TexCoords = aTexCoords;
+    Normal = rotate(aInstanceRotation, aNormal);
+    vec3 worldPos = aInstancePositionScale.xyz + aInstancePositionScale.w * rotate(aInstanceRotation, aPos);
+    gl_Position = projection * view * vec4(worldPos, 1.0f);
+}
@@ -0,0 +1,54 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 FrameUV;
+in vec3 WorldPos;
+flat in vec2 Frame;
+flat in vec2 FrameWeights;
+flat in vec4 Rotation;
+flat in vec3 ToCamera;
+flat in float WorldRadius;
+
+uniform sampler2D albedoAtlas;
+uniform sampler2D normalAtlas;
+uniform sampler2D depthAtlas;
+uniform float gridSize;
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 lightDirection; // towards the light
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    // blend the 4 frames around the view direction, weighting every sample by its coverage so the texels outside
+    // the silhouette of a frame don't darken the others
+    vec4 albedo = vec4(0.0);
+    vec3 normal = vec3(0.0);
+    float depth = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        vec2 offset = vec2(i & 1, i >> 1);
+        vec2 weight2 = mix(1.0 - FrameWeights, FrameWeights, offset);
+        vec2 uv = (Frame + offset + FrameUV) / gridSize;
+        vec4 sampleAlbedo = texture(albedoAtlas, uv);
+        float weight = weight2.x * weight2.y * sampleAlbedo.a;
+        albedo += vec4(sampleAlbedo.rgb, 1.0) * weight;
+        normal += (texture(normalAtlas, uv).xyz * 2.0 - 1.0) * weight;
+        depth += texture(depthAtlas, uv).r * weight;
+    }
+    if (albedo.a < 0.5)
+        discard;
+
+    // move the fragment off the quad to the baked surface so impostors intersect correctly with everything else
+    vec3 position = WorldPos + ToCamera * (depth / albedo.a) * WorldRadius;
+    vec4 clipPos = projection * view * vec4(position, 1.0);
+    gl_FragDepth = clipPos.z / clipPos.w * 0.5 + 0.5;
+
+    normal = normalize(rotate(Rotation, normal));
+    float diffuse = max(dot(normal, lightDirection), 0.0);
+    FragColor = vec4(albedo.rgb / albedo.a * (0.3 + 0.7 * diffuse), 1.0);
+}
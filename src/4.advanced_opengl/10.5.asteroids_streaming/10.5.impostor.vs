@@ -0,0 +1,69 @@
+#version 330 core
+layout (location = 0) in vec3 aPos; // quad corner in [-1, 1]
+layout (location = 7) in vec4 aInstancePositionScale;
+layout (location = 8) in vec4 aInstanceRotation;
+
+out vec2 FrameUV;
+out vec3 WorldPos;
+flat out vec2 Frame;        // lower left of the 2x2 frames blended
+flat out vec2 FrameWeights; // bilinear weights between them
+flat out vec4 Rotation;
+flat out vec3 ToCamera;
+flat out float WorldRadius;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 cameraPosition;
+uniform vec3 impostorCenter;
+uniform float impostorRadius;
+uniform float gridSize;
+uniform bool hemisphere;
+
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+vec2 signNotZero(vec2 v)
+{
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// inverse of Impostor::DecodeDirection
+vec2 encodeDirection(vec3 d)
+{
+    if (hemisphere)
+        d.y = max(d.y, 0.0);
+    vec2 q = d.xz / (abs(d.x) + abs(d.y) + abs(d.z));
+    if (hemisphere)
+        return vec2(q.x + q.y, q.x - q.y) * 0.5 + 0.5;
+    if (d.y < 0.0)
+        q = (1.0 - abs(q.yx)) * signNotZero(q);
+    return q * 0.5 + 0.5;
+}
+
+void main()
+{
+    float scale = aInstancePositionScale.w;
+    vec3 worldCenter = aInstancePositionScale.xyz + scale * rotate(aInstanceRotation, impostorCenter);
+    ToCamera = normalize(cameraPosition - worldCenter);
+    Rotation = aInstanceRotation;
+    WorldRadius = impostorRadius * scale;
+
+    // view direction in object space picks the frames
+    vec3 direction = rotate(vec4(-aInstanceRotation.xyz, aInstanceRotation.w), ToCamera);
+    vec2 grid = encodeDirection(direction) * (gridSize - 1.0);
+    Frame = min(floor(grid), vec2(gridSize - 2.0));
+    FrameWeights = grid - Frame;
+
+    // span the quad with the same basis the frames were baked with
+    vec3 forward = -direction;
+    vec3 up = abs(direction.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(forward, up));
+    up = cross(right, forward);
+    vec3 objectPos = impostorCenter + impostorRadius * (right * aPos.x + up * aPos.y);
+
+    FrameUV = aPos.xy * 0.5 + 0.5;
+    WorldPos = aInstancePositionScale.xyz + scale * rotate(aInstanceRotation, objectPos);
+    gl_Position = projection * view * vec4(WorldPos, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) out vec4 Albedo;
+layout (location = 1) out vec4 NormalOut;
+layout (location = 2) out float Depth;
+
+in vec2 TexCoords;
+in vec3 Normal;
+in float ViewZ;
+
+uniform sampler2D texture_diffuse1;
+uniform float radius;
+
+void main()
+{
+    Albedo = vec4(texture(texture_diffuse1, TexCoords).rgb, 1.0);
+    NormalOut = vec4(normalize(Normal) * 0.5 + 0.5, 1.0);
+    // the camera is 2 * radius away from the center: distance in front of the center, in radii
+    Depth = (2.0 * radius + ViewZ) / radius;
+}
@@ -0,0 +1,20 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec2 TexCoords;
+out vec3 Normal;
+out float ViewZ;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+void main()
+{
+    TexCoords = aTexCoords;
+    Normal = aNormal; // the atlas keeps object space normals
+    vec4 viewPos = view * vec4(aPos, 1.0);
+    ViewZ = viewPos.z;
+    gl_Position = projection * viewPos;
+}
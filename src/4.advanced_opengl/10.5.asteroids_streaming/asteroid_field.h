@@ -0,0 +1,413 @@
+#ifndef ASTEROID_FIELD_H
+#define ASTEROID_FIELD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/batch_culling.h>
+#include <learnopengl/instance_transform.h>
+#include <learnopengl/impostor.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+struct AsteroidFieldSettings
+{
+    float cellSize = 40.0f;             // chunks are square cells of the xz plane
+    float fieldHeight = 10.0f;          // instances are spread in [-fieldHeight, fieldHeight] on y
+    float streamRadius = 400.0f;        // cells whose center is closer to the camera than this are generated
+    float evictRadius = 480.0f;         // and resident cells farther than this are evicted, the gap avoids thrashing at the border
+    float impostorDistance = 120.0f;    // cells entirely farther than this are drawn as impostors, when the field has one
+    unsigned int maxInstancesPerChunk = 1024;
+    unsigned int chunkSlots = 640;      // chunks the instance buffer can hold at once
+    unsigned int workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    uint64_t seed = 1337;
+};
+
+struct AsteroidFieldStats
+{
+    unsigned int residentChunks = 0;
+    unsigned int residentInstances = 0;
+    unsigned int pendingChunks = 0;     // requested or being generated
+    unsigned int visibleChunks = 0;
+    unsigned int visibleMeshInstances = 0;
+    unsigned int visibleImpostorInstances = 0;
+    size_t visibleVertices = 0;         // vertices the visible instances submit, 4 per impostor
+    unsigned int generatedChunks = 0;   // since the last call to resetGenerationStats
+    double generationMs = 0.0;          // summed over the worker threads, since the last call to resetGenerationStats
+    size_t residentBytes = 0;           // instance data actually used by the resident chunks
+    size_t bufferBytes = 0;             // size of the instance buffer the chunks are sub-allocated from
+
+    void resetGenerationStats()
+    {
+        generatedChunks = 0;
+        generationMs = 0.0;
+    }
+};
+
+// Instances of one cell, as many as the density of the cell asks for. The result only depends on the cell coordinates
+// and the seed, so an evicted cell comes back identical.
+void generateAsteroidChunk(int cellX, int cellZ, const AsteroidFieldSettings& settings, std::vector<CompactTransform>& instances);
+
+// Procedural asteroid field without bounds, streamed around the camera in square cells. Missing cells in the stream
+// radius are generated on worker threads, nearest first, and uploaded by update() into a fixed slot of one shared
+// instance buffer; cells leaving the evict radius give their slot back. Every visible cell is then one command of a
+// single glMultiDrawElementsIndirect, baseInstance pointing at its slot. Cells far enough from the camera can switch to
+// an octahedral impostor of the rock, a quad per instance instead of the full mesh.
+class AsteroidField
+{
+public:
+    AsteroidField(const AsteroidFieldSettings& settings = AsteroidFieldSettings())
+        : m_settings(settings),
+          m_instances(CompactTransformLayout(FIRST_INSTANCE_ATTRIBUTE), GL_DYNAMIC_DRAW)
+    {
+        m_instances.Update(nullptr, m_settings.chunkSlots * m_settings.maxInstancesPerChunk);
+        for (unsigned int slot = m_settings.chunkSlots; slot > 0; --slot)
+            m_freeSlots.push_back(slot - 1);
+
+        glGenBuffers(1, &m_commandBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, m_settings.chunkSlots * sizeof(DrawElementsIndirectCommand), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        for (unsigned int i = 0; i < m_settings.workerCount; ++i)
+            m_workers.emplace_back([this]() { workerLoop(); });
+    }
+
+    ~AsteroidField()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wakeUp.notify_all();
+        for (auto&& worker : m_workers)
+            worker.join();
+    }
+
+    AsteroidField(const AsteroidField&) = delete;
+    AsteroidField& operator=(const AsteroidField&) = delete;
+
+    const InstanceStream& getInstances() const
+    {
+        return m_instances;
+    }
+
+    // Upload the chunks finished since the last call, evict the cells that went out of range and queue the missing ones.
+    // Must be called from the thread owning the GL context.
+    void update(const glm::vec3& cameraPosition)
+    {
+        std::vector<GeneratedChunk> completed;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            completed.swap(m_completed);
+        }
+
+        for (GeneratedChunk& generated : completed)
+        {
+            m_inFlight.erase(generated.key);
+            m_stats.generatedChunks++;
+            m_stats.generationMs += generated.milliseconds;
+            // the camera may have moved away while the chunk was generated
+            if (cellDistance(generated.cellX, generated.cellZ, cameraPosition) > m_settings.evictRadius || m_freeSlots.empty())
+                continue;
+
+            Chunk chunk;
+            chunk.cellX = generated.cellX;
+            chunk.cellZ = generated.cellZ;
+            chunk.slot = m_freeSlots.back();
+            chunk.count = static_cast<unsigned int>(generated.instances.size());
+            m_freeSlots.pop_back();
+            if (chunk.count > 0)
+                m_instances.UpdateRange(generated.instances.data(), chunk.slot * m_settings.maxInstancesPerChunk, chunk.count);
+            m_chunks[generated.key] = chunk;
+            m_stats.residentInstances += chunk.count;
+        }
+
+        for (auto it = m_chunks.begin(); it != m_chunks.end();)
+        {
+            if (cellDistance(it->second.cellX, it->second.cellZ, cameraPosition) > m_settings.evictRadius)
+            {
+                m_freeSlots.push_back(it->second.slot);
+                m_stats.residentInstances -= it->second.count;
+                it = m_chunks.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        // requests still waiting for a worker are withdrawn and queued again below if still wanted, so cells the camera
+        // already left are never generated and the nearest cells go first
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (uint64_t key : m_requests)
+                m_inFlight.erase(key);
+            m_requests.clear();
+        }
+
+        // cells in the stream radius that are neither resident nor being generated, nearest first
+        std::vector<std::pair<float, uint64_t>> missing;
+        const int cellRadius = static_cast<int>(std::ceil(m_settings.streamRadius / m_settings.cellSize));
+        const int cameraCellX = static_cast<int>(std::floor(cameraPosition.x / m_settings.cellSize));
+        const int cameraCellZ = static_cast<int>(std::floor(cameraPosition.z / m_settings.cellSize));
+        for (int z = cameraCellZ - cellRadius; z <= cameraCellZ + cellRadius; ++z)
+        {
+            for (int x = cameraCellX - cellRadius; x <= cameraCellX + cellRadius; ++x)
+            {
+                const float distance = cellDistance(x, z, cameraPosition);
+                const uint64_t key = cellKey(x, z);
+                if (distance <= m_settings.streamRadius && m_chunks.find(key) == m_chunks.end() && m_inFlight.find(key) == m_inFlight.end())
+                    missing.push_back({ distance, key });
+            }
+        }
+        std::sort(missing.begin(), missing.end());
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& request : missing)
+            {
+                m_requests.push_back(request.second);
+                m_inFlight.insert(request.second);
+            }
+        }
+        if (!missing.empty())
+            m_wakeUp.notify_all();
+
+        m_stats.residentChunks = static_cast<unsigned int>(m_chunks.size());
+        m_stats.pendingChunks = static_cast<unsigned int>(m_inFlight.size());
+        m_stats.residentBytes = static_cast<size_t>(m_stats.residentInstances) * sizeof(CompactTransform);
+        m_stats.bufferBytes = static_cast<size_t>(m_instances.capacity) * sizeof(CompactTransform);
+    }
+
+    // Draw the cells farther than settings.impostorDistance as quads of this impostor, with the given shader. The impostor
+    // must outlive the field or be replaced; nullptr draws every cell with the mesh again.
+    void setImpostor(Impostor* impostor, Shader* impostorShader)
+    {
+        m_impostor = impostor;
+        m_impostorShader = impostorShader;
+        if (m_impostor)
+            m_impostor->Quad.AttachInstanceStreams({ &m_instances });
+    }
+
+    // Frustum cull the resident cells and draw the visible ones, near cells with the mesh and far cells with the impostor
+    // (if any), each with a single multi draw. The mesh must have the instance stream of the field attached (see
+    // getInstances).
+    void draw(Mesh& mesh, Shader& shader, const Frustum& frustum, const glm::vec3& cameraPosition)
+    {
+        const float margin = 1.0f; // a scaled rock sticks out of its cell by less than this
+        // rebuilt every frame, it's a few hundred cells (the arrays keep their capacity)
+        m_bounds.count = 0;
+        m_boundChunks.clear();
+        for (const auto& entry : m_chunks)
+        {
+            const Chunk& chunk = entry.second;
+            if (chunk.count == 0)
+                continue;
+            const glm::vec3 center((chunk.cellX + 0.5f) * m_settings.cellSize, 0.0f, (chunk.cellZ + 0.5f) * m_settings.cellSize);
+            const glm::vec3 extents(0.5f * m_settings.cellSize + margin, m_settings.fieldHeight + margin, 0.5f * m_settings.cellSize + margin);
+            m_bounds.add(center, extents, nullptr);
+            m_boundChunks.push_back(&chunk);
+        }
+
+        m_visible.resize(m_bounds.count + 8);
+        const unsigned int visibleCount = cullBounds(frustum, m_bounds, m_visible.data());
+
+        m_commands.clear();
+        m_impostorCommands.clear();
+        m_stats.visibleMeshInstances = 0;
+        m_stats.visibleImpostorInstances = 0;
+        for (unsigned int i = 0; i < visibleCount; ++i)
+        {
+            const Chunk& chunk = *m_boundChunks[m_visible[i]];
+            const unsigned int baseInstance = chunk.slot * m_settings.maxInstancesPerChunk;
+            if (m_impostor && nearestCellDistance(chunk.cellX, chunk.cellZ, cameraPosition) > m_settings.impostorDistance)
+            {
+                m_impostorCommands.push_back({ static_cast<unsigned int>(m_impostor->Quad.indices.size()), chunk.count, 0, 0, baseInstance });
+                m_stats.visibleImpostorInstances += chunk.count;
+            }
+            else
+            {
+                m_commands.push_back({ static_cast<unsigned int>(mesh.indices.size()), chunk.count, 0, 0, baseInstance });
+                m_stats.visibleMeshInstances += chunk.count;
+            }
+        }
+        m_stats.visibleChunks = visibleCount;
+        m_stats.visibleVertices = static_cast<size_t>(m_stats.visibleMeshInstances) * mesh.vertices.size() + static_cast<size_t>(m_stats.visibleImpostorInstances) * 4;
+
+        // mesh commands first, impostor commands after them
+        const size_t meshBytes = m_commands.size() * sizeof(DrawElementsIndirectCommand);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+        if (!m_commands.empty())
+        {
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, meshBytes, m_commands.data());
+            mesh.MultiDrawIndirect(shader, 0, static_cast<unsigned int>(m_commands.size()));
+        }
+        if (!m_impostorCommands.empty())
+        {
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, meshBytes, m_impostorCommands.size() * sizeof(DrawElementsIndirectCommand), m_impostorCommands.data());
+            m_impostorShader->use();
+            m_impostor->Bind(*m_impostorShader);
+            m_impostor->Quad.MultiDrawIndirect(*m_impostorShader, meshBytes, static_cast<unsigned int>(m_impostorCommands.size()));
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    AsteroidFieldStats& getStats()
+    {
+        return m_stats;
+    }
+
+private:
+    struct Chunk
+    {
+        int cellX, cellZ;
+        unsigned int slot;
+        unsigned int count;
+    };
+
+    struct GeneratedChunk
+    {
+        uint64_t key;
+        int cellX, cellZ;
+        std::vector<CompactTransform> instances;
+        double milliseconds;
+    };
+
+    AsteroidFieldSettings m_settings;
+    AsteroidFieldStats m_stats;
+
+    // main thread only
+    InstanceBuffer<CompactTransform> m_instances;
+    unsigned int m_commandBuffer = 0;
+    std::unordered_map<uint64_t, Chunk> m_chunks;
+    std::unordered_set<uint64_t> m_inFlight; // requested or being generated
+    std::vector<unsigned int> m_freeSlots;
+    BoundsSoA m_bounds;
+    std::vector<const Chunk*> m_boundChunks;
+    std::vector<unsigned int> m_visible;
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    std::vector<DrawElementsIndirectCommand> m_impostorCommands;
+    Impostor* m_impostor = nullptr;
+    Shader* m_impostorShader = nullptr;
+
+    // shared with the workers, guarded by m_mutex
+    std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::deque<uint64_t> m_requests;
+    std::vector<GeneratedChunk> m_completed;
+    std::vector<std::thread> m_workers;
+    bool m_quit = false;
+
+    static uint64_t cellKey(int cellX, int cellZ)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cellX)) << 32) | static_cast<uint32_t>(cellZ);
+    }
+
+    float cellDistance(int cellX, int cellZ, const glm::vec3& position) const
+    {
+        const glm::vec2 center((cellX + 0.5f) * m_settings.cellSize, (cellZ + 0.5f) * m_settings.cellSize);
+        return glm::length(center - glm::vec2(position.x, position.z));
+    }
+
+    // distance to the closest point of the cell, on the xz plane
+    float nearestCellDistance(int cellX, int cellZ, const glm::vec3& position) const
+    {
+        const glm::vec2 cellMin(cellX * m_settings.cellSize, cellZ * m_settings.cellSize);
+        const glm::vec2 point(position.x, position.z);
+        return glm::length(point - glm::clamp(point, cellMin, cellMin + m_settings.cellSize));
+    }
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            GeneratedChunk generated;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wakeUp.wait(lock, [this]() { return m_quit || !m_requests.empty(); });
+                if (m_quit)
+                    return;
+                generated.key = m_requests.front();
+                m_requests.pop_front();
+            }
+
+            generated.cellX = static_cast<int>(static_cast<int32_t>(generated.key >> 32));
+            generated.cellZ = static_cast<int>(static_cast<int32_t>(generated.key & 0xFFFFFFFFu));
+            const auto start = std::chrono::steady_clock::now();
+            generateAsteroidChunk(generated.cellX, generated.cellZ, m_settings, generated.instances);
+            generated.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_completed.push_back(std::move(generated));
+        }
+    }
+};
+
+// splitmix64, a cheap hash with good enough avalanche to seed each cell independently
+uint64_t hashCell(int cellX, int cellZ, uint64_t seed)
+{
+    uint64_t h = seed ^ ((static_cast<uint64_t>(static_cast<uint32_t>(cellX)) << 32) | static_cast<uint32_t>(cellZ));
+    h += 0x9E3779B97F4A7C15ull;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    return h ^ (h >> 31);
+}
+
+// smooth value noise in [0, 1] over the cell lattice, scale being the number of cells per noise period
+float cellDensity(int cellX, int cellZ, uint64_t seed, int scale)
+{
+    auto floorDiv = [](int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); };
+    auto lattice = [seed](int x, int z) { return (hashCell(x, z, seed) >> 40) / float(1 << 24); };
+
+    const int x0 = floorDiv(cellX, scale);
+    const int z0 = floorDiv(cellZ, scale);
+    float fx = (cellX - x0 * scale) / float(scale);
+    float fz = (cellZ - z0 * scale) / float(scale);
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fz = fz * fz * (3.0f - 2.0f * fz);
+    const float top = glm::mix(lattice(x0, z0), lattice(x0 + 1, z0), fx);
+    const float bottom = glm::mix(lattice(x0, z0 + 1), lattice(x0 + 1, z0 + 1), fx);
+    return glm::mix(top, bottom, fz);
+}
+
+void generateAsteroidChunk(int cellX, int cellZ, const AsteroidFieldSettings& settings, std::vector<CompactTransform>& instances)
+{
+    // dense belts separated by empty lanes
+    const float density = glm::clamp((cellDensity(cellX, cellZ, settings.seed, 6) - 0.35f) / 0.5f, 0.0f, 1.0f);
+    const unsigned int count = static_cast<unsigned int>(density * settings.maxInstancesPerChunk);
+
+    std::mt19937 random(static_cast<uint32_t>(hashCell(cellX, cellZ, settings.seed ^ 0xA5A5A5A5ull)));
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    instances.clear();
+    instances.reserve(count);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        // 1. translation: anywhere in the cell, the field being flatter than wide
+        const glm::vec3 position((cellX + unit(random)) * settings.cellSize,
+                                 (unit(random) * 2.0f - 1.0f) * settings.fieldHeight,
+                                 (cellZ + unit(random)) * settings.cellSize);
+
+        // 2. scale: between 0.05 and 0.25
+        const float scale = 0.05f + 0.2f * unit(random);
+
+        // 3. rotation: random angle around a random axis
+        const glm::vec3 axis = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) - 0.5f + glm::vec3(1e-3f));
+        const glm::quat rotation = glm::angleAxis(unit(random) * 6.2831853f, axis);
+
+        instances.push_back(CompactTransform(position, scale, rotation));
+    }
+}
+#endif
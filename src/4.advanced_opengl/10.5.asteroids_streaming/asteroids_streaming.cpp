@@ -0,0 +1,266 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <stb_image.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/model.h>
+
+#include "asteroid_field.h"
+
+#include <iostream>
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(GLFWwindow *window);
+
+// settings
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+
+// impostors for the distant cells, I toggles them
+bool useImpostors = true;
+bool impostorKeyPressed = false;
+
+// camera
+Camera camera(glm::vec3(0.0f, 20.0f, 155.0f));
+float lastX = (float)SCR_WIDTH / 2.0;
+float lastY = (float)SCR_HEIGHT / 2.0;
+bool firstMouse = true;
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+int main()
+{
+    // glfw: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // glfw window creation
+    // --------------------
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+
+    // tell GLFW to capture our mouse
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    // glad: load all OpenGL function pointers
+    // ---------------------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    // don't wait for vsync so the measured frame time is the actual cost of the frame
+    glfwSwapInterval(0);
+
+    // configure global opengl state
+    // -----------------------------
+    glEnable(GL_DEPTH_TEST);
+
+    // build and compile shaders
+    // -------------------------
+    Shader asteroidShader("10.5.asteroids.vs", "10.5.asteroids.fs");
+    Shader planetShader("10.5.planet.vs", "10.5.planet.fs");
+    Shader impostorShader("10.5.impostor.vs", "10.5.impostor.fs");
+    Shader impostorBakeShader("10.5.impostor_bake.vs", "10.5.impostor_bake.fs");
+
+    // load models
+    // -----------
+    Model rock(FileSystem::getPath("resources/objects/rock/rock.obj"));
+    Model planet(FileSystem::getPath("resources/objects/planet/planet.obj"));
+
+    // bake the octahedral impostor of the rock, seen from every direction in the field so a full octahedron
+    // ---------------------------------------------------------------------------------------------------------------
+    double bakeStart = glfwGetTime();
+    Impostor rockImpostor(rock, impostorBakeShader, 16, 64);
+    std::cout << "impostor baked in " << (glfwGetTime() - bakeStart) * 1000.0 << " ms, " << rock.meshes[0].vertices.size() << " vertices per rock" << std::endl;
+
+    // the field has no bounds, fly fast enough to see cells stream in and out
+    camera.MovementSpeed = 40.0f;
+
+    // the asteroid field: cells are generated on worker threads around the camera and sub-allocated from one instance buffer
+    // ----------------------------------------------------------------------------------------------------------------------
+    AsteroidField field;
+    rock.meshes[0].AttachInstanceStreams({ &field.getInstances() });
+    bool fieldUsesImpostors = false;
+    const glm::vec3 lightDirection = glm::normalize(glm::vec3(-0.4f, 0.6f, 0.5f));
+
+    // statistics, printed every second
+    unsigned int statFrames = 0;
+    double statStart = glfwGetTime();
+
+    // render loop
+    // -----------
+    while (!glfwWindowShouldClose(window))
+    {
+        // per-frame time logic
+        // --------------------
+        float currentFrame = static_cast<float>(glfwGetTime());
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        // input
+        // -----
+        processInput(window);
+
+        // stream the cells around the camera
+        // ----------------------------------
+        field.update(camera.Position);
+
+        // render
+        // ------
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // configure transformation matrices
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 1000.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+        asteroidShader.use();
+        asteroidShader.setMat4("projection", projection);
+        asteroidShader.setMat4("view", view);
+        asteroidShader.setVec3("lightDirection", lightDirection);
+        impostorShader.use();
+        impostorShader.setMat4("projection", projection);
+        impostorShader.setMat4("view", view);
+        impostorShader.setVec3("cameraPosition", camera.Position);
+        impostorShader.setVec3("lightDirection", lightDirection);
+        planetShader.use();
+        planetShader.setMat4("projection", projection);
+        planetShader.setMat4("view", view);
+
+        // draw planet
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
+        model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
+        planetShader.setMat4("model", model);
+        planet.Draw(planetShader);
+
+        // draw meteorites, near cells with the mesh and far cells as impostors, one multi draw each
+        if (useImpostors != fieldUsesImpostors)
+        {
+            field.setImpostor(useImpostors ? &rockImpostor : nullptr, &impostorShader);
+            fieldUsesImpostors = useImpostors;
+        }
+        asteroidShader.use();
+        field.draw(rock.meshes[0], asteroidShader, createFrustumFromMatrix(projection * view), camera.Position);
+
+        // print what is resident and how long the generation took
+        // -------------------------------------------------------
+        statFrames++;
+        if (glfwGetTime() - statStart >= 1.0)
+        {
+            AsteroidFieldStats& stats = field.getStats();
+            std::cout << stats.residentChunks << " chunks (" << stats.residentInstances << " instances, "
+                      << stats.residentBytes / (1024.0 * 1024.0) << " of " << stats.bufferBytes / (1024.0 * 1024.0) << " MB), "
+                      << stats.pendingChunks << " pending, " << stats.visibleMeshInstances << " meshes + " << stats.visibleImpostorInstances << " impostors visible in "
+                      << stats.visibleChunks << " chunks (" << stats.visibleVertices << " vertices), "
+                      << stats.generatedChunks << " generated";
+            if (stats.generatedChunks > 0)
+                std::cout << " at " << stats.generationMs / stats.generatedChunks << " ms/chunk";
+            std::cout << ", " << (glfwGetTime() - statStart) * 1000.0 / statFrames << " ms/frame" << std::endl;
+            stats.resetGenerationStats();
+            statFrames = 0;
+            statStart = glfwGetTime();
+        }
+
+        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+        // -------------------------------------------------------------------------------
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    glfwTerminate();
+    return 0;
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow *window)
+{
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS && !impostorKeyPressed)
+    {
+        useImpostors = !useImpostors;
+        impostorKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_I) == GLFW_RELEASE)
+    {
+        impostorKeyPressed = false;
+    }
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+    // make sure the viewport matches the new window dimensions; note that width and 
+    // height will be significantly larger than specified on retina displays.
+    glViewport(0, 0, width, height);
+}
+
+// glfw: whenever the mouse moves, this callback is called
+// -------------------------------------------------------
+void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
+{
+    float xpos = static_cast<float>(xposIn);
+    float ypos = static_cast<float>(yposIn);
+
+    if (firstMouse)
+    {
+        lastX = xpos;
+        lastY = ypos;
+        firstMouse = false;
+    }
+
+    float xoffset = xpos - lastX;
+    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+
+    lastX = xpos;
+    lastY = ypos;
+
+    camera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    camera.ProcessMouseScroll(static_cast<float>(yoffset));
+}
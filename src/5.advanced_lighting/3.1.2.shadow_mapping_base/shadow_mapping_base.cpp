@@ -10,6 +10,7 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/depth_stream.h>
 
 #include <iostream>
 
@@ -18,8 +19,8 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 unsigned int loadTexture(const char *path);
-void renderScene(const Shader &shader);
-void renderCube();
+void renderScene(const Shader &shader, bool depthOnly = false);
+void renderCube(bool depthOnly = false);
 void renderQuad();
 
 // settings
@@ -38,6 +39,7 @@ float lastFrame = 0.0f;
 
 // meshes
 unsigned int planeVAO;
+DepthStream planeDepthStream; // positions only, for the depth pass
 
 int main()
 {
@@ -113,6 +115,7 @@ int main()
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glBindVertexArray(0);
+    planeDepthStream = createDepthStream(planeVertices, 6, 8);
 
     // load textures
     // -------------
@@ -188,7 +191,7 @@ int main()
             glClear(GL_DEPTH_BUFFER_BIT);
             glActiveTexture(GL_TEXTURE0);
             glBindTexture(GL_TEXTURE_2D, woodTexture);
-            renderScene(simpleDepthShader);
+            renderScene(simpleDepthShader, true);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         // reset viewport
@@ -231,6 +234,7 @@ int main()
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &planeVAO);
     glDeleteBuffers(1, &planeVBO);
+    deleteDepthStream(planeDepthStream);
 
     glfwTerminate();
     return 0;
@@ -238,30 +242,35 @@ int main()
 
 // renders the 3D scene
 // --------------------
-void renderScene(const Shader &shader)
+void renderScene(const Shader &shader, bool depthOnly)
 {
     // floor
     glm::mat4 model = glm::mat4(1.0f);
     shader.setMat4("model", model);
-    glBindVertexArray(planeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    if (depthOnly)
+        drawDepthStream(planeDepthStream);
+    else
+    {
+        glBindVertexArray(planeVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
     // cubes
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
     model = glm::scale(model, glm::vec3(0.5f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
     model = glm::scale(model, glm::vec3(0.5f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
     model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
     model = glm::scale(model, glm::vec3(0.25));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
 }
 
 
@@ -269,7 +278,8 @@ void renderScene(const Shader &shader)
 // -------------------------------------------------
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
-void renderCube()
+DepthStream cubeDepthStream; // positions only, for depth passes
+void renderCube(bool depthOnly)
 {
     // initialize (if necessary)
     if (cubeVAO == 0)
@@ -333,8 +343,14 @@ void renderCube()
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
+        cubeDepthStream = createDepthStream(vertices, 36, 8);
     }
     // render Cube
+    if (depthOnly)
+    {
+        drawDepthStream(cubeDepthStream);
+        return;
+    }
     glBindVertexArray(cubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glBindVertexArray(0);
@@ -10,6 +10,7 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/depth_stream.h>
 
 #include <iostream>
 
@@ -18,8 +19,8 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 unsigned int loadTexture(const char *path);
-void renderScene(const Shader &shader);
-void renderCube();
+void renderScene(const Shader &shader, bool depthOnly = false);
+void renderCube(bool depthOnly = false);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -168,7 +169,7 @@ int main()
                 simpleDepthShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
             simpleDepthShader.setFloat("far_plane", far_plane);
             simpleDepthShader.setVec3("lightPos", lightPos);
-            renderScene(simpleDepthShader);
+            renderScene(simpleDepthShader, true);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         // 2. render scene as normal 
@@ -203,7 +204,7 @@ int main()
 
 // renders the 3D scene
 // --------------------
-void renderScene(const Shader &shader)
+void renderScene(const Shader &shader, bool depthOnly)
 {
     // room cube
     glm::mat4 model = glm::mat4(1.0f);
@@ -211,7 +212,7 @@ void renderScene(const Shader &shader)
     shader.setMat4("model", model);
     glDisable(GL_CULL_FACE); // note that we disable culling here since we render 'inside' the cube instead of the usual 'outside' which throws off the normal culling methods.
     shader.setInt("reverse_normals", 1); // A small little hack to invert normals when drawing cube from the inside so lighting still works.
-    renderCube();
+    renderCube(depthOnly);
     shader.setInt("reverse_normals", 0); // and of course disable it
     glEnable(GL_CULL_FACE);
     // cubes
@@ -219,35 +220,36 @@ void renderScene(const Shader &shader)
     model = glm::translate(model, glm::vec3(4.0f, -3.5f, 0.0));
     model = glm::scale(model, glm::vec3(0.5f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(2.0f, 3.0f, 1.0));
     model = glm::scale(model, glm::vec3(0.75f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(-3.0f, -1.0f, 0.0));
     model = glm::scale(model, glm::vec3(0.5f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(-1.5f, 1.0f, 1.5));
     model = glm::scale(model, glm::vec3(0.5f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(-1.5f, 2.0f, -3.0));
     model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
     model = glm::scale(model, glm::vec3(0.75f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
 }
 
 // renderCube() renders a 1x1 3D cube in NDC.
 // -------------------------------------------------
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
-void renderCube()
+DepthStream cubeDepthStream; // positions only, for depth passes
+void renderCube(bool depthOnly)
 {
     // initialize (if necessary)
     if (cubeVAO == 0)
@@ -311,8 +313,14 @@ void renderCube()
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
+        cubeDepthStream = createDepthStream(vertices, 36, 8);
     }
     // render Cube
+    if (depthOnly)
+    {
+        drawDepthStream(cubeDepthStream);
+        return;
+    }
     glBindVertexArray(cubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glBindVertexArray(0);
@@ -9,12 +9,14 @@ in VS_OUT {
 
 uniform sampler2D diffuseTexture;
 uniform samplerCube depthMap;
+uniform sampler2DArray momentMap;
 
 uniform vec3 lightPos;
 uniform vec3 viewPos;
 
 uniform float far_plane;
 uniform bool shadows;
+uniform bool evsm;
 
 
 // array of offset direction for sampling
@@ -27,6 +29,68 @@ vec3 gridSamplingDisk[20] = vec3[]
    vec3(0, 1,  1), vec3( 0, -1,  1), vec3( 0, -1, -1), vec3( 0, 1, -1)
 );
 
+// must match EVSM_POSITIVE_EXPONENT and EVSM_NEGATIVE_EXPONENT in moment_shadows.h
+const float positiveExponent = 40.0;
+const float negativeExponent = 5.0;
+const float lightBleedingReduction = 0.2;
+
+// the cube map face the direction points at (+x, -x, +y, -y, +z, -z)
+int cubeFace(vec3 direction)
+{
+    vec3 a = abs(direction);
+    if (a.x >= a.y && a.x >= a.z)
+        return direction.x > 0.0 ? 0 : 1;
+    else if (a.y >= a.z)
+        return direction.y > 0.0 ? 2 : 3;
+    return direction.z > 0.0 ? 4 : 5;
+}
+
+// where the direction falls on the face's layer, in [0, 1] when it points at that face; the layers are rendered with
+// the same views as the depth cube map
+vec2 cubeFaceCoords(vec3 direction, int face)
+{
+    if (face < 2)
+        return vec2(face == 0 ? -direction.z : direction.z, -direction.y) / abs(direction.x) * 0.5 + 0.5;
+    else if (face < 4)
+        return vec2(direction.x, face == 2 ? direction.z : -direction.z) / abs(direction.y) * 0.5 + 0.5;
+    return vec2(face == 4 ? direction.x : -direction.x, -direction.y) / abs(direction.z) * 0.5 + 0.5;
+}
+
+// upper bound of the fraction of the filter region closer to the light than mean, from its first two moments
+float Chebyshev(vec2 moments, float mean, float minVariance)
+{
+    if (mean <= moments.x)
+        return 1.0;
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = mean - moments.x;
+    float pMax = variance / (variance + d * d);
+    // cut off the tail that lets light bleed through where casters overlap
+    return clamp((pMax - lightBleedingReduction) / (1.0 - lightBleedingReduction), 0.0, 1.0);
+}
+
+// shadow from the blurred, mipmapped exponential moments of the face, a single trilinear fetch
+float EVSMShadowCalculation(vec3 fragPos)
+{
+    vec3 fragToLight = fragPos - lightPos;
+    int face = cubeFace(fragToLight);
+    vec2 coords = cubeFaceCoords(fragToLight, face);
+    // the screen space gradients projected onto the same face, so the mip level does not jump where the face changes
+    vec2 dx = cubeFaceCoords(fragToLight + dFdx(fragPos), face) - coords;
+    vec2 dy = cubeFaceCoords(fragToLight + dFdy(fragPos), face) - coords;
+    vec4 moments = textureGrad(momentMap, vec3(coords, face), dx, dy);
+
+    float bias = 0.05;
+    float currentDepth = clamp((length(fragToLight) - bias) / far_plane, 0.0, 1.0);
+    float warped = currentDepth * 2.0 - 1.0;
+    float positive = exp(positiveExponent * warped);
+    float negative = -exp(-negativeExponent * warped);
+    float positiveScale = 0.0005 * positiveExponent * positive;
+    float negativeScale = 0.0005 * negativeExponent * negative;
+    float lit = min(Chebyshev(moments.xy, positive, positiveScale * positiveScale),
+                    Chebyshev(moments.zw, negative, negativeScale * negativeScale));
+    return 1.0 - lit;
+}
+
 float ShadowCalculation(vec3 fragPos)
 {
     // get vector between fragment position and light position
@@ -98,7 +162,7 @@ void main()
     spec = pow(max(dot(normal, halfwayDir), 0.0), 64.0);
     vec3 specular = spec * lightColor;    
     // calculate shadow
-    float shadow = shadows ? ShadowCalculation(fs_in.FragPos) : 0.0;                      
+    float shadow = shadows ? (evsm ? EVSMShadowCalculation(fs_in.FragPos) : ShadowCalculation(fs_in.FragPos)) : 0.0;                      
     vec3 lighting = (ambient + (1.0 - shadow) * (diffuse + specular)) * color;    
     
     FragColor = vec4(lighting, 1.0);
@@ -0,0 +1,21 @@
+#version 330 core
+in vec4 FragPos;
+
+out vec4 FragColor;
+
+uniform vec3 lightPos;
+uniform float far_plane;
+
+// must match EVSM_POSITIVE_EXPONENT and EVSM_NEGATIVE_EXPONENT in moment_shadows.h
+const float positiveExponent = 40.0;
+const float negativeExponent = 5.0;
+
+void main()
+{
+    // the same linear depth as the depth map, as its exponential moments
+    float lightDistance = length(FragPos.xyz - lightPos) / far_plane;
+    float warped = clamp(lightDistance, 0.0, 1.0) * 2.0 - 1.0;
+    float positive = exp(positiveExponent * warped);
+    float negative = -exp(-negativeExponent * warped);
+    FragColor = vec4(positive, positive * positive, negative, negative * negative);
+}
@@ -10,6 +10,8 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/depth_stream.h>
+#include <learnopengl/moment_shadows.h>
 
 #include <iostream>
 
@@ -18,14 +20,17 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 unsigned int loadTexture(const char *path);
-void renderScene(const Shader &shader);
-void renderCube();
+void renderScene(const Shader &shader, bool depthOnly = false);
+void renderCube(bool depthOnly = false);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 bool shadows = true;
 bool shadowsKeyPressed = false;
+// exponential variance shadow maps instead of the 20 tap PCF (V key)
+bool evsm = false;
+bool evsmKeyPressed = false;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -84,6 +89,8 @@ int main()
     // -------------------------
     Shader shader("3.2.2.point_shadows.vs", "3.2.2.point_shadows.fs");
     Shader simpleDepthShader("3.2.2.point_shadows_depth.vs", "3.2.2.point_shadows_depth.fs", "3.2.2.point_shadows_depth.gs");
+    Shader momentShader("3.2.2.point_shadows_depth.vs", "3.2.2.point_shadows_moments.fs", "3.2.2.point_shadows_depth.gs");
+    Shader blurShader("3.2.2.shadow_blur.vs", "3.2.2.shadow_blur.fs");
 
     // load textures
     // -------------
@@ -112,12 +119,44 @@ int main()
     glReadBuffer(GL_NONE);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    // configure moment map FBO
+    // ------------------------
+    // the faces' moments are kept in a texture array rather than a cube map, so they can be blurred one face at a time
+    // like any other layer; the lighting shader picks the face itself
+    unsigned int momentMapFBO;
+    glGenFramebuffers(1, &momentMapFBO);
+    unsigned int momentMaps = createMomentMapArray(SHADOW_WIDTH, 6);
+    unsigned int momentDepthMaps;
+    glGenTextures(1, &momentDepthMaps);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, momentDepthMaps);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 6, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, momentMapFBO);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, momentMaps, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, momentDepthMaps, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Moment framebuffer is not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    MomentShadowBlur momentBlur(SHADOW_WIDTH);
+    const int blurRadius = 4;
+    // what the faces hold where nothing was rendered
+    const glm::vec4 clearMoments = evsmMoments(1.0f);
 
     // shader configuration
     // --------------------
     shader.use();
     shader.setInt("diffuseTexture", 0);
     shader.setInt("depthMap", 1);
+    shader.setInt("momentMap", 2);
+
+    // shadow and lighting pass GPU times, read back a frame late so they do not stall, printed every second
+    unsigned int shadowQueries[2], lightingQueries[2];
+    glGenQueries(2, shadowQueries);
+    glGenQueries(2, lightingQueries);
+    unsigned int frame = 0, statFrames = 0;
+    double statShadowTime = 0.0, statLightingTime = 0.0;
+    double statTime = glfwGetTime();
 
     // lighting info
     // -------------
@@ -160,21 +199,46 @@ int main()
 
         // 1. render scene to depth cubemap
         // --------------------------------
+        glBeginQuery(GL_TIME_ELAPSED, shadowQueries[frame % 2]);
         glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        simpleDepthShader.use();
-        for (unsigned int i = 0; i < 6; ++i)
-            simpleDepthShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
-        simpleDepthShader.setFloat("far_plane", far_plane);
-        simpleDepthShader.setVec3("lightPos", lightPos);
-        renderScene(simpleDepthShader);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!evsm)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            simpleDepthShader.use();
+            for (unsigned int i = 0; i < 6; ++i)
+                simpleDepthShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
+            simpleDepthShader.setFloat("far_plane", far_plane);
+            simpleDepthShader.setVec3("lightPos", lightPos);
+            renderScene(simpleDepthShader, true);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        else
+        {
+            // the same faces as moments, then blurred and mipmapped once for all fragments
+            glBindFramebuffer(GL_FRAMEBUFFER, momentMapFBO);
+            glClearColor(clearMoments.x, clearMoments.y, clearMoments.z, clearMoments.w);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            momentShader.use();
+            for (unsigned int i = 0; i < 6; ++i)
+                momentShader.setMat4("shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i]);
+            momentShader.setFloat("far_plane", far_plane);
+            momentShader.setVec3("lightPos", lightPos);
+            renderScene(momentShader, true);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            for (unsigned int i = 0; i < 6; ++i)
+                momentBlur.Blur(blurShader, momentMaps, i, blurRadius);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, momentMaps);
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        }
+        glEndQuery(GL_TIME_ELAPSED);
 
         // 2. render scene as normal 
         // -------------------------
         glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glBeginQuery(GL_TIME_ELAPSED, lightingQueries[frame % 2]);
         shader.use();
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
@@ -185,11 +249,35 @@ int main()
         shader.setVec3("viewPos", camera.Position);
         shader.setInt("shadows", shadows); // enable/disable shadows by pressing 'SPACE'
         shader.setFloat("far_plane", far_plane);
+        shader.setBool("evsm", evsm);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, woodTexture);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_CUBE_MAP, depthCubemap);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, momentMaps);
         renderScene(shader);
+        glEndQuery(GL_TIME_ELAPSED);
+
+        // compare the shadow techniques' costs
+        if (frame > 0)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(shadowQueries[(frame - 1) % 2], GL_QUERY_RESULT, &elapsed);
+            statShadowTime += elapsed / 1000000.0;
+            glGetQueryObjectui64v(lightingQueries[(frame - 1) % 2], GL_QUERY_RESULT, &elapsed);
+            statLightingTime += elapsed / 1000000.0;
+            statFrames++;
+        }
+        frame++;
+        if (glfwGetTime() - statTime >= 1.0 && statFrames > 0)
+        {
+            std::cout << (evsm ? "EVSM" : "20 tap PCF") << ": shadow pass " << statShadowTime / statFrames << " ms, lighting pass "
+                      << statLightingTime / statFrames << " ms" << std::endl;
+            statFrames = 0;
+            statShadowTime = statLightingTime = 0.0;
+            statTime = glfwGetTime();
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -197,13 +285,16 @@ int main()
         glfwPollEvents();
     }
 
+    glDeleteQueries(2, shadowQueries);
+    glDeleteQueries(2, lightingQueries);
+
     glfwTerminate();
     return 0;
 }
 
 // renders the 3D scene
 // --------------------
-void renderScene(const Shader &shader)
+void renderScene(const Shader &shader, bool depthOnly)
 {
     // room cube
     glm::mat4 model = glm::mat4(1.0f);
@@ -211,7 +302,7 @@ void renderScene(const Shader &shader)
     shader.setMat4("model", model);
     glDisable(GL_CULL_FACE); // note that we disable culling here since we render 'inside' the cube instead of the usual 'outside' which throws off the normal culling methods.
     shader.setInt("reverse_normals", 1); // A small little hack to invert normals when drawing cube from the inside so lighting still works.
-    renderCube();
+    renderCube(depthOnly);
     shader.setInt("reverse_normals", 0); // and of course disable it
     glEnable(GL_CULL_FACE);
     // cubes
@@ -219,35 +310,36 @@ void renderScene(const Shader &shader)
     model = glm::translate(model, glm::vec3(4.0f, -3.5f, 0.0));
     model = glm::scale(model, glm::vec3(0.5f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(2.0f, 3.0f, 1.0));
     model = glm::scale(model, glm::vec3(0.75f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(-3.0f, -1.0f, 0.0));
     model = glm::scale(model, glm::vec3(0.5f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(-1.5f, 1.0f, 1.5));
     model = glm::scale(model, glm::vec3(0.5f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
     model = glm::mat4(1.0f);
     model = glm::translate(model, glm::vec3(-1.5f, 2.0f, -3.0));
     model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
     model = glm::scale(model, glm::vec3(0.75f));
     shader.setMat4("model", model);
-    renderCube();
+    renderCube(depthOnly);
 }
 
 // renderCube() renders a 1x1 3D cube in NDC.
 // -------------------------------------------------
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
-void renderCube()
+DepthStream cubeDepthStream; // positions only, for depth passes
+void renderCube(bool depthOnly)
 {
     // initialize (if necessary)
     if (cubeVAO == 0)
@@ -311,8 +403,14 @@ void renderCube()
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
+        cubeDepthStream = createDepthStream(vertices, 36, 8);
     }
     // render Cube
+    if (depthOnly)
+    {
+        drawDepthStream(cubeDepthStream);
+        return;
+    }
     glBindVertexArray(cubeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glBindVertexArray(0);
@@ -343,6 +441,16 @@ void processInput(GLFWwindow *window)
     {
         shadowsKeyPressed = false;
     }
+
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS && !evsmKeyPressed)
+    {
+        evsm = !evsm;
+        evsmKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_RELEASE)
+    {
+        evsmKeyPressed = false;
+    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
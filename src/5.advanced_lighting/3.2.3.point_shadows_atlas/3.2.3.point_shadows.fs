@@ -0,0 +1,124 @@
+#version 330 core
+out vec4 FragColor;
+
+in VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec2 TexCoords;
+} fs_in;
+
+struct Light
+{
+    vec4 positionRange;   // xyz position, w range
+    vec4 colorType;       // rgb color, w 0 for a point light and 1 for a spot light
+    vec4 directionCutoff; // spot lights: xyz direction, w cosine of the cone's half angle
+    vec4 tiles[6];        // xy offset and zw scale of every face's tile in the shadow atlas, zw 0 when unshadowed
+};
+
+#define MAX_LIGHTS 96
+layout (std140) uniform Lights
+{
+    Light lights[MAX_LIGHTS];
+};
+uniform int lightCount;
+
+uniform sampler2D diffuseTexture;
+uniform sampler2DShadow shadowAtlas;
+
+uniform vec3 viewPos;
+uniform bool shadows;
+
+// the cube map face the direction points at (+x, -x, +y, -y, +z, -z) and where on it, in [0, 1]; the faces are
+// rendered with the same views as a depth cube map so this is the cube map's own lookup
+vec2 cubeFaceCoords(vec3 direction, out int face)
+{
+    vec3 a = abs(direction);
+    vec2 coords;
+    if (a.x >= a.y && a.x >= a.z)
+    {
+        face = direction.x > 0.0 ? 0 : 1;
+        coords = vec2(direction.x > 0.0 ? -direction.z : direction.z, -direction.y) / a.x;
+    }
+    else if (a.y >= a.z)
+    {
+        face = direction.y > 0.0 ? 2 : 3;
+        coords = vec2(direction.x, direction.y > 0.0 ? direction.z : -direction.z) / a.y;
+    }
+    else
+    {
+        face = direction.z > 0.0 ? 4 : 5;
+        coords = vec2(direction.z > 0.0 ? direction.x : -direction.x, -direction.y) / a.z;
+    }
+    return coords * 0.5 + 0.5;
+}
+
+// where the direction falls on a spot light's map, rendered with glm::lookAt along the spot's direction
+vec2 spotCoords(vec3 direction, vec4 directionCutoff)
+{
+    vec3 forward = directionCutoff.xyz;
+    vec3 up = abs(forward.y) > 0.99 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(forward, up));
+    up = cross(right, forward);
+    float tanHalfAngle = sqrt(1.0 - directionCutoff.w * directionCutoff.w) / directionCutoff.w;
+    vec2 coords = vec2(dot(direction, right), dot(direction, up)) / (dot(direction, forward) * tanHalfAngle);
+    return coords * 0.5 + 0.5;
+}
+
+float ShadowCalculation(int index, vec3 fragPos)
+{
+    // get vector between fragment position and light position
+    vec3 fragToLight = fragPos - lights[index].positionRange.xyz;
+    int face = 0;
+    vec2 coords;
+    if (lights[index].colorType.w == 0.0)
+        coords = cubeFaceCoords(fragToLight, face);
+    else
+        coords = spotCoords(fragToLight, lights[index].directionCutoff);
+    vec4 tile = lights[index].tiles[face];
+    if (tile.z == 0.0)
+        return 0.0;
+    // keep the 2x2 footprint of the filtered comparison inside the tile
+    float halfTexel = 0.5 / (tile.z * float(textureSize(shadowAtlas, 0).x));
+    coords = clamp(coords, halfTexel, 1.0 - halfTexel);
+    // the atlas holds distances to the light divided by its range
+    float bias = 0.05;
+    float currentDepth = (length(fragToLight) - bias) / lights[index].positionRange.w;
+    return 1.0 - texture(shadowAtlas, vec3(tile.xy + coords * tile.zw, currentDepth));
+}
+
+void main()
+{           
+    vec3 color = texture(diffuseTexture, fs_in.TexCoords).rgb;
+    vec3 normal = normalize(fs_in.Normal);
+    vec3 viewDir = normalize(viewPos - fs_in.FragPos);
+    // ambient
+    vec3 lighting = vec3(0.05);
+    for (int i = 0; i < lightCount; ++i)
+    {
+        vec3 toLight = lights[i].positionRange.xyz - fs_in.FragPos;
+        float distance = length(toLight);
+        float range = lights[i].positionRange.w;
+        if (distance >= range)
+            continue;
+        vec3 lightDir = toLight / distance;
+        float attenuation = 1.0 - (distance * distance) / (range * range);
+        attenuation *= attenuation;
+        if (lights[i].colorType.w != 0.0)
+        {
+            float theta = dot(-lightDir, lights[i].directionCutoff.xyz);
+            attenuation *= clamp((theta - lights[i].directionCutoff.w) / 0.05, 0.0, 1.0);
+        }
+        if (attenuation <= 0.0)
+            continue;
+        // diffuse
+        float diff = max(dot(lightDir, normal), 0.0);
+        // specular
+        vec3 halfwayDir = normalize(lightDir + viewDir);  
+        float spec = pow(max(dot(normal, halfwayDir), 0.0), 64.0);
+        // calculate shadow
+        float shadow = shadows ? ShadowCalculation(i, fs_in.FragPos) : 0.0;
+        lighting += (1.0 - shadow) * (diff + spec) * attenuation * lights[i].colorType.rgb;
+    }
+    
+    FragColor = vec4(lighting * color, 1.0);
+}
@@ -0,0 +1,655 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <stb_image.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/shadow_atlas.h>
+#include <learnopengl/depth_stream.h>
+
+#include <iostream>
+#include <vector>
+#include <random>
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(GLFWwindow *window);
+unsigned int loadTexture(const char *path);
+void renderCube(bool depthOnly = false);
+
+// settings
+const unsigned int SCR_WIDTH = 1280;
+const unsigned int SCR_HEIGHT = 720;
+bool shadows = true;
+bool shadowsKeyPressed = false;
+bool animate = true;
+bool animateKeyPressed = false;
+
+// camera
+Camera camera(glm::vec3(0.0f, 6.0f, 22.0f));
+float lastX = (float)SCR_WIDTH / 2.0;
+float lastY = (float)SCR_HEIGHT / 2.0;
+bool firstMouse = true;
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+// shadow atlas settings: texels of a face per pixel the light's range covers on screen, and the atlas' tile sizes
+const float SHADOW_DETAIL = 1.0f;
+const unsigned int ATLAS_SIZE = 8192;
+const unsigned int MIN_TILE_SIZE = 64;
+const unsigned int MAX_TILE_SIZE = 1024;
+// must match 3.2.3.point_shadows.fs
+const unsigned int MAX_LIGHTS = 96;
+
+struct SceneLight
+{
+    glm::vec3 position;
+    glm::vec3 color;
+    float range;
+    bool spot;
+    glm::vec3 direction; // spot lights only
+    float cosCutoff;
+    bool moving;
+    glm::vec3 orbitCenter;
+};
+
+// a cube the lights' shadow maps are rendered from, previous bounds being the ones before it last moved
+struct Caster
+{
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::vec3 minimum = glm::vec3(0.0f), maximum = glm::vec3(0.0f);
+    glm::vec3 previousMinimum = glm::vec3(0.0f), previousMaximum = glm::vec3(0.0f);
+    glm::vec3 basePosition;
+    glm::vec3 scale;
+    bool moving;
+};
+
+// std140 layout of a light in 3.2.3.point_shadows.fs
+struct LightData
+{
+    glm::vec4 positionRange;
+    glm::vec4 colorType;
+    glm::vec4 directionCutoff;
+    glm::vec4 tiles[6];
+};
+
+std::vector<SceneLight> lights;
+std::vector<Caster> casters;
+
+void createScene();
+void updateCaster(Caster& caster, float time);
+glm::mat4 getShadowFaceMatrix(const SceneLight& light, unsigned int face);
+bool boxInFrustum(const Frustum& frustum, const glm::vec3& minimum, const glm::vec3& maximum);
+bool sphereIntersectsBox(const glm::vec3& center, float radius, const glm::vec3& minimum, const glm::vec3& maximum);
+
+int main()
+{
+    // glfw: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // glfw window creation
+    // --------------------
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+
+    // tell GLFW to capture our mouse
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    // glad: load all OpenGL function pointers
+    // ---------------------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    // configure global opengl state
+    // -----------------------------
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    // build and compile shaders
+    // -------------------------
+    Shader shader("3.2.3.point_shadows.vs", "3.2.3.point_shadows.fs");
+    Shader simpleDepthShader("3.2.3.point_shadows_depth.vs", "3.2.3.point_shadows_depth.fs");
+
+    // load textures
+    // -------------
+    unsigned int woodTexture = loadTexture(FileSystem::getPath("resources/textures/wood.png").c_str());
+
+    // every light's shadow map lives in tiles of one atlas instead of a cube map each
+    // ---------------------------------------------------------------------------------
+    ShadowAtlas atlas(ATLAS_SIZE, MIN_TILE_SIZE, MAX_TILE_SIZE);
+
+    // lights UBO
+    // ----------
+    unsigned int lightsUBO;
+    glGenBuffers(1, &lightsUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, lightsUBO);
+    glBufferData(GL_UNIFORM_BUFFER, MAX_LIGHTS * sizeof(LightData), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, 0, lightsUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    std::vector<LightData> lightData;
+
+    // shader configuration
+    // --------------------
+    shader.use();
+    shader.setInt("diffuseTexture", 0);
+    shader.setInt("shadowAtlas", 1);
+    glUniformBlockBinding(shader.ID, glGetUniformBlockIndex(shader.ID, "Lights"), 0);
+
+    createScene();
+    std::cout << lights.size() << " shadowed lights, SPACE toggles shadows, P pauses the animation" << std::endl;
+
+    // stats, printed every second
+    unsigned int statFrames = 0, statFaces = 0, statDraws = 0, statEvictions = 0;
+    double statTime = glfwGetTime();
+    float animationTime = 0.0f;
+
+    // render loop
+    // -----------
+    while (!glfwWindowShouldClose(window))
+    {
+        // per-frame time logic
+        // --------------------
+        float currentFrame = static_cast<float>(glfwGetTime());
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        // input
+        // -----
+        processInput(window);
+
+        // 0. move the animated lights and casters, and invalidate the shadow map faces they affect
+        // -----------------------------------------------------------------------------------------
+        if (animate)
+        {
+            animationTime += deltaTime;
+            for (unsigned int i = 0; i < lights.size(); ++i)
+            {
+                if (!lights[i].moving)
+                    continue;
+                lights[i].position = lights[i].orbitCenter + glm::vec3(sin(animationTime + i), 0.0f, cos(animationTime + i)) * 1.5f;
+                atlas.Invalidate(i, 0x3F);
+            }
+            for (Caster& caster : casters)
+            {
+                if (!caster.moving)
+                    continue;
+                updateCaster(caster, animationTime);
+                // the faces that saw the caster before or see it now
+                const glm::vec3 minimum = glm::min(caster.minimum, caster.previousMinimum);
+                const glm::vec3 maximum = glm::max(caster.maximum, caster.previousMaximum);
+                for (unsigned int i = 0; i < lights.size(); ++i)
+                {
+                    if (!sphereIntersectsBox(lights[i].position, lights[i].range, minimum, maximum))
+                        continue;
+                    unsigned int faces = 0;
+                    for (unsigned int face = 0; face < (lights[i].spot ? 1u : 6u); ++face)
+                    {
+                        if (boxInFrustum(createFrustumFromMatrix(getShadowFaceMatrix(lights[i], face)), minimum, maximum))
+                            faces |= 1u << face;
+                    }
+                    atlas.Invalidate(i, faces);
+                }
+            }
+        }
+
+        // 1. request atlas tiles for the visible lights, sized by how large their range is on screen
+        // -------------------------------------------------------------------------------------------
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+        const Frustum cameraFrustum = createFrustumFromMatrix(projection * view);
+        std::vector<ShadowAtlasRequest> requests;
+        for (unsigned int i = 0; i < lights.size(); ++i)
+        {
+            const glm::vec3 extents(lights[i].range);
+            if (!boxInFrustum(cameraFrustum, lights[i].position - extents, lights[i].position + extents))
+                continue;
+            const float distance = std::max(glm::distance(camera.Position, lights[i].position), lights[i].range);
+            ShadowAtlasRequest request;
+            request.light = i;
+            request.faces = lights[i].spot ? 1 : 6;
+            request.tileSize = SHADOW_DETAIL * lights[i].range / distance * projection[1][1] * SCR_HEIGHT * 0.5f;
+            requests.push_back(request);
+        }
+        if (shadows)
+            atlas.Update(requests);
+
+        // 2. render the faces that are new or invalidated into their tiles
+        // ----------------------------------------------------------------
+        simpleDepthShader.use();
+        for (unsigned int i = 0; i < lights.size() && shadows; ++i)
+        {
+            const ShadowAtlasAllocation* allocation = atlas.Find(i);
+            if (!allocation || allocation->renderFaces == 0)
+                continue;
+            simpleDepthShader.setVec3("lightPos", lights[i].position);
+            simpleDepthShader.setFloat("far_plane", lights[i].range);
+            for (unsigned int face = 0; face < allocation->faces; ++face)
+            {
+                if ((allocation->renderFaces & (1u << face)) == 0)
+                    continue;
+                const glm::mat4 faceMatrix = getShadowFaceMatrix(lights[i], face);
+                const Frustum faceFrustum = createFrustumFromMatrix(faceMatrix);
+                atlas.BeginTile(allocation->tiles[face]);
+                simpleDepthShader.setMat4("lightSpaceMatrix", faceMatrix);
+                for (const Caster& caster : casters)
+                {
+                    if (!sphereIntersectsBox(lights[i].position, lights[i].range, caster.minimum, caster.maximum) ||
+                        !boxInFrustum(faceFrustum, caster.minimum, caster.maximum))
+                        continue;
+                    simpleDepthShader.setMat4("model", caster.model);
+                    renderCube(true);
+                    statDraws++;
+                }
+                statFaces++;
+            }
+        }
+        glDisable(GL_SCISSOR_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // 3. upload the lights with their tiles
+        // -------------------------------------
+        lightData.resize(std::min<size_t>(lights.size(), MAX_LIGHTS));
+        for (unsigned int i = 0; i < lightData.size(); ++i)
+        {
+            LightData& data = lightData[i];
+            data.positionRange = glm::vec4(lights[i].position, lights[i].range);
+            data.colorType = glm::vec4(lights[i].color, lights[i].spot ? 1.0f : 0.0f);
+            data.directionCutoff = glm::vec4(lights[i].direction, lights[i].cosCutoff);
+            const ShadowAtlasAllocation* allocation = shadows ? atlas.Find(i) : nullptr;
+            for (unsigned int face = 0; face < 6; ++face)
+                data.tiles[face] = allocation && face < allocation->faces ? atlas.TileRect(allocation->tiles[face]) : glm::vec4(0.0f);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, lightsUBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, lightData.size() * sizeof(LightData), lightData.data());
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        // 4. render scene as normal 
+        // -------------------------
+        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        shader.use();
+        shader.setMat4("projection", projection);
+        shader.setMat4("view", view);
+        // set lighting uniforms
+        shader.setInt("lightCount", (int)lightData.size());
+        shader.setVec3("viewPos", camera.Position);
+        shader.setInt("shadows", shadows); // enable/disable shadows by pressing 'SPACE'
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, woodTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, atlas.Texture);
+        for (const Caster& caster : casters)
+        {
+            shader.setMat4("model", caster.model);
+            renderCube();
+        }
+
+        statFrames++;
+        statEvictions += atlas.GetStats().evictions;
+        if (glfwGetTime() - statTime >= 1.0)
+        {
+            const ShadowAtlas::Stats& stats = atlas.GetStats();
+            std::cout << stats.shadowed << " / " << lights.size() << " lights shadowed, " << stats.resident << " resident, "
+                      << float(statFaces) / statFrames << " faces and " << float(statDraws) / statFrames << " draws a frame, "
+                      << statEvictions << " evictions, atlas " << int(stats.usage * 100.0f) << "% used" << std::endl;
+            statFrames = statFaces = statDraws = statEvictions = 0;
+            statTime = glfwGetTime();
+        }
+
+        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+        // -------------------------------------------------------------------------------
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    glDeleteBuffers(1, &lightsUBO);
+
+    glfwTerminate();
+    return 0;
+}
+
+// a floor with a grid of cubes, every 7th of them animated, lit by an 8 x 8 grid of point lights (every 9th orbiting)
+// and 8 spot lights shining down from above
+// -------------------------------------------------------------------------------------------------------------------
+void createScene()
+{
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    Caster floor;
+    floor.basePosition = glm::vec3(0.0f, -0.5f, 0.0f);
+    floor.scale = glm::vec3(22.0f, 0.5f, 22.0f);
+    floor.moving = false;
+    updateCaster(floor, 0.0f);
+    casters.push_back(floor);
+    for (int x = -3; x <= 3; ++x)
+    {
+        for (int z = -3; z <= 3; ++z)
+        {
+            Caster cube;
+            const float size = 0.4f + 0.5f * unit(generator);
+            cube.scale = glm::vec3(size, size * (1.0f + 2.0f * unit(generator)), size);
+            cube.basePosition = glm::vec3(x * 5.0f, cube.scale.y, z * 5.0f);
+            cube.moving = casters.size() % 7 == 0;
+            updateCaster(cube, 0.0f);
+            casters.push_back(cube);
+        }
+    }
+
+    for (int x = 0; x < 8; ++x)
+    {
+        for (int z = 0; z < 8; ++z)
+        {
+            SceneLight light;
+            light.position = light.orbitCenter = glm::vec3(-17.5f + x * 5.0f, 1.5f + unit(generator), -17.5f + z * 5.0f);
+            light.color = glm::vec3(0.3f) + 0.7f * glm::vec3(unit(generator), unit(generator), unit(generator));
+            light.range = 6.0f;
+            light.spot = false;
+            light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+            light.cosCutoff = 0.0f;
+            light.moving = lights.size() % 9 == 0;
+            lights.push_back(light);
+        }
+    }
+    for (int i = 0; i < 8; ++i)
+    {
+        SceneLight light;
+        const float angle = glm::radians(45.0f * i);
+        light.position = light.orbitCenter = glm::vec3(sin(angle) * 12.0f, 8.0f, cos(angle) * 12.0f);
+        light.color = glm::vec3(1.0f, 0.9f, 0.7f);
+        light.range = 14.0f;
+        light.spot = true;
+        light.direction = glm::normalize(glm::vec3(-sin(angle) * 0.5f, -1.0f, -cos(angle) * 0.5f));
+        light.cosCutoff = cos(glm::radians(30.0f));
+        light.moving = false;
+        lights.push_back(light);
+    }
+}
+
+// places the caster at the given animation time, keeping its previous bounds
+// ----------------------------------------------------------------------------
+void updateCaster(Caster& caster, float time)
+{
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::vec3 position = caster.basePosition;
+    if (caster.moving)
+        position.y += (sin(time + caster.basePosition.x) * 0.5f + 0.5f) * 2.0f;
+    model = glm::translate(model, position);
+    if (caster.moving)
+        model = glm::rotate(model, time, glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::scale(model, caster.scale);
+    caster.model = model;
+
+    // bounds of the [-1, 1] cube
+    const glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+    const glm::vec3 extents = absolute * glm::vec3(1.0f);
+    caster.previousMinimum = caster.minimum;
+    caster.previousMaximum = caster.maximum;
+    caster.minimum = position - extents;
+    caster.maximum = position + extents;
+}
+
+// the view projection a shadow map face is rendered with, the faces of a point light following the cube map layout
+// ----------------------------------------------------------------------------------------------------------------
+glm::mat4 getShadowFaceMatrix(const SceneLight& light, unsigned int face)
+{
+    const float near_plane = 0.1f;
+    if (light.spot)
+    {
+        const glm::vec3 up = std::abs(light.direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        const glm::mat4 shadowProj = glm::perspective(2.0f * std::acos(light.cosCutoff), 1.0f, near_plane, light.range);
+        return shadowProj * glm::lookAt(light.position, light.position + light.direction, up);
+    }
+    static const glm::vec3 directions[6] = { { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f } };
+    static const glm::vec3 ups[6] = { { 0.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f } };
+    const glm::mat4 shadowProj = glm::perspective(glm::radians(90.0f), 1.0f, near_plane, light.range);
+    return shadowProj * glm::lookAt(light.position, light.position + directions[face], ups[face]);
+}
+
+// whether the box is at least partly inside the frustum
+// ------------------------------------------------------
+bool boxInFrustum(const Frustum& frustum, const glm::vec3& minimum, const glm::vec3& maximum)
+{
+    const Plane* planes[6] = { &frustum.leftFace, &frustum.rightFace, &frustum.topFace,
+        &frustum.bottomFace, &frustum.nearFace, &frustum.farFace };
+    const glm::vec3 center = (minimum + maximum) * 0.5f;
+    const glm::vec3 extents = (maximum - minimum) * 0.5f;
+    for (const Plane* plane : planes)
+    {
+        if (plane->getSignedDistanceToPlane(center) < -glm::dot(extents, glm::abs(plane->normal)))
+            return false;
+    }
+    return true;
+}
+
+bool sphereIntersectsBox(const glm::vec3& center, float radius, const glm::vec3& minimum, const glm::vec3& maximum)
+{
+    const glm::vec3 closest = glm::clamp(center, minimum, maximum);
+    return glm::dot(closest - center, closest - center) <= radius * radius;
+}
+
+// renderCube() renders a 1x1 3D cube in NDC.
+// -------------------------------------------------
+unsigned int cubeVAO = 0;
+unsigned int cubeVBO = 0;
+DepthStream cubeDepthStream; // positions only, for depth passes
+void renderCube(bool depthOnly)
+{
+    // initialize (if necessary)
+    if (cubeVAO == 0)
+    {
+        float vertices[] = {
+            // back face
+            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
+             1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 0.0f, // bottom-right         
+             1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 1.0f, 1.0f, // top-right
+            -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 0.0f, // bottom-left
+            -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, -1.0f, 0.0f, 1.0f, // top-left
+            // front face
+            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
+             1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 0.0f, // bottom-right
+             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
+             1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 1.0f, 1.0f, // top-right
+            -1.0f,  1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 1.0f, // top-left
+            -1.0f, -1.0f,  1.0f,  0.0f,  0.0f,  1.0f, 0.0f, 0.0f, // bottom-left
+            // left face
+            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
+            -1.0f,  1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-left
+            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
+            -1.0f, -1.0f, -1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-left
+            -1.0f, -1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-right
+            -1.0f,  1.0f,  1.0f, -1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-right
+            // right face
+             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
+             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
+             1.0f,  1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 1.0f, // top-right         
+             1.0f, -1.0f, -1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 1.0f, // bottom-right
+             1.0f,  1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 1.0f, 0.0f, // top-left
+             1.0f, -1.0f,  1.0f,  1.0f,  0.0f,  0.0f, 0.0f, 0.0f, // bottom-left     
+            // bottom face
+            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
+             1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 1.0f, // top-left
+             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
+             1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 1.0f, 0.0f, // bottom-left
+            -1.0f, -1.0f,  1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 0.0f, // bottom-right
+            -1.0f, -1.0f, -1.0f,  0.0f, -1.0f,  0.0f, 0.0f, 1.0f, // top-right
+            // top face
+            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
+             1.0f,  1.0f , 1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
+             1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 1.0f, // top-right     
+             1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 1.0f, 0.0f, // bottom-right
+            -1.0f,  1.0f, -1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 1.0f, // top-left
+            -1.0f,  1.0f,  1.0f,  0.0f,  1.0f,  0.0f, 0.0f, 0.0f  // bottom-left        
+        };
+        glGenVertexArrays(1, &cubeVAO);
+        glGenBuffers(1, &cubeVBO);
+        // fill buffer
+        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+        // link vertex attributes
+        glBindVertexArray(cubeVAO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindVertexArray(0);
+        cubeDepthStream = createDepthStream(vertices, 36, 8);
+    }
+    // render Cube
+    if (depthOnly)
+    {
+        drawDepthStream(cubeDepthStream);
+        return;
+    }
+    glBindVertexArray(cubeVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glBindVertexArray(0);
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow *window)
+{
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && !shadowsKeyPressed)
+    {
+        shadows = !shadows;
+        shadowsKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_RELEASE)
+    {
+        shadowsKeyPressed = false;
+    }
+
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS && !animateKeyPressed)
+    {
+        animate = !animate;
+        animateKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE)
+    {
+        animateKeyPressed = false;
+    }
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+    // make sure the viewport matches the new window dimensions; note that width and 
+    // height will be significantly larger than specified on retina displays.
+    glViewport(0, 0, width, height);
+}
+
+// glfw: whenever the mouse moves, this callback is called
+// -------------------------------------------------------
+void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
+{
+    float xpos = static_cast<float>(xposIn);
+    float ypos = static_cast<float>(yposIn);
+    if (firstMouse)
+    {
+        lastX = xpos;
+        lastY = ypos;
+        firstMouse = false;
+    }
+
+    float xoffset = xpos - lastX;
+    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+
+    lastX = xpos;
+    lastY = ypos;
+
+    camera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    camera.ProcessMouseScroll(static_cast<float>(yoffset));
+}
+
+// utility function for loading a 2D texture from file
+// ---------------------------------------------------
+unsigned int loadTexture(char const * path)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    int width, height, nrComponents;
+    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
+    if (data)
+    {
+        GLenum format;
+        if (nrComponents == 1)
+            format = GL_RED;
+        else if (nrComponents == 3)
+            format = GL_RGB;
+        else if (nrComponents == 4)
+            format = GL_RGBA;
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat 
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(data);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        stbi_image_free(data);
+    }
+
+    return textureID;
+}
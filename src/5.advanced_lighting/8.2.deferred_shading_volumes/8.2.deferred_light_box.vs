@@ -2,12 +2,18 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+// the light, one per instance
+layout (location = 7) in vec4 aPositionRadius;
+layout (location = 8) in vec4 aColorLinear;
+
+out vec3 LightColor;
 
 uniform mat4 projection;
 uniform mat4 view;
-uniform mat4 model;
+uniform float boxSize;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    LightColor = aColorLinear.rgb;
+    gl_Position = projection * view * vec4(aPositionRadius.xyz + aPos * boxSize, 1.0);
 }
\ No newline at end of file
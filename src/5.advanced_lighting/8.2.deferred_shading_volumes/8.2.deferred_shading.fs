@@ -1,4 +1,6 @@
-#version 330 core
+#version 430 core
+#include "g_buffer_packing.glsl"
+#include "deferred_point_light.glsl"
 out vec4 FragColor;
 
 in vec2 TexCoords;
@@ -6,49 +8,71 @@ in vec2 TexCoords;
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedoSpec;
+// the compact layout has no position target and gNormal holds the packed normals
+uniform bool compactGBuffer;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
 
-struct Light {
-    vec3 Position;
-    vec3 Color;
-    
-    float Linear;
-    float Quadratic;
-    float Radius;
+layout (std430, binding = 0) readonly buffer Lights
+{
+    Light lights[];
+};
+
+// the light clusters, see learnopengl/light_clusters.h: per cluster the offset of its first index and the count
+const uint CLUSTER_GRID_X = 16;
+const uint CLUSTER_GRID_Y = 9;
+const uint CLUSTER_GRID_Z = 24;
+layout (std430, binding = 1) readonly buffer Clusters
+{
+    uvec2 clusters[];
+};
+layout (std430, binding = 2) readonly buffer LightIndices
+{
+    uint lightIndices[];
 };
-const int NR_LIGHTS = 32;
-uniform Light lights[NR_LIGHTS];
+
+uniform bool clustered;
+uniform int lightCount;
+uniform mat4 view;
+uniform float nearPlane;
+uniform float sliceScale;
+uniform float sliceBias;
 uniform vec3 viewPos;
 
 void main()
 {             
     // retrieve data from gbuffer
-    vec3 FragPos = texture(gPosition, TexCoords).rgb;
-    vec3 Normal = texture(gNormal, TexCoords).rgb;
+    vec3 FragPos, Normal;
+    if(compactGBuffer)
+    {
+        FragPos = reconstructPosition(TexCoords, texture(gDepth, TexCoords).r, inverseViewProjection);
+        Normal = decodeNormal(texture(gNormal, TexCoords).rg);
+    }
+    else
+    {
+        FragPos = texture(gPosition, TexCoords).rgb;
+        Normal = texture(gNormal, TexCoords).rgb;
+    }
     vec3 Diffuse = texture(gAlbedoSpec, TexCoords).rgb;
     float Specular = texture(gAlbedoSpec, TexCoords).a;
     
     // then calculate lighting as usual
     vec3 lighting  = Diffuse * 0.1; // hard-coded ambient component
     vec3 viewDir  = normalize(viewPos - FragPos);
-    for(int i = 0; i < NR_LIGHTS; ++i)
+    if(clustered)
+    {
+        // only the lights of the fragment's cluster can reach it
+        float depth = max(-(view * vec4(FragPos, 1.0)).z, nearPlane);
+        uvec3 cluster = uvec3(uvec2(TexCoords * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y)), uint(max(floor(log(depth) * sliceScale + sliceBias), 0.0)));
+        cluster = min(cluster, uvec3(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z) - 1u);
+        uvec2 range = clusters[cluster.x + (cluster.y + cluster.z * CLUSTER_GRID_Y) * CLUSTER_GRID_X];
+        for(uint i = 0u; i < range.y; ++i)
+            lighting += CalcPointLight(lights[lightIndices[range.x + i]], FragPos, Normal, viewDir, Diffuse, Specular);
+    }
+    else
     {
-        // calculate distance between light source and current fragment
-        float distance = length(lights[i].Position - FragPos);
-        if(distance < lights[i].Radius)
-        {
-            // diffuse
-            vec3 lightDir = normalize(lights[i].Position - FragPos);
-            vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * lights[i].Color;
-            // specular
-            vec3 halfwayDir = normalize(lightDir + viewDir);  
-            float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
-            vec3 specular = lights[i].Color * spec * Specular;
-            // attenuation
-            float attenuation = 1.0 / (1.0 + lights[i].Linear * distance + lights[i].Quadratic * distance * distance);
-            diffuse *= attenuation;
-            specular *= attenuation;
-            lighting += diffuse + specular;
-        }
-    }    
+        for(int i = 0; i < lightCount; ++i)
+            lighting += CalcPointLight(lights[i], FragPos, Normal, viewDir, Diffuse, Specular);
+    }
     FragColor = vec4(lighting, 1.0);
 }
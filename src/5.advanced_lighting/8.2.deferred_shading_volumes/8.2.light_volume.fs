@@ -0,0 +1,45 @@
+#version 330 core
+#include "g_buffer_packing.glsl"
+#include "deferred_point_light.glsl"
+out vec4 FragColor;
+
+flat in vec4 PositionRadius;
+flat in vec4 ColorLinear;
+flat in float Quadratic;
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedoSpec;
+// the compact layout has no position target and gNormal holds the packed normals
+uniform bool compactGBuffer;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+
+uniform vec2 screenSize;
+uniform vec3 viewPos;
+
+void main()
+{
+    // the surface behind this back face of the volume
+    vec2 TexCoords = gl_FragCoord.xy / screenSize;
+    vec3 FragPos;
+    if(compactGBuffer)
+        FragPos = reconstructPosition(TexCoords, texture(gDepth, TexCoords).r, inverseViewProjection);
+    else
+        FragPos = texture(gPosition, TexCoords).rgb;
+    // the stencil test only knows the surface is inside some light's volume
+    if(length(PositionRadius.xyz - FragPos) >= PositionRadius.w)
+        discard;
+
+    // retrieve the rest from the gbuffer
+    vec3 Normal;
+    if(compactGBuffer)
+        Normal = decodeNormal(texture(gNormal, TexCoords).rg);
+    else
+        Normal = texture(gNormal, TexCoords).rgb;
+    vec3 Diffuse = texture(gAlbedoSpec, TexCoords).rgb;
+    float Specular = texture(gAlbedoSpec, TexCoords).a;
+
+    Light light = Light(PositionRadius.xyz, PositionRadius.w, ColorLinear.rgb, ColorLinear.a, Quadratic);
+    FragColor = vec4(CalcPointLight(light, FragPos, Normal, normalize(viewPos - FragPos), Diffuse, Specular), 1.0);
+}
@@ -0,0 +1,24 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+// the light, one per instance
+layout (location = 7) in vec4 aPositionRadius;
+layout (location = 8) in vec4 aColorLinear;
+layout (location = 9) in float aQuadratic;
+
+flat out vec4 PositionRadius;
+flat out vec4 ColorLinear;
+flat out float Quadratic;
+
+uniform mat4 projection;
+uniform mat4 view;
+// the volume mesh's faces cut into the unit sphere, this scale makes it enclose it
+uniform float volumeScale;
+
+void main()
+{
+    PositionRadius = aPositionRadius;
+    ColorLinear = aColorLinear;
+    Quadratic = aQuadratic;
+    vec3 worldPos = aPositionRadius.xyz + aPos * aPositionRadius.w * volumeScale;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
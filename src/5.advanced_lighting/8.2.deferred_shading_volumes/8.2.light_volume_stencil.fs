@@ -0,0 +1,6 @@
+#version 330 core
+
+void main()
+{
+    // only the stencil buffer is written
+}
@@ -9,8 +9,11 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/light_clusters.h>
+#include <learnopengl/instance_buffer.h>
 
 #include <iostream>
+#include <chrono>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -18,7 +21,21 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 unsigned int loadTexture(const char *path, bool gammaCorrection);
 void renderQuad();
-void renderCube();
+void renderCube(const InstanceStream &lightInstances);
+void renderLightVolumes(const InstanceStream &lightInstances);
+void generateLights(unsigned int count);
+bool verifyLightClusters(ThreadPool &pool);
+
+// a point light as the shaders read it, from the light buffer as a storage buffer (std430) and as instance attributes
+struct PointLight
+{
+    glm::vec3 Position;
+    float Radius;
+    glm::vec3 Color;
+    float Linear;
+    float Quadratic;
+    float Padding[3];
+};
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -34,12 +51,38 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// G toggles the compact g-buffer
+bool useCompactGBuffer = true;
+bool gKeyPressed = false;
+
+// lighting info; L cycles through the light counts and C through the ways to shade them
+enum LightingMode {
+    CLUSTERED,     // a full screen pass over the lights of each pixel's cluster
+    LIGHT_VOLUMES, // a stencil tested pass over the pixels inside each light's volume
+    ALL_LIGHTS     // a full screen pass over all lights
+};
+const char* lightingModeNames[] = { "clustered", "light volumes", "all lights per pixel" };
+const unsigned int lightCounts[] = { 32, 256, 1024, 4096, 10000 };
+unsigned int lightCountIndex = 0;
+bool lightCountChanged = true;
+bool lKeyPressed = false;
+LightingMode lightingMode = CLUSTERED;
+bool cKeyPressed = false;
+float lightScale = 1.0f;
+std::vector<glm::vec4> lightSpheres;
+std::vector<PointLight> lights;
+// light volumes are spheres of LIGHT_VOLUME_SEGMENTS x LIGHT_VOLUME_RINGS quads, whose faces lie inside the unit
+// sphere; scaled by lightVolumeScale they enclose it
+const unsigned int LIGHT_VOLUME_SEGMENTS = 16;
+const unsigned int LIGHT_VOLUME_RINGS = 8;
+const float lightVolumeScale = 1.0f / (std::cos(3.14159265359f / LIGHT_VOLUME_SEGMENTS) * std::cos(3.14159265359f / (2 * LIGHT_VOLUME_RINGS)));
+
 int main()
 {
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
@@ -82,8 +125,11 @@ int main()
     // build and compile shaders
     // -------------------------
     Shader shaderGeometryPass("8.2.g_buffer.vs", "8.2.g_buffer.fs");
+    Shader shaderCompactGeometryPass("8.2.g_buffer.vs", "8.2.g_buffer_compact.fs");
     Shader shaderLightingPass("8.2.deferred_shading.vs", "8.2.deferred_shading.fs");
     Shader shaderLightBox("8.2.deferred_light_box.vs", "8.2.deferred_light_box.fs");
+    Shader shaderLightVolumeStencil("8.2.light_volume.vs", "8.2.light_volume_stencil.fs");
+    Shader shaderLightVolume("8.2.light_volume.vs", "8.2.light_volume.fs");
 
     // load models
     // -----------
@@ -130,36 +176,63 @@ int main()
     // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering 
     unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
     glDrawBuffers(3, attachments);
-    // create and attach depth buffer (renderbuffer)
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    // create and attach depth buffer, a texture the compact layout samples for the positions
+    unsigned int gDepth;
+    glGenTextures(1, &gDepth);
+    glBindTexture(GL_TEXTURE_2D, gDepth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
     // finally check if framebuffer is complete
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         std::cout << "Framebuffer not complete!" << std::endl;
+
+    // the compact g-buffer (G toggles) shares the depth and color + specular buffers but has no position buffer, the
+    // positions being reconstructed from depth, and packs the normals octahedrally into two 16 bit channels (see
+    // g_buffer_packing.glsl): 12 bytes a pixel to write and read instead of 24
+    unsigned int compactGBuffer;
+    glGenFramebuffers(1, &compactGBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, compactGBuffer);
+    unsigned int gPackedNormal;
+    glGenTextures(1, &gPackedNormal);
+    glBindTexture(GL_TEXTURE_2D, gPackedNormal);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, SCR_WIDTH, SCR_HEIGHT, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPackedNormal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gAlbedoSpec, 0);
+    glDrawBuffers(2, attachments);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Compact framebuffer not complete!" << std::endl;
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // lighting info
-    // -------------
-    const unsigned int NR_LIGHTS = 32;
-    std::vector<glm::vec3> lightPositions;
-    std::vector<glm::vec3> lightColors;
-    srand(13);
-    for (unsigned int i = 0; i < NR_LIGHTS; i++)
-    {
-        // calculate slightly random offsets
-        float xPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 3.0);
-        float yPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 4.0);
-        float zPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 3.0);
-        lightPositions.push_back(glm::vec3(xPos, yPos, zPos));
-        // also calculate random color
-        float rColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.)
-        float gColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.)
-        float bColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.)
-        lightColors.push_back(glm::vec3(rColor, gColor, bColor));
-    }
+    // light clusters
+    // --------------
+    // the lights, the clusters' (offset, count) pairs and their light indices, bound to 0, 1 and 2. The light buffer
+    // also feeds the instanced light volumes and boxes
+    InstanceBuffer<PointLight> lightBuffer(InstanceLayout(sizeof(PointLight))
+        .Add(FIRST_INSTANCE_ATTRIBUTE, 4, GL_FLOAT, offsetof(PointLight, Position))
+        .Add(FIRST_INSTANCE_ATTRIBUTE + 1, 4, GL_FLOAT, offsetof(PointLight, Color))
+        .Add(FIRST_INSTANCE_ATTRIBUTE + 2, 1, GL_FLOAT, offsetof(PointLight, Quadratic)), GL_STATIC_DRAW);
+    unsigned int clusterSSBO, lightIndexSSBO;
+    glGenBuffers(1, &clusterSSBO);
+    glGenBuffers(1, &lightIndexSSBO);
+    LightClusterBuilder lightClusters;
+    ThreadPool threadPool;
+    verifyLightClusters(threadPool);
+
+    // timing
+    unsigned int geometryQueries[2], lightingQueries[2];
+    glGenQueries(2, geometryQueries);
+    glGenQueries(2, lightingQueries);
+    unsigned int frame = 0;
+    unsigned int statFrames = 0;
+    double statBuildTime = 0.0, statGeometryTime = 0.0, statLightingTime = 0.0;
+    size_t statIndices = 0;
+    unsigned int statMaxClusterLights = 0;
+    double statTime = glfwGetTime();
 
     // shader configuration
     // --------------------
@@ -167,6 +240,14 @@ int main()
     shaderLightingPass.setInt("gPosition", 0);
     shaderLightingPass.setInt("gNormal", 1);
     shaderLightingPass.setInt("gAlbedoSpec", 2);
+    shaderLightingPass.setInt("gDepth", 3);
+    shaderLightingPass.setFloat("nearPlane", 0.1f);
+    shaderLightVolume.use();
+    shaderLightVolume.setInt("gPosition", 0);
+    shaderLightVolume.setInt("gNormal", 1);
+    shaderLightVolume.setInt("gAlbedoSpec", 2);
+    shaderLightVolume.setInt("gDepth", 3);
+    shaderLightVolume.setVec2("screenSize", (float)SCR_WIDTH, (float)SCR_HEIGHT);
 
     // render loop
     // -----------
@@ -182,6 +263,13 @@ int main()
         // -----
         processInput(window);
 
+        if (lightCountChanged)
+        {
+            generateLights(lightCounts[lightCountIndex]);
+            lightBuffer.Update(lights);
+            lightCountChanged = false;
+        }
+
         // render
         // ------
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -189,22 +277,46 @@ int main()
 
         // 1. geometry pass: render scene's geometry/color data into gbuffer
         // -----------------------------------------------------------------
-        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        const unsigned int geometryFBO = useCompactGBuffer ? compactGBuffer : gBuffer;
+        Shader& geometryShader = useCompactGBuffer ? shaderCompactGeometryPass : shaderGeometryPass;
+        glBindFramebuffer(GL_FRAMEBUFFER, geometryFBO);
+        glBeginQuery(GL_TIME_ELAPSED, geometryQueries[frame % 2]);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
         glm::mat4 model = glm::mat4(1.0f);
-        shaderGeometryPass.use();
-        shaderGeometryPass.setMat4("projection", projection);
-        shaderGeometryPass.setMat4("view", view);
+
+        // assign the lights to the clusters of this frame's view, on the CPU while the GPU draws the previous frame,
+        // and upload the compacted lists
+        if (lightingMode == CLUSTERED)
+        {
+            auto buildStart = std::chrono::high_resolution_clock::now();
+            lightClusters.Build(lightSpheres, view, glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f, threadPool);
+            statBuildTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count();
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterSSBO);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, lightClusters.clusters.size() * sizeof(glm::uvec2), lightClusters.clusters.data(), GL_STREAM_DRAW);
+            // never empty, a buffer without storage can't be bound
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightIndexSSBO);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<size_t>(lightClusters.indices.size(), 1) * sizeof(unsigned int), NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, lightClusters.indices.size() * sizeof(unsigned int), lightClusters.indices.data());
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            statIndices += lightClusters.indices.size();
+            for (const glm::uvec2& cluster : lightClusters.clusters)
+                statMaxClusterLights = std::max(statMaxClusterLights, cluster.y);
+        }
+
+        geometryShader.use();
+        geometryShader.setMat4("projection", projection);
+        geometryShader.setMat4("view", view);
         for (unsigned int i = 0; i < objectPositions.size(); i++)
         {
             model = glm::mat4(1.0f);
             model = glm::translate(model, objectPositions[i]);
             model = glm::scale(model, glm::vec3(0.25f));
-            shaderGeometryPass.setMat4("model", model);
-            backpack.Draw(shaderGeometryPass);
+            geometryShader.setMat4("model", model);
+            backpack.Draw(geometryShader);
         }
+        glEndQuery(GL_TIME_ELAPSED);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         // 2. lighting pass: calculate lighting by iterating over a screen filled quad pixel-by-pixel using the gbuffer's content.
@@ -214,32 +326,30 @@ int main()
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, gPosition);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gNormal);
+        glBindTexture(GL_TEXTURE_2D, useCompactGBuffer ? gPackedNormal : gNormal);
         glActiveTexture(GL_TEXTURE2);
         glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-        // send light relevant uniforms
-        for (unsigned int i = 0; i < lightPositions.size(); i++)
-        {
-            shaderLightingPass.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-            shaderLightingPass.setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
-            // update attenuation parameters and calculate radius
-            const float constant = 1.0f; // note that we don't send this to the shader, we assume it is always 1.0 (in our case)
-            const float linear = 0.7f;
-            const float quadratic = 1.8f;
-            shaderLightingPass.setFloat("lights[" + std::to_string(i) + "].Linear", linear);
-            shaderLightingPass.setFloat("lights[" + std::to_string(i) + "].Quadratic", quadratic);
-            // then calculate radius of light volume/sphere
-            const float maxBrightness = std::fmaxf(std::fmaxf(lightColors[i].r, lightColors[i].g), lightColors[i].b);
-            float radius = (-linear + std::sqrt(linear * linear - 4 * quadratic * (constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * quadratic);
-            shaderLightingPass.setFloat("lights[" + std::to_string(i) + "].Radius", radius);
-        }
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, gDepth);
+        shaderLightingPass.setBool("compactGBuffer", useCompactGBuffer);
+        shaderLightingPass.setMat4("inverseViewProjection", glm::inverse(projection * view));
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lightBuffer.ID);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, clusterSSBO);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, lightIndexSSBO);
+        shaderLightingPass.setBool("clustered", lightingMode == CLUSTERED);
+        // with light volumes this pass is left with the ambient light
+        shaderLightingPass.setInt("lightCount", lightingMode == ALL_LIGHTS ? (int)lights.size() : 0);
+        shaderLightingPass.setMat4("view", view);
+        shaderLightingPass.setFloat("sliceScale", lightClusters.sliceScale);
+        shaderLightingPass.setFloat("sliceBias", lightClusters.sliceBias);
         shaderLightingPass.setVec3("viewPos", camera.Position);
         // finally render quad
+        glBeginQuery(GL_TIME_ELAPSED, lightingQueries[frame % 2]);
         renderQuad();
 
         // 2.5. copy content of geometry's depth buffer to default framebuffer's depth buffer
         // ----------------------------------------------------------------------------------
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, geometryFBO);
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); // write to default framebuffer
         // blit to default framebuffer. Note that this may or may not work as the internal formats of both the FBO and default framebuffer have to match.
         // the internal formats are implementation defined. This works on all of my systems, but if it doesn't on yours you'll likely have to write to the 		
@@ -247,20 +357,84 @@ int main()
         glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+        // 2.6. light volumes: add each light to the pixels inside its volume, all lights in one instanced draw
+        // ----------------------------------------------------------------------------------------------------
+        if (lightingMode == LIGHT_VOLUMES)
+        {
+            glEnable(GL_STENCIL_TEST);
+            glClear(GL_STENCIL_BUFFER_BIT);
+            glDepthMask(GL_FALSE);
+            // count in the stencil buffer how many volumes each visible surface is inside: a back face behind the
+            // surface counts up and a front face behind it down, so only volumes around the surface are left counted
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glStencilFunc(GL_ALWAYS, 0, 0xFF);
+            glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+            glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+            shaderLightVolumeStencil.use();
+            shaderLightVolumeStencil.setMat4("projection", projection);
+            shaderLightVolumeStencil.setMat4("view", view);
+            shaderLightVolumeStencil.setFloat("volumeScale", lightVolumeScale);
+            renderLightVolumes(lightBuffer);
+
+            // then shade where the count isn't 0 from the back faces behind the surface, which works with the camera
+            // inside a volume as well; the shader drops the pixels outside the volume drawn
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+            glStencilFunc(GL_NOTEQUAL, 0, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+            glEnable(GL_CULL_FACE);
+            glCullFace(GL_FRONT);
+            glDepthFunc(GL_GEQUAL);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            shaderLightVolume.use();
+            shaderLightVolume.setMat4("projection", projection);
+            shaderLightVolume.setMat4("view", view);
+            shaderLightVolume.setFloat("volumeScale", lightVolumeScale);
+            shaderLightVolume.setBool("compactGBuffer", useCompactGBuffer);
+            shaderLightVolume.setMat4("inverseViewProjection", glm::inverse(projection * view));
+            shaderLightVolume.setVec3("viewPos", camera.Position);
+            renderLightVolumes(lightBuffer);
+
+            glDisable(GL_BLEND);
+            glDepthFunc(GL_LESS);
+            glCullFace(GL_BACK);
+            glDisable(GL_CULL_FACE);
+            glDepthMask(GL_TRUE);
+            glDisable(GL_STENCIL_TEST);
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        if (frame > 0)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(geometryQueries[(frame - 1) % 2], GL_QUERY_RESULT, &elapsed);
+            statGeometryTime += elapsed / 1000000.0;
+            glGetQueryObjectui64v(lightingQueries[(frame - 1) % 2], GL_QUERY_RESULT, &elapsed);
+            statLightingTime += elapsed / 1000000.0;
+        }
+        frame++;
+        statFrames++;
+        if (glfwGetTime() - statTime >= 1.0)
+        {
+            std::cout << lights.size() << " lights, " << lightingModeNames[lightingMode] << ", lighting pass: " << statLightingTime / statFrames << " ms";
+            if (lightingMode == CLUSTERED)
+                std::cout << ", cluster build: " << statBuildTime / statFrames << " ms on " << threadPool.getThreadCount() << " threads, "
+                          << statIndices / statFrames << " light indices, up to " << statMaxClusterLights << " lights in a cluster";
+            std::cout << std::endl;
+            std::cout << (useCompactGBuffer ? "compact g-buffer, 12" : "full g-buffer, 24") << " bytes a pixel, geometry pass: " << statGeometryTime / statFrames << " ms" << std::endl;
+            statFrames = 0;
+            statBuildTime = statGeometryTime = statLightingTime = 0.0;
+            statIndices = 0;
+            statMaxClusterLights = 0;
+            statTime = glfwGetTime();
+        }
+
         // 3. render lights on top of scene
         // --------------------------------
         shaderLightBox.use();
         shaderLightBox.setMat4("projection", projection);
         shaderLightBox.setMat4("view", view);
-        for (unsigned int i = 0; i < lightPositions.size(); i++)
-        {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, lightPositions[i]);
-            model = glm::scale(model, glm::vec3(0.125f));
-            shaderLightBox.setMat4("model", model);
-            shaderLightBox.setVec3("lightColor", lightColors[i]);
-            renderCube();
-        }
+        shaderLightBox.setFloat("boxSize", 0.125f * lightScale);
+        renderCube(lightBuffer);
 
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -269,15 +443,125 @@ int main()
         glfwPollEvents();
     }
 
+    glDeleteBuffers(1, &clusterSSBO);
+    glDeleteBuffers(1, &lightIndexSSBO);
+    glDeleteQueries(2, geometryQueries);
+    glDeleteQueries(2, lightingQueries);
+
     glfwTerminate();
     return 0;
 }
 
+// Scatter count lights through the same volume as the original 32. Their reach shrinks with the cube root of the count,
+// so about as many lights reach any point whatever the count and only the culling has more to do.
+// -------------------------------------------------------------------------------------------------------------------
+void generateLights(unsigned int count)
+{
+    lightSpheres.clear();
+    lights.clear();
+    lightScale = std::cbrt(32.0f / count);
+    srand(13);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // calculate slightly random offsets
+        float xPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 3.0);
+        float yPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 4.0);
+        float zPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 3.0);
+        // also calculate random color
+        float rColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.)
+        float gColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.)
+        float bColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.)
+
+        // attenuation parameters, scaling distances by lightScale
+        const float constant = 1.0f; // note that we don't send this to the shader, we assume it is always 1.0 (in our case)
+        const float linear = 0.7f / lightScale;
+        const float quadratic = 1.8f / (lightScale * lightScale);
+        // then calculate radius of light volume/sphere
+        const float maxBrightness = std::fmaxf(std::fmaxf(rColor, gColor), bColor);
+        float radius = (-linear + std::sqrt(linear * linear - 4 * quadratic * (constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * quadratic);
+        PointLight light = {};
+        light.Position = glm::vec3(xPos, yPos, zPos);
+        light.Radius = radius;
+        light.Color = glm::vec3(rColor, gColor, bColor);
+        light.Linear = linear;
+        light.Quadratic = quadratic;
+        lights.push_back(light);
+        lightSpheres.push_back(glm::vec4(light.Position, radius));
+    }
+}
+
+// verifyLightClusters() checks the cluster assignment of LightClusterBuilder against testing every light against every
+// froxel, for random lights seen from a few camera views. CPU only; prints the result and returns whether it passed.
+// -------------------------------------------------------------------------------------------------------------------
+bool verifyLightClusters(ThreadPool &pool)
+{
+    const float fovy = glm::radians(45.0f), aspect = (float)SCR_WIDTH / (float)SCR_HEIGHT, nearPlane = 0.1f, farPlane = 100.0f;
+    const glm::mat4 views[] = {
+        glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+        glm::lookAt(glm::vec3(-4.0f, 2.0f, -3.0f), glm::vec3(2.0f, -1.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+        glm::lookAt(glm::vec3(0.5f, -0.5f, 0.5f), glm::vec3(0.5f, -0.5f, -5.0f), glm::vec3(0.0f, 1.0f, 0.0f)),
+    };
+    // lights around and behind the cameras, from tiny to larger than the scene
+    std::vector<glm::vec4> spheres;
+    srand(7);
+    for (unsigned int i = 0; i < 1000; i++)
+    {
+        const glm::vec3 position(((rand() % 1000) / 1000.0f) * 40.0f - 20.0f, ((rand() % 1000) / 1000.0f) * 20.0f - 10.0f, ((rand() % 1000) / 1000.0f) * 40.0f - 20.0f);
+        spheres.push_back(glm::vec4(position, 0.05f + ((rand() % 1000) / 1000.0f) * ((rand() % 10 == 0) ? 30.0f : 3.0f)));
+    }
+
+    LightClusterBuilder builder;
+    size_t assignments = 0, missing = 0, extra = 0;
+    const float tanY = std::tan(fovy * 0.5f), tanX = tanY * aspect;
+    for (const glm::mat4 &view : views)
+    {
+        builder.Build(spheres, view, fovy, aspect, nearPlane, farPlane, pool);
+        assignments += builder.indices.size();
+        for (unsigned int z = 0; z < CLUSTER_GRID_Z; z++)
+        {
+            const float sliceNear = nearPlane * std::pow(farPlane / nearPlane, float(z) / CLUSTER_GRID_Z);
+            const float sliceFar = nearPlane * std::pow(farPlane / nearPlane, float(z + 1) / CLUSTER_GRID_Z);
+            for (unsigned int y = 0; y < CLUSTER_GRID_Y; y++)
+            {
+                for (unsigned int x = 0; x < CLUSTER_GRID_X; x++)
+                {
+                    // the view space box around the froxel, whose sides are planes through the eye
+                    const float xs[2] = { (-1.0f + 2.0f * x / CLUSTER_GRID_X) * tanX, (-1.0f + 2.0f * (x + 1) / CLUSTER_GRID_X) * tanX };
+                    const float ys[2] = { (-1.0f + 2.0f * y / CLUSTER_GRID_Y) * tanY, (-1.0f + 2.0f * (y + 1) / CLUSTER_GRID_Y) * tanY };
+                    const glm::vec3 minimum(std::min(xs[0] * sliceNear, xs[0] * sliceFar), std::min(ys[0] * sliceNear, ys[0] * sliceFar), -sliceFar);
+                    const glm::vec3 maximum(std::max(xs[1] * sliceNear, xs[1] * sliceFar), std::max(ys[1] * sliceNear, ys[1] * sliceFar), -sliceNear);
+
+                    const glm::uvec2 cluster = builder.clusters[x + (y + z * CLUSTER_GRID_Y) * CLUSTER_GRID_X];
+                    std::vector<bool> assigned(spheres.size(), false);
+                    for (unsigned int i = 0; i < cluster.y; i++)
+                        assigned[builder.indices[cluster.x + i]] = true;
+                    for (unsigned int light = 0; light < spheres.size(); light++)
+                    {
+                        const glm::vec3 center = glm::vec3(view * glm::vec4(glm::vec3(spheres[light]), 1.0f));
+                        const glm::vec3 outside = glm::max(glm::max(minimum - center, center - maximum), glm::vec3(0.0f));
+                        const float distanceSquared = glm::dot(outside, outside);
+                        // a little slack either way, the builder's boxes are rounded differently
+                        const float radius = spheres[light].w;
+                        if (!assigned[light] && distanceSquared < radius * radius * 0.999f)
+                            missing++;
+                        if (assigned[light] && distanceSquared > radius * radius * 1.001f)
+                            extra++;
+                    }
+                }
+            }
+        }
+    }
+    const bool passed = missing == 0 && extra == 0;
+    std::cout << (passed ? "" : "ERROR::LIGHT_CLUSTERS:: ") << "light cluster self-check: " << assignments << " assignments over "
+              << sizeof(views) / sizeof(views[0]) << " views, " << missing << " missing, " << extra << " extra" << std::endl;
+    return passed;
+}
+
 // renderCube() renders a 1x1 3D cube in NDC.
 // -------------------------------------------------
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
-void renderCube()
+void renderCube(const InstanceStream &lightInstances)
 {
     // initialize (if necessary)
     if (cubeVAO == 0)
@@ -339,12 +623,76 @@ void renderCube()
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
         glEnableVertexAttribArray(2);
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+        // and a cube per light
+        lightInstances.SetupAttributes();
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
     }
-    // render Cube
+    // render Cubes
     glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, lightInstances.count);
+    glBindVertexArray(0);
+}
+
+// renderLightVolumes() renders a sphere around every light, scaled by its radius (times lightVolumeScale) in the shader
+// ---------------------------------------------------------------------------------------------------------------------
+unsigned int lightVolumeVAO = 0;
+unsigned int lightVolumeIndexCount;
+void renderLightVolumes(const InstanceStream &lightInstances)
+{
+    if (lightVolumeVAO == 0)
+    {
+        const float PI = 3.14159265359f;
+        std::vector<glm::vec3> positions;
+        for (unsigned int y = 0; y <= LIGHT_VOLUME_RINGS; ++y)
+        {
+            for (unsigned int x = 0; x <= LIGHT_VOLUME_SEGMENTS; ++x)
+            {
+                float xSegment = (float)x / (float)LIGHT_VOLUME_SEGMENTS;
+                float ySegment = (float)y / (float)LIGHT_VOLUME_RINGS;
+                positions.push_back(glm::vec3(std::cos(xSegment * 2.0f * PI) * std::sin(ySegment * PI), std::cos(ySegment * PI), std::sin(xSegment * 2.0f * PI) * std::sin(ySegment * PI)));
+            }
+        }
+        // counter-clockwise seen from outside, so back face culling keeps the near half
+        std::vector<unsigned int> indices;
+        for (unsigned int y = 0; y < LIGHT_VOLUME_RINGS; ++y)
+        {
+            for (unsigned int x = 0; x < LIGHT_VOLUME_SEGMENTS; ++x)
+            {
+                unsigned int topLeft = y * (LIGHT_VOLUME_SEGMENTS + 1) + x;
+                unsigned int bottomLeft = topLeft + LIGHT_VOLUME_SEGMENTS + 1;
+                if (y != 0) // the top ring's quads are triangles
+                {
+                    indices.push_back(topLeft);
+                    indices.push_back(topLeft + 1);
+                    indices.push_back(bottomLeft);
+                }
+                if (y != LIGHT_VOLUME_RINGS - 1) // and so are the bottom ring's
+                {
+                    indices.push_back(topLeft + 1);
+                    indices.push_back(bottomLeft + 1);
+                    indices.push_back(bottomLeft);
+                }
+            }
+        }
+        lightVolumeIndexCount = static_cast<unsigned int>(indices.size());
+
+        unsigned int vbo, ebo;
+        glGenVertexArrays(1, &lightVolumeVAO);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glBindVertexArray(lightVolumeVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        lightInstances.SetupAttributes();
+        glBindVertexArray(0);
+    }
+    glBindVertexArray(lightVolumeVAO);
+    glDrawElementsInstanced(GL_TRIANGLES, lightVolumeIndexCount, GL_UNSIGNED_INT, 0, lightInstances.count);
     glBindVertexArray(0);
 }
 
@@ -395,6 +743,35 @@ void processInput(GLFWwindow *window)
         camera.ProcessKeyboard(LEFT, deltaTime);
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
         camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS && !lKeyPressed)
+    {
+        lightCountIndex = (lightCountIndex + 1) % (sizeof(lightCounts) / sizeof(lightCounts[0]));
+        lightCountChanged = true;
+        lKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_L) == GLFW_RELEASE)
+    {
+        lKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS && !cKeyPressed)
+    {
+        lightingMode = LightingMode((lightingMode + 1) % 3);
+        cKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE)
+    {
+        cKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS && !gKeyPressed)
+    {
+        useCompactGBuffer = !useCompactGBuffer;
+        gKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_G) == GLFW_RELEASE)
+    {
+        gKeyPressed = false;
+    }
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
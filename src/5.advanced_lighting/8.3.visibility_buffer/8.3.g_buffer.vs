@@ -0,0 +1,30 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+out vec3 FragPos;
+out vec2 TexCoords;
+out vec3 Normal;
+
+// the model matrices of the instances
+layout (std430, binding = 2) readonly buffer Instances
+{
+    mat4 models[];
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    mat4 model = models[gl_InstanceID];
+    vec4 worldPos = model * vec4(aPos, 1.0);
+    FragPos = worldPos.xyz; 
+    TexCoords = aTexCoords;
+    
+    // the instances are only moved and uniformly scaled, which leaves normals pointing the same way
+    Normal = mat3(model) * aNormal;
+
+    gl_Position = projection * view * worldPos;
+}
@@ -0,0 +1,11 @@
+#version 430 core
+#include "visibility_buffer.glsl"
+layout (location = 0) out uint Visibility;
+
+flat in uint Instance;
+
+void main()
+{
+    // all the geometry is drawn at once, so the primitive is the triangle's index in the whole geometry
+    Visibility = packVisibility(Instance, uint(gl_PrimitiveID));
+}
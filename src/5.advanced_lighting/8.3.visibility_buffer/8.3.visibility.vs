@@ -0,0 +1,19 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+
+flat out uint Instance;
+
+// the model matrices of the instances
+layout (std430, binding = 2) readonly buffer Instances
+{
+    mat4 models[];
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    Instance = uint(gl_InstanceID);
+    gl_Position = projection * view * models[gl_InstanceID] * vec4(aPos, 1.0);
+}
@@ -0,0 +1,85 @@
+#version 430 core
+#include "visibility_buffer.glsl"
+#include "deferred_point_light.glsl"
+out vec4 FragColor;
+
+uniform usampler2D visibility;
+uniform sampler2D texture_diffuse1;
+uniform sampler2D texture_specular1;
+// the run of triangles of the mesh whose textures are bound, the other meshes' pixels are shaded by their own pass
+uniform int firstTriangle;
+uniform int triangleCount;
+
+// the geometry's vertices (position, normal and texture coordinates, 8 floats each) and triangles, and the instances
+layout (std430, binding = 0) readonly buffer Vertices
+{
+    float vertices[];
+};
+layout (std430, binding = 1) readonly buffer Indices
+{
+    uint indices[];
+};
+layout (std430, binding = 2) readonly buffer Instances
+{
+    mat4 models[];
+};
+
+uniform mat4 viewProjection;
+uniform vec2 screenSize;
+
+const int NR_LIGHTS = 32;
+uniform Light lights[NR_LIGHTS];
+uniform vec3 viewPos;
+
+vec3 fetchVec3(uint vertex, uint offset)
+{
+    uint i = vertex * 8u + offset;
+    return vec3(vertices[i], vertices[i + 1u], vertices[i + 2u]);
+}
+
+vec2 fetchVec2(uint vertex, uint offset)
+{
+    uint i = vertex * 8u + offset;
+    return vec2(vertices[i], vertices[i + 1u]);
+}
+
+void main()
+{
+    uint instance, triangle;
+    if(!unpackVisibility(texelFetch(visibility, ivec2(gl_FragCoord.xy), 0).r, instance, triangle))
+        discard;
+    if(triangle < uint(firstTriangle) || triangle >= uint(firstTriangle + triangleCount))
+        discard;
+
+    // fetch the triangle's corners
+    uint i0 = indices[triangle * 3u];
+    uint i1 = indices[triangle * 3u + 1u];
+    uint i2 = indices[triangle * 3u + 2u];
+    mat4 model = models[instance];
+    mat3 positions = mat3(vec3(model * vec4(fetchVec3(i0, 0u), 1.0)),
+                          vec3(model * vec4(fetchVec3(i1, 0u), 1.0)),
+                          vec3(model * vec4(fetchVec3(i2, 0u), 1.0)));
+    mat3 normals = mat3(fetchVec3(i0, 3u), fetchVec3(i1, 3u), fetchVec3(i2, 3u));
+    mat3x2 texCoords = mat3x2(fetchVec2(i0, 6u), fetchVec2(i1, 6u), fetchVec2(i2, 6u));
+
+    // and interpolate them at this pixel, and at its neighbours for the texture coordinates' derivatives
+    mat3 solver = barycentricSolver(viewProjection * vec4(positions[0], 1.0), viewProjection * vec4(positions[1], 1.0), viewProjection * vec4(positions[2], 1.0));
+    vec2 ndc = gl_FragCoord.xy / screenSize * 2.0 - 1.0;
+    vec2 pixel = 2.0 / screenSize;
+    vec3 weights = barycentrics(solver, ndc);
+    vec3 FragPos = positions * weights;
+    // the instances are only moved and uniformly scaled, which leaves normals pointing the same way
+    vec3 Normal = normalize(mat3(model) * (normals * weights));
+    vec2 TexCoords = texCoords * weights;
+    vec2 dx = texCoords * barycentrics(solver, ndc + vec2(pixel.x, 0.0)) - TexCoords;
+    vec2 dy = texCoords * barycentrics(solver, ndc + vec2(0.0, pixel.y)) - TexCoords;
+    vec3 Diffuse = textureGrad(texture_diffuse1, TexCoords, dx, dy).rgb;
+    float Specular = textureGrad(texture_specular1, TexCoords, dx, dy).r;
+
+    // then calculate lighting like the deferred lighting pass
+    vec3 lighting  = Diffuse * 0.1; // hard-coded ambient component
+    vec3 viewDir  = normalize(viewPos - FragPos);
+    for(int i = 0; i < NR_LIGHTS; ++i)
+        lighting += CalcPointLight(lights[i], FragPos, Normal, viewDir, Diffuse, Specular);
+    FragColor = vec4(lighting, 1.0);
+}
@@ -0,0 +1,577 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/camera.h>
+#include <learnopengl/model.h>
+#include <learnopengl/visibility_buffer.h>
+
+#include <iostream>
+#include <iomanip>
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void processInput(GLFWwindow *window);
+void renderQuad();
+
+// settings
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+
+// camera
+Camera camera(glm::vec3(0.0f, 0.0f, 5.0f));
+float lastX = (float)SCR_WIDTH / 2.0;
+float lastY = (float)SCR_HEIGHT / 2.0;
+bool firstMouse = true;
+
+// timing
+float deltaTime = 0.0f;
+float lastFrame = 0.0f;
+
+// V toggles between the visibility buffer and the classic g-buffer, T cycles through the triangle densities (how
+// many times every triangle of the model is split in 4)
+const unsigned int DENSITY_COUNT = 3;
+bool useVisibilityBuffer = true;
+bool vKeyPressed = false;
+unsigned int density = 0;
+bool tKeyPressed = false;
+
+// B benchmarks both paths at every density, BENCHMARK_FRAMES frames each of which the first BENCHMARK_WARMUP aren't
+// measured, and prints the average pass times
+const unsigned int BENCHMARK_FRAMES = 200;
+const unsigned int BENCHMARK_WARMUP = 20;
+bool benchmarkRunning = false;
+unsigned int benchmarkFrame = 0;
+bool bKeyPressed = false;
+
+int main()
+{
+    // glfw: initialize and configure
+    // ------------------------------
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+    // glfw window creation
+    // --------------------
+    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+
+    // tell GLFW to capture our mouse
+    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    // glad: load all OpenGL function pointers
+    // ---------------------------------------
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return -1;
+    }
+
+    // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
+    stbi_set_flip_vertically_on_load(true);
+
+    // configure global opengl state
+    // -----------------------------
+    glEnable(GL_DEPTH_TEST);
+
+    // build and compile shaders
+    // -------------------------
+    Shader shaderGeometryPass("8.3.g_buffer.vs", "8.3.g_buffer.fs");
+    Shader shaderLightingPass("8.3.deferred_shading.vs", "8.3.deferred_shading.fs");
+    Shader shaderVisibilityPass("8.3.visibility.vs", "8.3.visibility.fs");
+    Shader shaderResolvePass("8.3.deferred_shading.vs", "8.3.visibility_resolve.fs");
+
+    // load models
+    // -----------
+    Model backpack(FileSystem::getPath("resources/objects/backpack/backpack.obj"));
+    std::vector<glm::vec3> objectPositions;
+    objectPositions.push_back(glm::vec3(-3.0,  -0.5, -3.0));
+    objectPositions.push_back(glm::vec3( 0.0,  -0.5, -3.0));
+    objectPositions.push_back(glm::vec3( 3.0,  -0.5, -3.0));
+    objectPositions.push_back(glm::vec3(-3.0,  -0.5,  0.0));
+    objectPositions.push_back(glm::vec3( 0.0,  -0.5,  0.0));
+    objectPositions.push_back(glm::vec3( 3.0,  -0.5,  0.0));
+    objectPositions.push_back(glm::vec3(-3.0,  -0.5,  3.0));
+    objectPositions.push_back(glm::vec3( 0.0,  -0.5,  3.0));
+    objectPositions.push_back(glm::vec3( 3.0,  -0.5,  3.0));
+    const unsigned int instanceCount = static_cast<unsigned int>(objectPositions.size());
+
+    // the backpack's meshes in a single vertex and index buffer, once per triangle density
+    VisibilityGeometry geometries[DENSITY_COUNT];
+    for (unsigned int i = 0; i < DENSITY_COUNT; i++)
+    {
+        geometries[i] = createVisibilityGeometry(backpack, i);
+        std::cout << "density " << i << ": " << geometries[i].triangleCount * instanceCount << " triangles" << std::endl;
+    }
+
+    // the instances' model matrices, read by both paths from a storage buffer bound to 2
+    std::vector<glm::mat4> models;
+    for (unsigned int i = 0; i < instanceCount; i++)
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, objectPositions[i]);
+        model = glm::scale(model, glm::vec3(0.5f));
+        models.push_back(model);
+    }
+    unsigned int instanceSSBO;
+    glGenBuffers(1, &instanceSSBO);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceSSBO);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, models.size() * sizeof(glm::mat4), models.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // configure g-buffer framebuffer
+    // ------------------------------
+    unsigned int gBuffer;
+    glGenFramebuffers(1, &gBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+    unsigned int gPosition, gNormal, gAlbedoSpec;
+    // position color buffer
+    glGenTextures(1, &gPosition);
+    glBindTexture(GL_TEXTURE_2D, gPosition);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
+    // normal color buffer
+    glGenTextures(1, &gNormal);
+    glBindTexture(GL_TEXTURE_2D, gNormal);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
+    // color + specular color buffer
+    glGenTextures(1, &gAlbedoSpec);
+    glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedoSpec, 0);
+    // tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
+    unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+    glDrawBuffers(3, attachments);
+    // create and attach depth buffer (renderbuffer)
+    unsigned int rboDepth;
+    glGenRenderbuffers(1, &rboDepth);
+    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, SCR_WIDTH, SCR_HEIGHT);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    // finally check if framebuffer is complete
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Framebuffer not complete!" << std::endl;
+
+    // configure visibility buffer framebuffer: a 32-bit triangle and instance id and the same depth buffer
+    // -----------------------------------------------------------------------------------------------------
+    unsigned int visibilityBuffer;
+    glGenFramebuffers(1, &visibilityBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, visibilityBuffer);
+    unsigned int gVisibility;
+    glGenTextures(1, &gVisibility);
+    glBindTexture(GL_TEXTURE_2D, gVisibility);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, SCR_WIDTH, SCR_HEIGHT, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gVisibility, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "Framebuffer not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // lighting info
+    // -------------
+    const unsigned int NR_LIGHTS = 32;
+    std::vector<glm::vec3> lightPositions;
+    std::vector<glm::vec3> lightColors;
+    srand(13);
+    for (unsigned int i = 0; i < NR_LIGHTS; i++)
+    {
+        // calculate slightly random offsets
+        float xPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 3.0);
+        float yPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 4.0);
+        float zPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 3.0);
+        lightPositions.push_back(glm::vec3(xPos, yPos, zPos));
+        // also calculate random color
+        float rColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.0
+        float gColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.0
+        float bColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5); // between 0.5 and 1.0
+        lightColors.push_back(glm::vec3(rColor, gColor, bColor));
+    }
+
+    // shader configuration
+    // --------------------
+    // both shading passes light the same way, with deferred_point_light.glsl
+    for (Shader *shader : { &shaderLightingPass, &shaderResolvePass })
+    {
+        shader->use();
+        for (unsigned int i = 0; i < lightPositions.size(); i++)
+        {
+            shader->setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
+            shader->setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
+            // update attenuation parameters and calculate radius
+            const float constant = 1.0f; // note that we don't send this to the shader, we assume it is always 1.0 (in our case)
+            const float linear = 0.7f;
+            const float quadratic = 1.8f;
+            shader->setFloat("lights[" + std::to_string(i) + "].Linear", linear);
+            shader->setFloat("lights[" + std::to_string(i) + "].Quadratic", quadratic);
+            // then calculate radius of light volume/sphere
+            const float maxBrightness = std::fmaxf(std::fmaxf(lightColors[i].r, lightColors[i].g), lightColors[i].b);
+            float radius = (-linear + std::sqrt(linear * linear - 4 * quadratic * (constant - (256.0f / 5.0f) * maxBrightness))) / (2.0f * quadratic);
+            shader->setFloat("lights[" + std::to_string(i) + "].Radius", radius);
+        }
+    }
+    shaderLightingPass.use();
+    shaderLightingPass.setInt("gPosition", 0);
+    shaderLightingPass.setInt("gNormal", 1);
+    shaderLightingPass.setInt("gAlbedoSpec", 2);
+    shaderResolvePass.use();
+    shaderResolvePass.setVec2("screenSize", (float)SCR_WIDTH, (float)SCR_HEIGHT);
+
+    // GPU timers of the geometry and the lighting (or resolve) pass, read back a frame late, with the path and density
+    // each frame measured and the benchmark configuration it belongs to (-1 for none)
+    unsigned int geometryQueries[2], shadingQueries[2];
+    glGenQueries(2, geometryQueries);
+    glGenQueries(2, shadingQueries);
+    bool queryVisibility[2];
+    unsigned int queryDensity[2];
+    int queryBenchmark[2];
+    unsigned int frame = 0;
+    unsigned int statFrames = 0;
+    double statGeometryTime = 0.0, statShadingTime = 0.0;
+    double statTime = glfwGetTime();
+    // per benchmark configuration, density * 2 + (visibility buffer ? 1 : 0)
+    double benchmarkGeometryTime[DENSITY_COUNT * 2], benchmarkShadingTime[DENSITY_COUNT * 2];
+    unsigned int benchmarkSamples[DENSITY_COUNT * 2];
+
+    // render loop
+    // -----------
+    while (!glfwWindowShouldClose(window))
+    {
+        // per-frame time logic
+        // --------------------
+        auto currentFrame = static_cast<float>(glfwGetTime());
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        // input
+        // -----
+        processInput(window);
+
+        // a benchmark takes over the path and density
+        int benchmarkConfig = -1;
+        if (benchmarkRunning)
+        {
+            if (benchmarkFrame == 0)
+            {
+                for (unsigned int i = 0; i < DENSITY_COUNT * 2; i++)
+                {
+                    benchmarkGeometryTime[i] = benchmarkShadingTime[i] = 0.0;
+                    benchmarkSamples[i] = 0;
+                }
+            }
+            if (benchmarkFrame < DENSITY_COUNT * 2 * BENCHMARK_FRAMES)
+            {
+                const unsigned int config = benchmarkFrame / BENCHMARK_FRAMES;
+                density = config / 2;
+                useVisibilityBuffer = config % 2 == 1;
+                if (benchmarkFrame % BENCHMARK_FRAMES >= BENCHMARK_WARMUP)
+                    benchmarkConfig = config;
+            }
+        }
+        const VisibilityGeometry &geometry = geometries[density];
+
+        // render
+        // ------
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, instanceSSBO);
+        queryVisibility[frame % 2] = useVisibilityBuffer;
+        queryDensity[frame % 2] = density;
+        queryBenchmark[frame % 2] = benchmarkConfig;
+        if (useVisibilityBuffer)
+        {
+            // 1. visibility pass: only which triangle of which instance is visible at each pixel
+            // -----------------------------------------------------------------------------------
+            glBeginQuery(GL_TIME_ELAPSED, geometryQueries[frame % 2]);
+            glBindFramebuffer(GL_FRAMEBUFFER, visibilityBuffer);
+                const GLuint emptyVisibility[4] = { 0xFFFFFFFFu, 0, 0, 0 };
+                glClearBufferuiv(GL_COLOR, 0, emptyVisibility);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                shaderVisibilityPass.use();
+                shaderVisibilityPass.setMat4("projection", projection);
+                shaderVisibilityPass.setMat4("view", view);
+                // all meshes at once from the position stream, the triangles' order being the same
+                drawDepthStream(geometry.depthStream, instanceCount);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glEndQuery(GL_TIME_ELAPSED);
+
+            // 2. resolve pass: fetch the visible triangle's vertices, interpolate them at the pixel and shade it. Every
+            // mesh is resolved with its own textures, leaving the pixels of the others alone.
+            // ---------------------------------------------------------------------------------------------------------
+            glBeginQuery(GL_TIME_ELAPSED, shadingQueries[frame % 2]);
+            glDisable(GL_DEPTH_TEST);
+            shaderResolvePass.use();
+            shaderResolvePass.setMat4("viewProjection", projection * view);
+            shaderResolvePass.setVec3("viewPos", camera.Position);
+            bindVisibilityGeometry(geometry, 0, 1);
+            for (unsigned int i = 0; i < geometry.meshes.size(); i++)
+            {
+                const VisibilityMesh &mesh = geometry.meshes[i];
+                mesh.mesh->BindTextures(shaderResolvePass);
+                // the visibility buffer goes on the unit after the mesh's textures
+                const int visibilityUnit = static_cast<int>(mesh.mesh->textures.size());
+                glActiveTexture(GL_TEXTURE0 + visibilityUnit);
+                glBindTexture(GL_TEXTURE_2D, gVisibility);
+                shaderResolvePass.setInt("visibility", visibilityUnit);
+                shaderResolvePass.setInt("firstTriangle", static_cast<int>(mesh.firstTriangle));
+                shaderResolvePass.setInt("triangleCount", static_cast<int>(mesh.triangleCount));
+                renderQuad();
+            }
+            glActiveTexture(GL_TEXTURE0);
+            glEnable(GL_DEPTH_TEST);
+            glEndQuery(GL_TIME_ELAPSED);
+        }
+        else
+        {
+            // 1. geometry pass: render scene's geometry/color data into gbuffer
+            // -----------------------------------------------------------------
+            glBeginQuery(GL_TIME_ELAPSED, geometryQueries[frame % 2]);
+            glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                shaderGeometryPass.use();
+                shaderGeometryPass.setMat4("projection", projection);
+                shaderGeometryPass.setMat4("view", view);
+                for (unsigned int i = 0; i < geometry.meshes.size(); i++)
+                {
+                    geometry.meshes[i].mesh->BindTextures(shaderGeometryPass);
+                    drawVisibilityMesh(geometry, i, instanceCount);
+                }
+                glActiveTexture(GL_TEXTURE0);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glEndQuery(GL_TIME_ELAPSED);
+
+            // 2. lighting pass: calculate lighting by iterating over a screen filled quad pixel-by-pixel using the gbuffer's content.
+            // -----------------------------------------------------------------------------------------------------------------------
+            glBeginQuery(GL_TIME_ELAPSED, shadingQueries[frame % 2]);
+            shaderLightingPass.use();
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, gPosition);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, gNormal);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
+            shaderLightingPass.setVec3("viewPos", camera.Position);
+            // finally render quad
+            renderQuad();
+            glEndQuery(GL_TIME_ELAPSED);
+        }
+
+        // read back the previous frame's timers
+        if (frame > 0)
+        {
+            const unsigned int previous = (frame - 1) % 2;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(geometryQueries[previous], GL_QUERY_RESULT, &elapsed);
+            const double geometryTime = elapsed / 1000000.0;
+            glGetQueryObjectui64v(shadingQueries[previous], GL_QUERY_RESULT, &elapsed);
+            const double shadingTime = elapsed / 1000000.0;
+            if (queryVisibility[previous] == useVisibilityBuffer && queryDensity[previous] == density)
+            {
+                statGeometryTime += geometryTime;
+                statShadingTime += shadingTime;
+                statFrames++;
+            }
+            if (queryBenchmark[previous] >= 0)
+            {
+                benchmarkGeometryTime[queryBenchmark[previous]] += geometryTime;
+                benchmarkShadingTime[queryBenchmark[previous]] += shadingTime;
+                benchmarkSamples[queryBenchmark[previous]]++;
+            }
+        }
+        frame++;
+        if (glfwGetTime() - statTime >= 1.0 && statFrames > 0)
+        {
+            std::cout << geometry.triangleCount * instanceCount << " triangles, "
+                      << (useVisibilityBuffer ? "visibility buffer, 8 bytes a pixel, visibility pass: " : "g-buffer, 24 bytes a pixel, geometry pass: ")
+                      << statGeometryTime / statFrames << " ms, " << (useVisibilityBuffer ? "resolve pass: " : "lighting pass: ")
+                      << statShadingTime / statFrames << " ms" << std::endl;
+            statFrames = 0;
+            statGeometryTime = statShadingTime = 0.0;
+            statTime = glfwGetTime();
+        }
+
+        // the last benchmark frame was read back above
+        if (benchmarkRunning && ++benchmarkFrame > DENSITY_COUNT * 2 * BENCHMARK_FRAMES)
+        {
+            std::cout << "benchmark, average ms of the geometry + shading passes:" << std::endl;
+            for (unsigned int i = 0; i < DENSITY_COUNT; i++)
+            {
+                std::cout << std::setw(10) << geometries[i].triangleCount * instanceCount << " triangles";
+                for (unsigned int path = 0; path < 2; path++)
+                {
+                    const unsigned int config = i * 2 + path;
+                    const double samples = std::max(benchmarkSamples[config], 1u);
+                    std::cout << (path == 0 ? ", g-buffer: " : ", visibility buffer: ") << std::fixed << std::setprecision(3)
+                              << benchmarkGeometryTime[config] / samples << " + " << benchmarkShadingTime[config] / samples << " = "
+                              << (benchmarkGeometryTime[config] + benchmarkShadingTime[config]) / samples << std::defaultfloat;
+                }
+                std::cout << std::endl;
+            }
+            benchmarkRunning = false;
+        }
+
+        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+        // -------------------------------------------------------------------------------
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+
+    for (unsigned int i = 0; i < DENSITY_COUNT; i++)
+        deleteVisibilityGeometry(geometries[i]);
+    glDeleteBuffers(1, &instanceSSBO);
+    glDeleteQueries(2, geometryQueries);
+    glDeleteQueries(2, shadingQueries);
+
+    glfwTerminate();
+    return 0;
+}
+
+// renderQuad() renders a 1x1 XY quad in NDC
+// -----------------------------------------
+unsigned int quadVAO = 0;
+unsigned int quadVBO;
+void renderQuad()
+{
+    if (quadVAO == 0)
+    {
+        float quadVertices[] = {
+            // positions        // texture Coords
+            -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
+            -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
+             1.0f,  1.0f, 0.0f, 1.0f, 1.0f,
+             1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
+        };
+        // setup plane VAO
+        glGenVertexArrays(1, &quadVAO);
+        glGenBuffers(1, &quadVBO);
+        glBindVertexArray(quadVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    }
+    glBindVertexArray(quadVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glBindVertexArray(0);
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow *window)
+{
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+
+    // the benchmark picks the path and density itself
+    if (benchmarkRunning)
+        return;
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS && !vKeyPressed)
+    {
+        useVisibilityBuffer = !useVisibilityBuffer;
+        vKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_RELEASE)
+    {
+        vKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS && !tKeyPressed)
+    {
+        density = (density + 1) % DENSITY_COUNT;
+        tKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_RELEASE)
+    {
+        tKeyPressed = false;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !bKeyPressed)
+    {
+        benchmarkRunning = true;
+        benchmarkFrame = 0;
+        bKeyPressed = true;
+    }
+    if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE)
+    {
+        bKeyPressed = false;
+    }
+}
+
+// glfw: whenever the window size changed (by OS or user resize) this callback function executes
+// ---------------------------------------------------------------------------------------------
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+    // make sure the viewport matches the new window dimensions; note that width and
+    // height will be significantly larger than specified on retina displays.
+    glViewport(0, 0, width, height);
+}
+
+// glfw: whenever the mouse moves, this callback is called
+// -------------------------------------------------------
+void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
+{
+    float xpos = static_cast<float>(xposIn);
+    float ypos = static_cast<float>(yposIn);
+    if (firstMouse)
+    {
+        lastX = xpos;
+        lastY = ypos;
+        firstMouse = false;
+    }
+
+    float xoffset = xpos - lastX;
+    float yoffset = lastY - ypos; // reversed since y-coordinates go from bottom to top
+
+    lastX = xpos;
+    lastY = ypos;
+
+    camera.ProcessMouseMovement(xoffset, yoffset);
+}
+
+// glfw: whenever the mouse scroll wheel scrolls, this callback is called
+// ----------------------------------------------------------------------
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
+{
+    camera.ProcessMouseScroll(static_cast<float>(yoffset));
+}
@@ -1,9 +1,10 @@
 #version 330 core
+#include "g_buffer_packing.glsl"
 out float FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D texNoise;
 
@@ -18,12 +19,13 @@ float bias = 0.025;
 const vec2 noiseScale = vec2(800.0/4.0, 600.0/4.0); 
 
 uniform mat4 projection;
+uniform mat4 inverseProjection;
 
 void main()
 {
     // get input for SSAO algorithm
-    vec3 fragPos = texture(gPosition, TexCoords).xyz;
-    vec3 normal = normalize(texture(gNormal, TexCoords).rgb);
+    vec3 fragPos = reconstructPosition(TexCoords, texture(gDepth, TexCoords).r, inverseProjection);
+    vec3 normal = decodeNormal(texture(gNormal, TexCoords).rg);
     vec3 randomVec = normalize(texture(texNoise, TexCoords * noiseScale).xyz);
     // create TBN change-of-basis matrix: from tangent-space to view-space
     vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
@@ -44,7 +46,7 @@ void main()
         offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
         
         // get sample depth
-        float sampleDepth = texture(gPosition, offset.xy).z; // get depth value of kernel sample
+        float sampleDepth = reconstructPosition(offset.xy, texture(gDepth, offset.xy).r, inverseProjection).z; // get depth value of kernel sample
         
         // range check & accumulate
         float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
@@ -1,7 +1,7 @@
 #version 330 core
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec3 gAlbedo;
+#include "g_buffer_packing.glsl"
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec3 gAlbedo;
 
 in vec2 TexCoords;
 in vec3 FragPos;
@@ -9,10 +9,9 @@ in vec3 Normal;
 
 void main()
 {    
-    // store the fragment position vector in the first gbuffer texture
-    gPosition = FragPos;
-    // also store the per-fragment normals into the gbuffer
-    gNormal = normalize(Normal);
+    // the fragment position is reconstructed from the depth buffer, so only
+    // store the per-fragment normals into the gbuffer
+    gNormal = encodeNormal(normalize(Normal));
     // and the diffuse per-fragment color
     gAlbedo.rgb = vec3(0.95);
 }
\ No newline at end of file
@@ -1,9 +1,10 @@
 #version 330 core
+#include "g_buffer_packing.glsl"
 out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedo;
 uniform sampler2D ssao;
@@ -16,12 +17,13 @@ struct Light {
     float Quadratic;
 };
 uniform Light light;
+uniform mat4 inverseProjection;
 
 void main()
 {             
     // retrieve data from gbuffer
-    vec3 FragPos = texture(gPosition, TexCoords).rgb;
-    vec3 Normal = texture(gNormal, TexCoords).rgb;
+    vec3 FragPos = reconstructPosition(TexCoords, texture(gDepth, TexCoords).r, inverseProjection);
+    vec3 Normal = decodeNormal(texture(gNormal, TexCoords).rg);
     vec3 Diffuse = texture(gAlbedo, TexCoords).rgb;
     float AmbientOcclusion = texture(ssao, TexCoords).r;
     
@@ -0,0 +1,27 @@
+// The Blinn-Phong point light of the deferred samples, included after the #version line. Its light volume is the
+// sphere of Radius around Position, past which the attenuated light is too dark to see and is left out.
+struct Light {
+    vec3 Position;
+    float Radius;
+    vec3 Color;
+    float Linear;
+    float Quadratic;
+};
+
+vec3 CalcPointLight(Light light, vec3 FragPos, vec3 Normal, vec3 viewDir, vec3 Diffuse, float Specular)
+{
+    // calculate distance between light source and current fragment
+    float distance = length(light.Position - FragPos);
+    if(distance >= light.Radius)
+        return vec3(0.0);
+    // diffuse
+    vec3 lightDir = normalize(light.Position - FragPos);
+    vec3 diffuse = max(dot(Normal, lightDir), 0.0) * Diffuse * light.Color;
+    // specular
+    vec3 halfwayDir = normalize(lightDir + viewDir);  
+    float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
+    vec3 specular = light.Color * spec * Specular;
+    // attenuation
+    float attenuation = 1.0 / (1.0 + light.Linear * distance + light.Quadratic * distance * distance);
+    return (diffuse + specular) * attenuation;
+}
@@ -0,0 +1,31 @@
+// Compact G-buffer: the depth buffer, an RG16 octahedral normal and RGBA8 albedo + specular, 12 bytes a pixel where a
+// full position and normal target take 24 with the same albedo and depth. Shared by the geometry and lighting shaders
+// of the deferred and SSAO samples, included after the #version line.
+
+// The unit normal projected onto the octahedron |x| + |y| + |z| = 1, its lower half folded over the upper one, in [0, 1]
+vec2 encodeNormal(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if(n.z < 0.0)
+        e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+vec3 decodeNormal(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    // unfold the lower half
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+// The position of the pixel at texCoords with the depth buffer's depth, in whatever space inverseProjection maps clip
+// space to: the inverse of projection gives view space, the inverse of projection * view world space.
+vec3 reconstructPosition(vec2 texCoords, float depth, mat4 inverseProjection)
+{
+    vec4 position = inverseProjection * vec4(vec3(texCoords, depth) * 2.0 - 1.0, 1.0);
+    return position.xyz / position.w;
+}
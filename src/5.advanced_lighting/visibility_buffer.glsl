@@ -0,0 +1,34 @@
+// Visibility buffer texels and the interpolation of a triangle's attributes without the rasterizer, see
+// learnopengl/visibility_buffer.h. Included after the #version line.
+
+// the instance in the top bits and the triangle below them, all bits set where nothing was drawn
+const uint VISIBILITY_TRIANGLE_BITS = 24u;
+const uint VISIBILITY_EMPTY = 0xFFFFFFFFu;
+
+uint packVisibility(uint instance, uint triangle)
+{
+    return (instance << VISIBILITY_TRIANGLE_BITS) | triangle;
+}
+
+// false where nothing was drawn
+bool unpackVisibility(uint visibility, out uint instance, out uint triangle)
+{
+    instance = visibility >> VISIBILITY_TRIANGLE_BITS;
+    triangle = visibility & ((1u << VISIBILITY_TRIANGLE_BITS) - 1u);
+    return visibility != VISIBILITY_EMPTY;
+}
+
+// The corners' clip space positions (x, y, w) as the columns of a matrix take the weights of a point on the triangle
+// to that point in clip space, so its inverse takes a point (x, y, 1) in NDC to the weights of the triangle's point
+// seen there, up to their scale. Working in clip space, the weights are the perspective correct ones the rasterizer
+// interpolates with, even when a corner is behind the camera.
+mat3 barycentricSolver(vec4 clip0, vec4 clip1, vec4 clip2)
+{
+    return inverse(mat3(clip0.xyw, clip1.xyw, clip2.xyw));
+}
+
+vec3 barycentrics(mat3 solver, vec2 ndc)
+{
+    vec3 weights = solver * vec3(ndc, 1.0);
+    return weights / (weights.x + weights.y + weights.z);
+}
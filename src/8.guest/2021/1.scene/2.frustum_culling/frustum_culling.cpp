@@ -10,6 +10,8 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 #include <learnopengl/entity.h>
+#include <learnopengl/occlusion.h>
+#include <learnopengl/thread_pool.h>
 
 #ifndef ENTITY_H
 #define ENTITY_H
@@ -27,15 +29,27 @@ public:
 
 
 #include <iostream>
+#include <cstdint> //uintptr_t
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
+void benchmarkCullingKernels(const Frustum& frustum);
+void benchmarkBVH(const Frustum& frustum);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+const unsigned int ENTITY_GRID_SIZE = 100; // ENTITY_GRID_SIZE * ENTITY_GRID_SIZE children
+
+// culling
+enum CullingMode { CULL_LINEAR, CULL_BVH, CULL_BATCH, CULL_PARALLEL };
+int cullingMode = CULL_BVH;
+bool cullingModeKeyPressed = false;
+bool useOcclusion = true;
+bool useOcclusionKeyPressed = false;
+const unsigned int OCCLUDER_COUNT = 32; // nearest frustum-visible entities rasterized as occluders
 
 // camera
 Camera camera(glm::vec3(0.0f, 10.0f, 0.0f));
@@ -102,6 +116,8 @@ int main()
 	// load entities
 	// -----------
 	Model model(FileSystem::getPath("resources/objects/planet/planet.obj"));
+	// the BVH the entities get registered in below, declared first so it outlives them
+	DynamicBVH bvh;
 	Entity ourEntity(model);
 	ourEntity.transform.setLocalPosition({ 0, 0, 0 });
 	const float scale = 1.0;
@@ -110,20 +126,48 @@ int main()
 	{
 		Entity* lastEntity = &ourEntity;
 
-		for (unsigned int x = 0; x < 20; ++x)
+		for (unsigned int x = 0; x < ENTITY_GRID_SIZE; ++x)
 		{
-			for (unsigned int z = 0; z < 20; ++z)
+			for (unsigned int z = 0; z < ENTITY_GRID_SIZE; ++z)
 			{
 				ourEntity.addChild(model);
 				lastEntity = ourEntity.children.back().get();
 
 				//Set transform values
-				lastEntity->transform.setLocalPosition({ x * 10.f - 100.f,  0.f, z * 10.f - 100.f });
+				lastEntity->transform.setLocalPosition({ x * 10.f - ENTITY_GRID_SIZE * 5.f,  0.f, z * 10.f - ENTITY_GRID_SIZE * 5.f });
 			}
 		}
 	}
 	ourEntity.updateSelfAndChild();
 
+	// build the bounding volume hierarchy over the world space bounds of the scene graph
+	// -----------------------------------------------------------------------------------
+	ourEntity.addSelfAndChildToBVH(bvh);
+	std::cout << "BVH built with " << bvh.getProxyCount() << " entities, height " << bvh.getHeight() << " (press B to switch culling mode)" << std::endl;
+
+	// and the SoA copy of the same bounds for the SIMD batch culling kernels
+	BoundsSoA boundsSoA;
+	ourEntity.addSelfAndChildToBoundsSoA(boundsSoA);
+	std::vector<unsigned int> visibleIndices;
+	std::vector<Entity*> visibleEntities;
+	RenderQueue renderQueue;
+
+	// flat list of the scene for multithreaded recording: each worker culls a slice of it into its own command list
+	// -------------------------------------------------------------------------------------------------------------
+	std::vector<Entity*> allEntities;
+	ourEntity.collectSelfAndChild(allEntities);
+	ThreadPool threadPool;
+	std::vector<CommandList> commandLists(threadPool.getThreadCount());
+	std::vector<unsigned int> sliceDisplay(threadPool.getThreadCount());
+
+	// software occlusion buffer, fed with the boxes inscribed in the nearest planets (press O to toggle)
+	// -------------------------------------------------------------------------------------------------
+	OcclusionBuffer occlusionBuffer;
+	const float occluderScale = 1.f / std::sqrt(3.f);
+
+	benchmarkCullingKernels(createFrustumFromCamera(camera, (float)SCR_WIDTH / (float)SCR_HEIGHT, glm::radians(camera.Zoom), 0.1f, 100.0f));
+	benchmarkBVH(createFrustumFromCamera(camera, (float)SCR_WIDTH / (float)SCR_HEIGHT, glm::radians(camera.Zoom), 0.1f, 100.0f));
+
 	// draw in wireframe
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -162,10 +206,93 @@ int main()
 		ourShader.setMat4("projection", projection);
 		ourShader.setMat4("view", view);
 
-		// draw our scene graph
-		unsigned int total = 0, display = 0;
-		ourEntity.drawSelfAndChild(camFrustum, ourShader, display, total);
-		std::cout << "Total process in CPU : " << total << " / Total send to GPU : " << display << std::endl;
+		if (cullingMode == CULL_PARALLEL)
+		{
+			// record on every core, then replay on the GL thread
+			const double recordStart = glfwGetTime();
+			// reset every list here, the pool doesn't run the job for a slice with no entities and its list would
+			// otherwise replay an older frame; each list is replayed on its own so it starts with the shader
+			for (unsigned int slice = 0; slice < threadPool.getThreadCount(); ++slice)
+			{
+				commandLists[slice].reset();
+				commandLists[slice].useShader(ourShader);
+				sliceDisplay[slice] = 0;
+			}
+			threadPool.parallelFor((unsigned int)allEntities.size(), [&](unsigned int begin, unsigned int end, unsigned int slice)
+				{
+					sliceDisplay[slice] = recordVisibleEntities(allEntities.data(), begin, end, camFrustum, commandLists[slice]);
+				});
+			const double recordMs = (glfwGetTime() - recordStart) * 1000.0;
+
+			unsigned int display = 0, commandCount = 0;
+			for (unsigned int slice = 0; slice < threadPool.getThreadCount(); ++slice)
+			{
+				commandLists[slice].execute();
+				display += sliceDisplay[slice];
+				commandCount += commandLists[slice].getCommandCount();
+			}
+			std::cout << "Recorded " << commandCount << " commands on " << threadPool.getThreadCount() << " threads in " << recordMs
+				<< " ms / Total send to GPU : " << display << std::endl;
+		}
+		else
+		{
+			// cull our scene graph into the render queue
+			renderQueue.begin(camera.Position, camera.Front, 100.0f);
+			if (cullingMode == CULL_LINEAR)
+			{
+				unsigned int total = 0, display = 0;
+				ourEntity.submitSelfAndChild(camFrustum, renderQueue, ourShader, display, total);
+				std::cout << "Total process in CPU : " << total << " / Total send to GPU : " << display;
+			}
+			else
+			{
+				visibleEntities.clear();
+				if (cullingMode == CULL_BVH)
+				{
+					BVHStats stats;
+					gatherVisibleFromBVH(bvh, camFrustum, visibleEntities, stats);
+					std::cout << "BVH nodes tested in CPU : " << stats.tested << " / In frustum : " << stats.visible;
+				}
+				else
+				{
+					gatherVisibleFromBoundsSoA(boundsSoA, camFrustum, visibleEntities, visibleIndices);
+					std::cout << "Batch tested in CPU : " << boundsSoA.count << " / In frustum : " << visibleEntities.size();
+				}
+
+				if (useOcclusion)
+				{
+					// the planet mesh is a sphere, so the box inscribed in its bounds is a conservative occluder
+					const unsigned int occluderCount = std::min(OCCLUDER_COUNT, (unsigned int)visibleEntities.size());
+					std::partial_sort(visibleEntities.begin(), visibleEntities.begin() + occluderCount, visibleEntities.end(), [](const Entity* a, const Entity* b)
+						{
+							return glm::length(a->worldAABB.center - camera.Position) < glm::length(b->worldAABB.center - camera.Position);
+						});
+
+					occlusionBuffer.beginFrame(projection * view);
+					for (unsigned int i = 0; i < occluderCount; ++i)
+					{
+						const AABB& localAABB = *visibleEntities[i]->boundingVolume;
+						const glm::vec3 occluderExtents = localAABB.extents * occluderScale;
+						occlusionBuffer.addOccluderBox(visibleEntities[i]->transform.getModelMatrix(), localAABB.center - occluderExtents, localAABB.center + occluderExtents);
+					}
+					occlusionBuffer.rasterize(threadPool);
+
+					visibleEntities.erase(std::remove_if(visibleEntities.begin() + occluderCount, visibleEntities.end(), [&occlusionBuffer](const Entity* entity)
+						{
+							return !occlusionBuffer.isVisible(entity->worldAABB.center - entity->worldAABB.extents, entity->worldAABB.center + entity->worldAABB.extents);
+						}), visibleEntities.end());
+				}
+
+				submitEntities(visibleEntities, renderQueue, ourShader);
+				std::cout << " / Total send to GPU : " << visibleEntities.size();
+			}
+
+			// then sort it by state and depth and submit it
+			RenderQueueStats queueStats;
+			renderQueue.sort();
+			renderQueue.flush(queueStats);
+			std::cout << " / Draws : " << queueStats.draws << " / State changes saved : " << queueStats.stateChangesSaved() << std::endl;
+		}
 
 		//ourEntity.transform.setLocalRotation({ 0.f, ourEntity.transform.getLocalRotation().y + 20 * deltaTime, 0.f });
 		ourEntity.updateSelfAndChild();
@@ -197,6 +324,142 @@ void processInput(GLFWwindow* window)
 		camera.ProcessKeyboard(LEFT, deltaTime);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		camera.ProcessKeyboard(RIGHT, deltaTime);
+
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS && !cullingModeKeyPressed)
+	{
+		cullingMode = (cullingMode + 1) % 4;
+		cullingModeKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE)
+	{
+		cullingModeKeyPressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS && !useOcclusionKeyPressed)
+	{
+		useOcclusion = !useOcclusion;
+		useOcclusionKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_O) == GLFW_RELEASE)
+	{
+		useOcclusionKeyPressed = false;
+	}
+}
+
+// checks the SIMD batch culling kernels against the scalar one, then measures their throughput on a large random set
+// of boxes (single thread)
+// ------------------------------------------------------------------------------------------------------------------
+void benchmarkCullingKernels(const Frustum& frustum)
+{
+	const unsigned int boxCount = 1000000;
+	const unsigned int iterations = 20;
+
+	BoundsSoA bounds;
+	srand(42);
+	for (unsigned int i = 0; i < boxCount; ++i)
+	{
+		const glm::vec3 center((rand() % 2000) * 0.1f - 100.f, (rand() % 200) * 0.1f - 10.f, (rand() % 2000) * 0.1f - 100.f);
+		const glm::vec3 extents(0.5f + (rand() % 100) * 0.01f);
+		bounds.add(center, extents, nullptr);
+	}
+	std::vector<unsigned int> visible(bounds.count + 8);
+	std::vector<unsigned int> reference(bounds.count + 8);
+	const unsigned int referenceCount = cullBoundsScalar(frustum, bounds, reference.data());
+
+	auto run = [&](const char* name, unsigned int (*kernel)(const Frustum&, const BoundsSoA&, unsigned int*))
+	{
+		//the compacted list must match the scalar one index for index
+		unsigned int visibleCount = kernel(frustum, bounds, visible.data());
+		unsigned int mismatches = visibleCount > referenceCount ? visibleCount - referenceCount : referenceCount - visibleCount;
+		for (unsigned int i = 0; i < std::min(visibleCount, referenceCount); ++i)
+			mismatches += visible[i] != reference[i];
+		if (mismatches)
+			std::cout << "ERROR::CULLING:: " << name << " differs from the scalar kernel at " << mismatches << " of " << referenceCount << " visible indices" << std::endl;
+
+		const double start = glfwGetTime();
+		for (unsigned int i = 0; i < iterations; ++i)
+			visibleCount = kernel(frustum, bounds, visible.data());
+		const double ms = (glfwGetTime() - start) * 1000.0;
+		std::cout << name << " : " << visibleCount << " visible, " << (boxCount * (double)iterations) / ms << " boxes/ms/core" << std::endl;
+	};
+
+	run("Scalar culling", cullBoundsScalar);
+#ifdef BATCH_CULLING_SSE
+	run("SSE culling   ", cullBoundsSSE);
+#endif
+#ifdef BATCH_CULLING_AVX
+	run("AVX culling   ", cullBoundsAVX);
+#endif
+}
+
+// measures the BVH at a scale the demo scene doesn't reach: inserting, refitting and querying a large random set of
+// boxes, against testing every box (single thread)
+// ------------------------------------------------------------------------------------------------------------------
+void benchmarkBVH(const Frustum& frustum)
+{
+	const unsigned int leafCount = 200000;
+	const unsigned int iterations = 20;
+
+	std::vector<glm::vec3> centers(leafCount), extents(leafCount);
+	srand(7);
+	for (unsigned int i = 0; i < leafCount; ++i)
+	{
+		centers[i] = glm::vec3((rand() % 4000) * 0.1f - 200.f, (rand() % 200) * 0.1f - 10.f, (rand() % 4000) * 0.1f - 200.f);
+		extents[i] = glm::vec3(0.5f + (rand() % 100) * 0.01f);
+	}
+
+	//the leaves hand back their index through userData
+	DynamicBVH bvh;
+	std::vector<int> proxies(leafCount);
+	double start = glfwGetTime();
+	for (unsigned int i = 0; i < leafCount; ++i)
+		proxies[i] = bvh.createProxy(centers[i] - extents[i], centers[i] + extents[i], reinterpret_cast<void*>(static_cast<uintptr_t>(i)));
+	const double insertMs = (glfwGetTime() - start) * 1000.0;
+
+	//move every box a little, the ones leaving their fat box are re-inserted
+	unsigned int reinserted = 0;
+	start = glfwGetTime();
+	for (unsigned int i = 0; i < leafCount; ++i)
+	{
+		centers[i] += glm::vec3((rand() % 200) * 0.01f - 1.f, 0.f, (rand() % 200) * 0.01f - 1.f);
+		reinserted += bvh.moveProxy(proxies[i], centers[i] - extents[i], centers[i] + extents[i]);
+	}
+	const double refitMs = (glfwGetTime() - start) * 1000.0;
+
+	std::vector<unsigned char> reported(leafCount);
+	BVHStats stats;
+	start = glfwGetTime();
+	for (unsigned int i = 0; i < iterations; ++i)
+	{
+		stats = BVHStats();
+		bvh.queryFrustum(frustum, [&reported](void* userData)
+		{
+			reported[reinterpret_cast<uintptr_t>(userData)] = 1;
+		}, stats);
+	}
+	const double queryMs = (glfwGetTime() - start) * 1000.0 / iterations;
+
+	BoundsSoA bounds;
+	for (unsigned int i = 0; i < leafCount; ++i)
+		bounds.add(centers[i], extents[i], nullptr);
+	std::vector<unsigned int> visible(bounds.count + 8);
+	unsigned int visibleCount = 0;
+	start = glfwGetTime();
+	for (unsigned int i = 0; i < iterations; ++i)
+		visibleCount = cullBoundsScalar(frustum, bounds, visible.data());
+	const double linearMs = (glfwGetTime() - start) * 1000.0 / iterations;
+
+	//the BVH tests fat boxes so it may report more, but every box the linear pass sees must be reported
+	unsigned int missing = 0;
+	for (unsigned int i = 0; i < visibleCount; ++i)
+		missing += !reported[visible[i]];
+	if (missing)
+		std::cout << "ERROR::BVH:: " << missing << " of " << visibleCount << " visible boxes missing from the BVH query" << std::endl;
+
+	std::cout << "BVH " << leafCount << " leaves, height " << bvh.getHeight() << " : insert " << insertMs << " ms, refit " << refitMs
+		<< " ms (" << reinserted << " re-inserted)" << std::endl;
+	std::cout << "BVH query    : " << stats.tested << " nodes tested, " << stats.visible << " visible, " << queryMs << " ms" << std::endl;
+	std::cout << "Linear query : " << leafCount << " boxes tested, " << visibleCount << " visible, " << linearMs << " ms" << std::endl;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
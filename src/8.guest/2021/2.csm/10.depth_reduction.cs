@@ -0,0 +1,48 @@
+#version 430 core
+
+layout (local_size_x = 16, local_size_y = 16, local_size_z = 1) in;
+
+// the camera's depth buffer of the frame
+uniform sampler2D depthTexture;
+
+// nearest and farthest depth covered by geometry, as the bits of the positive floats (which order like the floats)
+// so they can be reduced with integer atomics; reset to (0xFFFFFFFF, 0) before the dispatch
+layout (std430, binding = 0) buffer DepthRange
+{
+    uint minDepth;
+    uint maxDepth;
+};
+
+shared uint groupMin;
+shared uint groupMax;
+
+void main()
+{
+    if (gl_LocalInvocationIndex == 0)
+    {
+        groupMin = 0xFFFFFFFFu;
+        groupMax = 0u;
+    }
+    barrier();
+
+    ivec2 size = textureSize(depthTexture, 0);
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (texel.x < size.x && texel.y < size.y)
+    {
+        float depth = texelFetch(depthTexture, texel, 0).r;
+        // the cleared background holds no receivers
+        if (depth < 1.0)
+        {
+            atomicMin(groupMin, floatBitsToUint(depth));
+            atomicMax(groupMax, floatBitsToUint(depth));
+        }
+    }
+    barrier();
+
+    // a single global atomic per group
+    if (gl_LocalInvocationIndex == 0 && groupMin <= groupMax)
+    {
+        atomicMin(minDepth, groupMin);
+        atomicMax(maxDepth, groupMax);
+    }
+}
@@ -0,0 +1,24 @@
+#version 410 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2DArray image;
+uniform float layer;
+uniform vec2 direction; // a texel along the blurred axis
+uniform int radius;
+
+void main()
+{
+    // one axis of a gaussian of radius texels, which moment maps can take unlike depth maps
+    float sigma = max(float(radius) * 0.5, 0.5);
+    vec4 result = vec4(0.0);
+    float weights = 0.0;
+    for (int i = -radius; i <= radius; ++i)
+    {
+        float weight = exp(-float(i * i) / (2.0 * sigma * sigma));
+        result += weight * textureLod(image, vec3(TexCoords + direction * float(i), layer), 0.0);
+        weights += weight;
+    }
+    FragColor = result / weights;
+}
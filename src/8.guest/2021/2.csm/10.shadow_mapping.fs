@@ -9,6 +9,8 @@ in VS_OUT {
 
 uniform sampler2D diffuseTexture;
 uniform sampler2DArray shadowMap;
+uniform sampler2DArray momentMap;
+uniform bool evsm;
 
 uniform vec3 lightDir;
 uniform vec3 viewPos;
@@ -23,8 +25,43 @@ layout (std140) uniform LightSpaceMatrices
 uniform float cascadePlaneDistances[16];
 uniform int cascadeCount;   // number of frusta - 1
 
+// must match EVSM_POSITIVE_EXPONENT and EVSM_NEGATIVE_EXPONENT in moment_shadows.h
+const float positiveExponent = 40.0;
+const float negativeExponent = 5.0;
+const float lightBleedingReduction = 0.2;
+
+// upper bound of the fraction of the filter region closer to the light than mean, from its first two moments
+float Chebyshev(vec2 moments, float mean, float minVariance)
+{
+    if (mean <= moments.x)
+        return 1.0;
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = mean - moments.x;
+    float pMax = variance / (variance + d * d);
+    // cut off the tail that lets light bleed through where casters overlap
+    return clamp((pMax - lightBleedingReduction) / (1.0 - lightBleedingReduction), 0.0, 1.0);
+}
+
+// shadow from the blurred, mipmapped exponential moments, a single trilinear fetch
+float EVSMShadow(vec3 projCoords, vec2 dx, vec2 dy, int layer)
+{
+    vec4 moments = textureGrad(momentMap, vec3(projCoords.xy, layer), dx, dy);
+    float warped = clamp(projCoords.z, 0.0, 1.0) * 2.0 - 1.0;
+    float positive = exp(positiveExponent * warped);
+    float negative = -exp(-negativeExponent * warped);
+    float positiveScale = 0.0005 * positiveExponent * positive;
+    float negativeScale = 0.0005 * negativeExponent * negative;
+    float lit = min(Chebyshev(moments.xy, positive, positiveScale * positiveScale),
+                    Chebyshev(moments.zw, negative, negativeScale * negativeScale));
+    return 1.0 - lit;
+}
+
 float ShadowCalculation(vec3 fragPosWorldSpace)
 {
+    // screen derivatives taken before the cascade is selected, so they stay within the cascade at its borders
+    vec3 fragPosDx = dFdx(fragPosWorldSpace);
+    vec3 fragPosDy = dFdy(fragPosWorldSpace);
+
     // select cascade layer
     vec4 fragPosViewSpace = view * vec4(fragPosWorldSpace, 1.0);
     float depthValue = abs(fragPosViewSpace.z);
@@ -57,6 +94,13 @@ float ShadowCalculation(vec3 fragPosWorldSpace)
     {
         return 0.0;
     }
+    if (evsm)
+    {
+        // the projections are orthographic, their derivatives a linear map of the world space ones
+        vec2 dx = (mat3(lightSpaceMatrices[layer]) * fragPosDx).xy * 0.5;
+        vec2 dy = (mat3(lightSpaceMatrices[layer]) * fragPosDy).xy * 0.5;
+        return EVSMShadow(projCoords, dx, dy, layer);
+    }
     // calculate bias (based on depth map resolution and slope)
     vec3 normal = normalize(fs_in.Normal);
     float bias = max(0.05 * (1.0 - dot(normal, lightDir)), 0.005);
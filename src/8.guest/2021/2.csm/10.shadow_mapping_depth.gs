@@ -1,22 +1,17 @@
 #version 410 core
 
-layout(triangles, invocations = 5) in;
+// only used when the vertex shader cannot write gl_Layer itself, passes the triangle on to its instance's layer
+layout(triangles) in;
 layout(triangle_strip, max_vertices = 3) out;
 
-layout (std140) uniform LightSpaceMatrices
-{
-    mat4 lightSpaceMatrices[16];
-};
-/*
-uniform mat4 lightSpaceMatrices[16];
-*/
+flat in int Layer[];
 
 void main()
 {          
 	for (int i = 0; i < 3; ++i)
 	{
-		gl_Position = lightSpaceMatrices[gl_InvocationID] * gl_in[i].gl_Position;
-		gl_Layer = gl_InvocationID;
+		gl_Position = gl_in[i].gl_Position;
+		gl_Layer = Layer[0];
 		EmitVertex();
 	}
 	EndPrimitive();
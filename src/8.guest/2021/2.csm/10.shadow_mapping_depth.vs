@@ -1,9 +1,24 @@
 #version 410 core
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
 layout (location = 0) in vec3 aPos;
 
+layout (std140) uniform LightSpaceMatrices
+{
+    mat4 lightSpaceMatrices[16];
+};
+
 uniform mat4 model;
+// the cascades the caster touches, an instance per cascade
+uniform int cascadeLayers[16];
+
+flat out int Layer;
 
 void main()
 {
-    gl_Position = model * vec4(aPos, 1.0);
+    Layer = cascadeLayers[gl_InstanceID];
+    gl_Position = lightSpaceMatrices[Layer] * model * vec4(aPos, 1.0);
+#if defined(GL_ARB_shader_viewport_layer_array) || defined(GL_AMD_vertex_shader_layer)
+    gl_Layer = Layer;
+#endif
 }
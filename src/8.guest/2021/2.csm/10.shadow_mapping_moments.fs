@@ -0,0 +1,15 @@
+#version 410 core
+layout (location = 0) out vec4 FragColor;
+
+// must match EVSM_POSITIVE_EXPONENT and EVSM_NEGATIVE_EXPONENT in moment_shadows.h
+const float positiveExponent = 40.0;
+const float negativeExponent = 5.0;
+
+void main()
+{
+    // casters pancaked onto the near plane by depth clamping end up at 0
+    float warped = clamp(gl_FragCoord.z, 0.0, 1.0) * 2.0 - 1.0;
+    float positive = exp(positiveExponent * warped);
+    float negative = -exp(-negativeExponent * warped);
+    FragColor = vec4(positive, positive * positive, negative, negative * negative);
+}
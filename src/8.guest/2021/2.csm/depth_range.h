@@ -0,0 +1,106 @@
+#ifndef DEPTH_RANGE_H
+#define DEPTH_RANGE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader_c.h>
+
+#include <cstring>
+
+// readback buffers in flight, the results being read up to this many frames late
+#define DEPTH_RANGE_READBACKS 3
+
+// Min/max reduction of a depth buffer in a compute pass (10.depth_reduction.cs). Every frame's result is copied into
+// the next buffer of a ring of readback buffers behind a fence, and read once the fence signaled, usually a frame or
+// two later, so the CPU never waits on the GPU for it.
+class DepthRangeReduction
+{
+public:
+    DepthRangeReduction(const char* computePath)
+        : shader(computePath)
+    {
+        glGenBuffers(1, &SSBO);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        glGenBuffers(DEPTH_RANGE_READBACKS, readbacks);
+        for (unsigned int i = 0; i < DEPTH_RANGE_READBACKS; ++i)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, readbacks[i]);
+            glBufferData(GL_COPY_WRITE_BUFFER, 2 * sizeof(unsigned int), NULL, GL_STREAM_READ);
+            fences[i] = 0;
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // reduce the width x height depth texture; uses texture unit 0
+    void Dispatch(unsigned int depthTexture, int width, int height)
+    {
+        const unsigned int reset[2] = { 0xFFFFFFFFu, 0u };
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(reset), reset);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        shader.use();
+        shader.setInt("depthTexture", 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, depthTexture);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, SSBO);
+        glDispatchCompute((width + 15) / 16, (height + 15) / 16, 1);
+        // the copy below reads what the atomics wrote
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        // a result still in the ring this late was never read, drop it
+        const unsigned int slot = frame % DEPTH_RANGE_READBACKS;
+        if (fences[slot] != 0)
+            glDeleteSync(fences[slot]);
+        glBindBuffer(GL_COPY_READ_BUFFER, SSBO);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readbacks[slot]);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, 2 * sizeof(unsigned int));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        frame++;
+    }
+
+    // The depth range of the newest reduction the GPU finished, without waiting for any. False when none finished
+    // since the last call, or the depth buffer held no geometry. latency is how many frames ago it was dispatched.
+    bool Read(float& minDepth, float& maxDepth, unsigned int& latency)
+    {
+        bool found = false;
+        // oldest first, a newer finished result overrides it
+        for (unsigned int age = DEPTH_RANGE_READBACKS; age > 0; --age)
+        {
+            if (frame < age)
+                continue;
+            const unsigned int slot = (frame - age) % DEPTH_RANGE_READBACKS;
+            if (fences[slot] == 0)
+                continue;
+            const GLenum status = glClientWaitSync(fences[slot], 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break; // the newer ones are not done either
+            glDeleteSync(fences[slot]);
+            fences[slot] = 0;
+
+            unsigned int bits[2];
+            glBindBuffer(GL_COPY_READ_BUFFER, readbacks[slot]);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(bits), bits);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            if (bits[0] > bits[1])
+                continue; // nothing was rendered
+            std::memcpy(&minDepth, &bits[0], sizeof(float));
+            std::memcpy(&maxDepth, &bits[1], sizeof(float));
+            latency = age;
+            found = true;
+        }
+        return found;
+    }
+
+private:
+    ComputeShader shader;
+    unsigned int SSBO;
+    unsigned int readbacks[DEPTH_RANGE_READBACKS];
+    GLsync fences[DEPTH_RANGE_READBACKS];
+    unsigned int frame = 0;
+};
+#endif
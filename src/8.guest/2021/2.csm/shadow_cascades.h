@@ -0,0 +1,186 @@
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// Light space projection of one cascade. The slice of the camera frustum is enclosed in a sphere, whose radius only
+// depends on the slice's shape, so turning the camera does not resize the projection, and its center is snapped to
+// whole shadow map texels in light space, so moving the camera shifts the projection by whole texels. Together they
+// keep static geometry from shimmering.
+struct ShadowCascadeFit
+{
+    glm::mat4 lightSpaceMatrix = glm::mat4(1.0f);
+    glm::vec3 sliceCenter = glm::vec3(0.0f); // light view space, not snapped
+    float sliceRadius = 0.0f;
+    glm::vec3 center = glm::vec3(0.0f);      // light view space, snapped
+    float radius = 0.0f;                     // sliceRadius plus the guard band and a texel
+};
+
+// rotation of the directional light's view, lightDir pointing towards the light
+glm::mat4 getLightRotation(const glm::vec3& lightDir)
+{
+    const glm::vec3 up = std::abs(lightDir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    return glm::lookAt(glm::vec3(0.0f), -lightDir, up);
+}
+
+// corners of the slice in world space, guardBand the fraction the fit is grown by
+ShadowCascadeFit fitShadowCascade(const std::vector<glm::vec4>& corners, const glm::mat4& lightRotation, unsigned int resolution, float guardBand)
+{
+    glm::vec3 center = glm::vec3(0.0f);
+    for (const auto& v : corners)
+    {
+        center += glm::vec3(v);
+    }
+    center /= corners.size();
+
+    float radius = 0.0f;
+    for (const auto& v : corners)
+    {
+        radius = std::max(radius, glm::distance(glm::vec3(v), center));
+    }
+    // the radius is rotation invariant up to rounding, round it up so it stays the exact same
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    ShadowCascadeFit fit;
+    fit.sliceCenter = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+    fit.sliceRadius = radius;
+    // a texel more on each side, what snapping the center can shift the slice by
+    const float texelSize = 2.0f * radius * (1.0f + guardBand) / (resolution - 2);
+    fit.radius = texelSize * resolution / 2.0f;
+    fit.center = glm::floor(fit.sliceCenter / texelSize) * texelSize;
+
+    // the depth range only spans the slice, casters between it and the light are pancaked onto the near plane by
+    // rendering with depth clamping
+    const glm::mat4 lightProjection = glm::ortho(fit.center.x - fit.radius, fit.center.x + fit.radius, fit.center.y - fit.radius, fit.center.y + fit.radius,
+                                                 -(fit.center.z + fit.radius), -(fit.center.z - fit.radius));
+    fit.lightSpaceMatrix = lightProjection * lightRotation;
+    return fit;
+}
+
+// A cascade's layer of the shadow map and the schedule it is refreshed on: when frame % period == phase. Out of turn
+// the layer is kept as long as what it holds still covers the cascade's slice and the casters did not change.
+struct ShadowCascade
+{
+    float nearPlane = 0.0f;
+    float farPlane = 0.0f;
+    unsigned int period = 1;
+    unsigned int phase = 0;
+    float guardBand = 0.0f;
+
+    // what the layer was last rendered with
+    bool valid = false;
+    ShadowCascadeFit rendered;
+    unsigned int casterVersion = 0;
+};
+
+// whether a layer rendered with fit still holds all of the slice of current
+bool cascadeCovers(const ShadowCascadeFit& fit, const ShadowCascadeFit& current)
+{
+    const glm::vec3 offset = glm::abs(current.sliceCenter - fit.center);
+    return std::max(std::max(offset.x, offset.y), offset.z) + current.sliceRadius <= fit.radius;
+}
+
+// Pick the cascades to render this frame, a bit per cascade, and take their new fits. A cascade is rendered when its
+// layer is invalid, its casters changed or its slice outgrew it, and on its turn when its snapped projection moved.
+unsigned int scheduleShadowCascades(std::vector<ShadowCascade>& cascades, const std::vector<ShadowCascadeFit>& fits, unsigned int frame, unsigned int casterVersion)
+{
+    unsigned int mask = 0;
+    for (size_t i = 0; i < cascades.size(); ++i)
+    {
+        ShadowCascade& cascade = cascades[i];
+        const bool due = frame % cascade.period == cascade.phase;
+        const bool stale = !cascade.valid || cascade.casterVersion != casterVersion || !cascadeCovers(cascade.rendered, fits[i]);
+        if (stale || (due && fits[i].lightSpaceMatrix != cascade.rendered.lightSpaceMatrix))
+        {
+            cascade.valid = true;
+            cascade.rendered = fits[i];
+            cascade.casterVersion = casterVersion;
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+
+// view distance of a depth buffer value written with a perspective projection of the given planes
+float linearizeDepth(float depth, float nearPlane, float farPlane)
+{
+    const float ndc = depth * 2.0f - 1.0f;
+    return 2.0f * nearPlane * farPlane / (farPlane + nearPlane - ndc * (farPlane - nearPlane));
+}
+
+// Take the view distance range [visibleNear, visibleFar] the visible geometry spans into [nearDistance, farDistance],
+// snapped outwards to steps per octave and clamped to [minimum, maximum]. The cascades are fit to this range, so it
+// only moves when the geometry left it or it became more than a step too wide: within that the slices keep their
+// exact shape and stay stable, like the fit does with a fixed range.
+void updateDepthRange(float& nearDistance, float& farDistance, float visibleNear, float visibleFar, float minimum, float maximum, float steps)
+{
+    const float snappedNear = std::max(minimum, std::exp2(std::floor(std::log2(std::max(visibleNear, minimum)) * steps) / steps));
+    const float snappedFar = std::min(maximum, std::exp2(std::ceil(std::log2(std::max(visibleFar, minimum)) * steps) / steps));
+    const float step = std::exp2(1.0f / steps);
+    const bool covers = nearDistance <= visibleNear && farDistance >= visibleFar;
+    const bool tooWide = nearDistance * step < snappedNear || farDistance > snappedFar * step;
+    if (!covers || tooWide)
+    {
+        nearDistance = snappedNear;
+        farDistance = std::max(snappedFar, snappedNear * step);
+    }
+}
+
+// The count - 1 distances splitting [nearDistance, farDistance] into count cascades with the practical split scheme,
+// lambda blending logarithmic splits (an even shadow texel to pixel ratio) with uniform ones.
+std::vector<float> practicalCascadeSplits(float nearDistance, float farDistance, unsigned int count, float lambda)
+{
+    std::vector<float> splits;
+    for (unsigned int i = 1; i < count; ++i)
+    {
+        const float fraction = float(i) / count;
+        const float logarithmic = nearDistance * std::pow(farDistance / nearDistance, fraction);
+        const float uniform = nearDistance + (farDistance - nearDistance) * fraction;
+        splits.push_back(lambda * logarithmic + (1.0f - lambda) * uniform);
+    }
+    return splits;
+}
+
+// world space bounds of a shadow caster
+struct ShadowCasterBounds
+{
+    glm::vec3 minimum = glm::vec3(0.0f);
+    glm::vec3 maximum = glm::vec3(0.0f);
+};
+
+// the bounds of the box [minimum, maximum] transformed by model
+ShadowCasterBounds transformCasterBounds(const glm::mat4& model, const glm::vec3& minimum, const glm::vec3& maximum)
+{
+    const glm::vec3 center = glm::vec3(model * glm::vec4((minimum + maximum) * 0.5f, 1.0f));
+    const glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(model[0])), glm::abs(glm::vec3(model[1])), glm::abs(glm::vec3(model[2])));
+    const glm::vec3 extents = absolute * ((maximum - minimum) * 0.5f);
+    return { center - extents, center + extents };
+}
+
+// Write the layers of mask the caster has to be rendered into to layers and return how many there are: the cascades
+// whose light space box it overlaps. Casters only need to reach the far side of a box, the ones between it and the
+// light are pancaked onto its near plane.
+unsigned int cullShadowCaster(const ShadowCasterBounds& bounds, const glm::mat4& lightRotation, const std::vector<ShadowCascade>& cascades, unsigned int mask, int* layers)
+{
+    const glm::vec3 center = glm::vec3(lightRotation * glm::vec4((bounds.minimum + bounds.maximum) * 0.5f, 1.0f));
+    const glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(lightRotation[0])), glm::abs(glm::vec3(lightRotation[1])), glm::abs(glm::vec3(lightRotation[2])));
+    const glm::vec3 extents = absolute * ((bounds.maximum - bounds.minimum) * 0.5f);
+
+    unsigned int count = 0;
+    for (size_t i = 0; i < cascades.size(); ++i)
+    {
+        if ((mask & (1u << i)) == 0)
+            continue;
+        const ShadowCascadeFit& fit = cascades[i].rendered;
+        const glm::vec3 offset = glm::abs(center - fit.center);
+        if (offset.x <= extents.x + fit.radius && offset.y <= extents.y + fit.radius && center.z + extents.z >= fit.center.z - fit.radius)
+            layers[count++] = (int)i;
+    }
+    return count;
+}
+#endif
@@ -8,11 +8,18 @@
 
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_c.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/moment_shadows.h>
+#include <learnopengl/depth_stream.h>
+
+#include "shadow_cascades.h"
+#include "depth_range.h"
 
 #include <iostream>
 #include <random>
+#include <cstring>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
@@ -20,8 +27,13 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
 unsigned int loadTexture(const char *path);
 void renderScene(const Shader &shader);
-void renderCube();
+unsigned int renderShadowCasters(const Shader &shader, unsigned int cascadeMask, unsigned int* allTriangles, unsigned int* culledTriangles);
+void renderCube(int instances = 1, bool depthOnly = false);
+bool hasExtension(const char* name);
 void renderQuad();
+void updateCascadeSplits();
+void createSceneFramebuffer(int width, int height);
+std::vector<ShadowCascadeFit> getShadowCascadeFits();
 std::vector<glm::mat4> getLightSpaceMatrices();
 std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& projview);
 void drawCascadeVolumeVisualizers(const std::vector<glm::mat4>& lightMatrices, Shader* shader);
@@ -46,11 +58,13 @@ float cameraFarPlane = 500.0f;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-std::vector<float> shadowCascadeLevels{ cameraFarPlane / 50.0f, cameraFarPlane / 25.0f, cameraFarPlane / 10.0f, cameraFarPlane / 2.0f };
+const std::vector<float> fixedCascadeLevels{ cameraFarPlane / 50.0f, cameraFarPlane / 25.0f, cameraFarPlane / 10.0f, cameraFarPlane / 2.0f };
+std::vector<float> shadowCascadeLevels = fixedCascadeLevels;
 int debugLayer = 0;
 
 // meshes
 unsigned int planeVAO;
+DepthStream planeDepthStream; // positions only, for the shadow pass
 
 // lighting info
 // -------------
@@ -59,6 +73,39 @@ unsigned int lightFBO;
 unsigned int lightDepthMaps;
 constexpr unsigned int depthMapResolution = 4096;
 
+// exponential variance shadow maps instead of PCF over depth (V key): filtered once when rendered, which allows a far
+// smaller map and lets the lighting pass take a single fetch
+bool useEVSM = false;
+unsigned int momentFBO;
+unsigned int momentMaps;
+unsigned int momentDepthMaps;
+constexpr unsigned int momentMapResolution = 1024;
+constexpr int momentBlurRadius = 2;
+
+// near cascades follow the camera every frame, the far ones are refreshed on a staggered period (at most one of them a
+// frame) and fit with a guard band so their previous contents keep covering the slice in between
+std::vector<ShadowCascade> shadowCascades;
+const unsigned int cascadePeriods[] = { 1, 1, 2, 4, 4 };
+const unsigned int cascadePhases[] = { 0, 0, 0, 1, 3 };
+const float cascadeGuardBands[] = { 0.0f, 0.0f, 0.05f, 0.1f, 0.1f };
+unsigned int casterVersion = 0; // bumped whenever a shadow caster moves
+
+// sample distribution shadow maps (T key): the cascades split the depth range the visible geometry spans, found by a
+// reduction of the depth buffer read back a frame or two late, instead of fixed fractions of the far plane
+bool useSDSM = true;
+const float cascadeSplitLambda = 0.8f;
+const float depthRangeSteps = 4.0f; // per octave
+float depthRangeNear = cameraNearPlane;
+float depthRangeFar = cameraFarPlane;
+unsigned int depthRangeLatency = 0;
+
+// the scene is rendered into its own framebuffer so the reduction can read its depth
+unsigned int sceneFBO = 0;
+unsigned int sceneColor = 0;
+unsigned int sceneDepth = 0;
+int sceneWidth = 0;
+int sceneHeight = 0;
+
 bool showQuad = false;
 
 std::random_device device;
@@ -66,6 +113,11 @@ std::mt19937 generator = std::mt19937(device());
 
 std::vector<glm::mat4> lightMatricesCache;
 
+std::vector<glm::mat4> modelMatrices;
+std::vector<ShadowCasterBounds> cubeBounds;
+const ShadowCasterBounds planeBounds = { glm::vec3(-25.0f, -2.0f, -25.0f), glm::vec3(25.0f, -2.0f, 25.0f) };
+void randomizeCubes();
+
 int main()
 {
     //generator.seed(2);
@@ -73,7 +125,7 @@ int main()
     // ------------------------------
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 #ifdef __APPLE__
@@ -113,8 +165,16 @@ int main()
     // build and compile shaders
     // -------------------------
     Shader shader("10.shadow_mapping.vs", "10.shadow_mapping.fs");
-    Shader simpleDepthShader("10.shadow_mapping_depth.vs", "10.shadow_mapping_depth.fs", "10.shadow_mapping_depth.gs");
+    // shadow casters are instanced once per cascade they touch, the vertex shader writing the instance's layer where
+    // supported and a pass-through geometry shader otherwise
+    const bool vertexShaderLayer = hasExtension("GL_ARB_shader_viewport_layer_array") || hasExtension("GL_AMD_vertex_shader_layer");
+    Shader simpleDepthShader = vertexShaderLayer ? Shader("10.shadow_mapping_depth.vs", "10.shadow_mapping_depth.fs")
+                                                 : Shader("10.shadow_mapping_depth.vs", "10.shadow_mapping_depth.fs", "10.shadow_mapping_depth.gs");
+    Shader momentShader = vertexShaderLayer ? Shader("10.shadow_mapping_depth.vs", "10.shadow_mapping_moments.fs")
+                                            : Shader("10.shadow_mapping_depth.vs", "10.shadow_mapping_moments.fs", "10.shadow_mapping_depth.gs");
+    Shader blurShader("10.shadow_blur.vs", "10.shadow_blur.fs");
     Shader debugDepthQuad("10.debug_quad.vs", "10.debug_quad_depth.fs");
+    DepthRangeReduction depthRange("10.depth_reduction.cs");
     Shader debugCascadeShader("10.debug_cascade.vs", "10.debug_cascade.fs");
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
@@ -142,6 +202,7 @@ int main()
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glBindVertexArray(0);
+    planeDepthStream = createDepthStream(planeVertices, 6, 8);
 
     // load textures
     // -------------
@@ -177,8 +238,64 @@ int main()
         throw 0;
     }
 
+    // a framebuffer per layer to clear the cascades that are re-rendered, the others keep their contents
+    std::vector<unsigned int> cascadeFBOs(shadowCascadeLevels.size() + 1);
+    glGenFramebuffers((GLsizei)cascadeFBOs.size(), cascadeFBOs.data());
+    for (size_t i = 0; i < cascadeFBOs.size(); ++i)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, cascadeFBOs[i]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, lightDepthMaps, 0, (GLint)i);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+
+    // configure moment FBO, the moments being rendered with a depth buffer of their own
+    // -----------------------------------------------------------------------------------
+    momentMaps = createMomentMapArray(momentMapResolution, int(shadowCascadeLevels.size()) + 1);
+    glGenTextures(1, &momentDepthMaps);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, momentDepthMaps);
+    glTexImage3D(
+        GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, momentMapResolution, momentMapResolution, int(shadowCascadeLevels.size()) + 1,
+        0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &momentFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, momentFBO);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, momentMaps, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, momentDepthMaps, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "ERROR::FRAMEBUFFER:: Moment framebuffer is not complete!";
+        throw 0;
+    }
+
+    std::vector<unsigned int> momentCascadeFBOs(shadowCascadeLevels.size() + 1);
+    glGenFramebuffers((GLsizei)momentCascadeFBOs.size(), momentCascadeFBOs.data());
+    for (size_t i = 0; i < momentCascadeFBOs.size(); ++i)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, momentCascadeFBOs[i]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, momentMaps, 0, (GLint)i);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, momentDepthMaps, 0, (GLint)i);
+    }
+    MomentShadowBlur momentBlur(momentMapResolution);
+    // empty cascades hold the moments of the far plane
+    const glm::vec4 clearMoments = evsmMoments(1.0f);
+
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+    for (size_t i = 0; i < shadowCascadeLevels.size() + 1; ++i)
+    {
+        ShadowCascade cascade;
+        cascade.nearPlane = i == 0 ? cameraNearPlane : shadowCascadeLevels[i - 1];
+        cascade.farPlane = i < shadowCascadeLevels.size() ? shadowCascadeLevels[i] : cameraFarPlane;
+        cascade.period = cascadePeriods[i];
+        cascade.phase = cascadePhases[i];
+        cascade.guardBand = cascadeGuardBands[i];
+        shadowCascades.push_back(cascade);
+    }
+    randomizeCubes();
+
     // configure UBO
     // --------------------
     unsigned int matricesUBO;
@@ -193,9 +310,22 @@ int main()
     shader.use();
     shader.setInt("diffuseTexture", 0);
     shader.setInt("shadowMap", 1);
+    shader.setInt("momentMap", 2);
     debugDepthQuad.use();
     debugDepthQuad.setInt("depthMap", 0);
 
+    // shadow and lighting pass GPU times, read back a frame late so they do not stall, and what was rendered, printed
+    // every second
+    unsigned int shadowQueries[2], lightingQueries[2], reductionQueries[2];
+    glGenQueries(2, shadowQueries);
+    glGenQueries(2, lightingQueries);
+    glGenQueries(2, reductionQueries);
+    unsigned int frame = 0;
+    unsigned int statFrames = 0, statCascades = 0, statDraws = 0;
+    unsigned int statAllTriangles[16] = {}, statCulledTriangles[16] = {};
+    double statGPUTime = 0.0, statLightingTime = 0.0, statReductionTime = 0.0;
+    double statTime = glfwGetTime();
+
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
@@ -220,28 +350,111 @@ int main()
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // 0. UBO setup
+        // 0. split the cascades over the latest depth range, pick the ones to re-render and UBO setup, the matrices being the ones each layer was rendered with
+        float minDepth, maxDepth;
+        if (depthRange.Read(minDepth, maxDepth, depthRangeLatency))
+            updateDepthRange(depthRangeNear, depthRangeFar, linearizeDepth(minDepth, cameraNearPlane, cameraFarPlane),
+                             linearizeDepth(maxDepth, cameraNearPlane, cameraFarPlane), cameraNearPlane, cameraFarPlane, depthRangeSteps);
+        updateCascadeSplits();
+        const unsigned int cascadeMask = scheduleShadowCascades(shadowCascades, getShadowCascadeFits(), frame, casterVersion);
         const auto lightMatrices = getLightSpaceMatrices();
         glBindBuffer(GL_UNIFORM_BUFFER, matricesUBO);
         for (size_t i = 0; i < lightMatrices.size(); ++i)
         {
-            glBufferSubData(GL_UNIFORM_BUFFER, i * sizeof(glm::mat4x4), sizeof(glm::mat4x4), &lightMatrices[i]);
+            if (cascadeMask & (1u << i))
+                glBufferSubData(GL_UNIFORM_BUFFER, i * sizeof(glm::mat4x4), sizeof(glm::mat4x4), &lightMatrices[i]);
         }
         glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
         // 1. render depth of scene to texture (from light's perspective)
         // --------------------------------------------------------------
         //lightProjection = glm::perspective(glm::radians(45.0f), (GLfloat)SHADOW_WIDTH / (GLfloat)SHADOW_HEIGHT, near_plane, far_plane); // note that if you use a perspective projection matrix you'll have to change the light position as the current light position isn't enough to reflect the whole scene
-        // render scene from light's point of view
-        simpleDepthShader.use();
-
-        glBindFramebuffer(GL_FRAMEBUFFER, lightFBO);
-        glViewport(0, 0, depthMapResolution, depthMapResolution);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        glCullFace(GL_FRONT);  // peter panning
-        renderScene(simpleDepthShader);
-        glCullFace(GL_BACK);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // render scene from light's point of view, into the scheduled layers only
+        glBeginQuery(GL_TIME_ELAPSED, shadowQueries[frame % 2]);
+        if (cascadeMask != 0 && !useEVSM)
+        {
+            glViewport(0, 0, depthMapResolution, depthMapResolution);
+            for (size_t i = 0; i < cascadeFBOs.size(); ++i)
+            {
+                if (cascadeMask & (1u << i))
+                {
+                    glBindFramebuffer(GL_FRAMEBUFFER, cascadeFBOs[i]);
+                    glClear(GL_DEPTH_BUFFER_BIT);
+                    statCascades++;
+                }
+            }
+
+            simpleDepthShader.use();
+            glBindFramebuffer(GL_FRAMEBUFFER, lightFBO);
+            glCullFace(GL_FRONT);  // peter panning
+            glEnable(GL_DEPTH_CLAMP); // pancaking
+            statDraws += renderShadowCasters(simpleDepthShader, cascadeMask, statAllTriangles, statCulledTriangles);
+            glDisable(GL_DEPTH_CLAMP);
+            glCullFace(GL_BACK);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        else if (cascadeMask != 0)
+        {
+            // the same casters as moments into the smaller moment maps
+            glViewport(0, 0, momentMapResolution, momentMapResolution);
+            glClearColor(clearMoments.x, clearMoments.y, clearMoments.z, clearMoments.w);
+            for (size_t i = 0; i < momentCascadeFBOs.size(); ++i)
+            {
+                if (cascadeMask & (1u << i))
+                {
+                    glBindFramebuffer(GL_FRAMEBUFFER, momentCascadeFBOs[i]);
+                    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    statCascades++;
+                }
+            }
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+
+            momentShader.use();
+            glBindFramebuffer(GL_FRAMEBUFFER, momentFBO);
+            glEnable(GL_DEPTH_CLAMP); // pancaking
+            statDraws += renderShadowCasters(momentShader, cascadeMask, statAllTriangles, statCulledTriangles);
+            glDisable(GL_DEPTH_CLAMP);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+            // filter the new layers once, for every fragment that samples them
+            for (size_t i = 0; i < momentCascadeFBOs.size(); ++i)
+            {
+                if (cascadeMask & (1u << i))
+                    momentBlur.Blur(blurShader, momentMaps, (unsigned int)i, momentBlurRadius);
+            }
+            glBindTexture(GL_TEXTURE_2D_ARRAY, momentMaps);
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        if (frame > 0)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(shadowQueries[(frame - 1) % 2], GL_QUERY_RESULT, &elapsed);
+            statGPUTime += elapsed / 1000000.0;
+            glGetQueryObjectui64v(lightingQueries[(frame - 1) % 2], GL_QUERY_RESULT, &elapsed);
+            statLightingTime += elapsed / 1000000.0;
+            glGetQueryObjectui64v(reductionQueries[(frame - 1) % 2], GL_QUERY_RESULT, &elapsed);
+            statReductionTime += elapsed / 1000000.0;
+        }
+        if (glfwGetTime() - statTime >= 1.0 && statFrames > 0)
+        {
+            std::cout << (useEVSM ? "EVSM" : "PCF") << " shadow pass: " << statGPUTime / statFrames << " ms, " << float(statCascades) / statFrames << " cascades and "
+                      << float(statDraws) / statFrames << " draws a frame, lighting pass: " << statLightingTime / statFrames << " ms" << std::endl;
+            // world units a texel of the nearest cascade spans, what the depth range tightens
+            std::cout << (useSDSM ? "SDSM" : "fixed") << " splits over [" << shadowCascades.front().nearPlane << ", " << shadowCascades.back().farPlane
+                      << "], read back " << depthRangeLatency << " frames late, reduction: " << statReductionTime / statFrames << " ms, nearest cascade texel: "
+                      << 2.0f * shadowCascades.front().rendered.radius / (useEVSM ? momentMapResolution : depthMapResolution) << std::endl;
+            std::cout << "triangles a frame per cascade, culled / all:";
+            for (size_t i = 0; i < shadowCascades.size(); ++i)
+            {
+                std::cout << " " << float(statCulledTriangles[i]) / statFrames << " / " << float(statAllTriangles[i]) / statFrames;
+                statAllTriangles[i] = statCulledTriangles[i] = 0;
+            }
+            std::cout << std::endl;
+            statFrames = statCascades = statDraws = 0;
+            statGPUTime = statLightingTime = statReductionTime = 0.0;
+            statTime = glfwGetTime();
+        }
 
         // reset viewport
         glViewport(0, 0, fb_width, fb_height);
@@ -249,8 +462,12 @@ int main()
 
         // 2. render scene as normal using the generated depth/shadow map  
         // --------------------------------------------------------------
+        if (sceneWidth != fb_width || sceneHeight != fb_height)
+            createSceneFramebuffer(fb_width, fb_height);
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
         glViewport(0, 0, fb_width, fb_height);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glBeginQuery(GL_TIME_ELAPSED, lightingQueries[frame % 2]);
         shader.use();
         const glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)fb_width / (float)fb_height, cameraNearPlane, cameraFarPlane);
         const glm::mat4 view = camera.GetViewMatrix();
@@ -259,8 +476,9 @@ int main()
         // set light uniforms
         shader.setVec3("viewPos", camera.Position);
         shader.setVec3("lightDir", lightDir);
-        shader.setFloat("farPlane", cameraFarPlane);
+        shader.setFloat("farPlane", shadowCascades.back().farPlane);
         shader.setInt("cascadeCount", shadowCascadeLevels.size());
+        shader.setBool("evsm", useEVSM);
         for (size_t i = 0; i < shadowCascadeLevels.size(); ++i)
         {
             shader.setFloat("cascadePlaneDistances[" + std::to_string(i) + "]", shadowCascadeLevels[i]);
@@ -269,7 +487,18 @@ int main()
         glBindTexture(GL_TEXTURE_2D, woodTexture);
         glActiveTexture(GL_TEXTURE1);
         glBindTexture(GL_TEXTURE_2D_ARRAY, lightDepthMaps);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, momentMaps);
         renderScene(shader);
+        glEndQuery(GL_TIME_ELAPSED);
+
+        // reduce the depth buffer to the range the next frames' cascades split
+        glBeginQuery(GL_TIME_ELAPSED, reductionQueries[frame % 2]);
+        if (useSDSM)
+            depthRange.Dispatch(sceneDepth, fb_width, fb_height);
+        glEndQuery(GL_TIME_ELAPSED);
+        frame++;
+        statFrames++;
 
         if (lightMatricesCache.size() != 0)
         {
@@ -287,12 +516,17 @@ int main()
         debugDepthQuad.use();
         debugDepthQuad.setInt("layer", debugLayer);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, lightDepthMaps);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, useEVSM ? momentDepthMaps : lightDepthMaps);
         if (showQuad)
         {
             renderQuad();
         }
 
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, fb_width, fb_height, 0, 0, fb_width, fb_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
@@ -303,11 +537,45 @@ int main()
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &planeVAO);
     glDeleteBuffers(1, &planeVBO);
+    deleteDepthStream(planeDepthStream);
+    glDeleteFramebuffers((GLsizei)cascadeFBOs.size(), cascadeFBOs.data());
+    glDeleteFramebuffers((GLsizei)momentCascadeFBOs.size(), momentCascadeFBOs.data());
+    glDeleteFramebuffers(1, &momentFBO);
+    glDeleteTextures(1, &momentMaps);
+    glDeleteTextures(1, &momentDepthMaps);
+    glDeleteQueries(2, shadowQueries);
+    glDeleteQueries(2, lightingQueries);
+    glDeleteQueries(2, reductionQueries);
+    glDeleteFramebuffers(1, &sceneFBO);
+    glDeleteTextures(1, &sceneColor);
+    glDeleteTextures(1, &sceneDepth);
 
     glfwTerminate();
     return 0;
 }
 
+// scatters the cubes, every cascade has to be re-rendered after
+// -------------------------------------------------------------
+void randomizeCubes()
+{
+    static std::uniform_real_distribution<float> offsetDistribution = std::uniform_real_distribution<float>(-10, 10);
+    static std::uniform_real_distribution<float> scaleDistribution = std::uniform_real_distribution<float>(1.0, 2.0);
+    static std::uniform_real_distribution<float> rotationDistribution = std::uniform_real_distribution<float>(0, 180);
+
+    modelMatrices.clear();
+    cubeBounds.clear();
+    for (int i = 0; i < 10; ++i)
+    {
+        auto model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(offsetDistribution(generator), offsetDistribution(generator) + 10.0f, offsetDistribution(generator)));
+        model = glm::rotate(model, glm::radians(rotationDistribution(generator)), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
+        model = glm::scale(model, glm::vec3(scaleDistribution(generator)));
+        modelMatrices.push_back(model);
+        cubeBounds.push_back(transformCasterBounds(model, glm::vec3(-1.0f), glm::vec3(1.0f)));
+    }
+    casterVersion++;
+}
+
 // renders the 3D scene
 // --------------------
 void renderScene(const Shader &shader)
@@ -318,28 +586,56 @@ void renderScene(const Shader &shader)
     glBindVertexArray(planeVAO);
     glDrawArrays(GL_TRIANGLES, 0, 6);
 
-    static std::vector<glm::mat4> modelMatrices;
-    if (modelMatrices.size() == 0)
+    for (const auto& model : modelMatrices)
     {
-        for (int i = 0; i < 10; ++i)
+        shader.setMat4("model", model);
+        renderCube();
+    }
+}
+
+// renders the shadow casters into the cascades of cascadeMask, each instanced into the cascades it touches only, and
+// returns the number of draw calls. Adds the triangles every cascade got, and would have without culling, to the stats
+// --------------------------------------------------------------------------------------------------------------------
+unsigned int renderShadowCasters(const Shader &shader, unsigned int cascadeMask, unsigned int* allTriangles, unsigned int* culledTriangles)
+{
+    const auto lightRotation = getLightRotation(lightDir);
+    const int layersLocation = glGetUniformLocation(shader.ID, "cascadeLayers");
+    unsigned int draws = 0;
+    int layers[16];
+    // the layers the caster is drawn into, 0 if it is culled from all of them
+    auto cull = [&](const ShadowCasterBounds& bounds, unsigned int triangles) {
+        const unsigned int count = cullShadowCaster(bounds, lightRotation, shadowCascades, cascadeMask, layers);
+        for (size_t i = 0; i < shadowCascades.size(); ++i)
+        {
+            if (cascadeMask & (1u << i))
+                allTriangles[i] += triangles;
+        }
+        for (unsigned int i = 0; i < count; ++i)
         {
-            static std::uniform_real_distribution<float> offsetDistribution = std::uniform_real_distribution<float>(-10, 10);
-            static std::uniform_real_distribution<float> scaleDistribution = std::uniform_real_distribution<float>(1.0, 2.0);
-            static std::uniform_real_distribution<float> rotationDistribution = std::uniform_real_distribution<float>(0, 180);
-
-            auto model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(offsetDistribution(generator), offsetDistribution(generator) + 10.0f, offsetDistribution(generator)));
-            model = glm::rotate(model, glm::radians(rotationDistribution(generator)), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-            model = glm::scale(model, glm::vec3(scaleDistribution(generator)));
-            modelMatrices.push_back(model);
+            culledTriangles[layers[i]] += triangles;
         }
+        if (count > 0)
+            glUniform1iv(layersLocation, count, layers);
+        draws += count > 0 ? 1 : 0;
+        return count;
+    };
+
+    // floor
+    if (const unsigned int count = cull(planeBounds, 2))
+    {
+        shader.setMat4("model", glm::mat4(1.0f));
+        drawDepthStream(planeDepthStream, count);
     }
 
-    for (const auto& model : modelMatrices)
+    for (size_t i = 0; i < modelMatrices.size(); ++i)
     {
-        shader.setMat4("model", model);
-        renderCube();
+        if (const unsigned int count = cull(cubeBounds[i], 12))
+        {
+            shader.setMat4("model", modelMatrices[i]);
+            renderCube(count, true);
+        }
     }
+    return draws;
 }
 
 
@@ -347,7 +643,8 @@ void renderScene(const Shader &shader)
 // -------------------------------------------------
 unsigned int cubeVAO = 0;
 unsigned int cubeVBO = 0;
-void renderCube()
+DepthStream cubeDepthStream; // positions only, for the shadow pass
+void renderCube(int instances, bool depthOnly)
 {
     // initialize (if necessary)
     if (cubeVAO == 0)
@@ -411,10 +708,16 @@ void renderCube()
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
         glBindBuffer(GL_ARRAY_BUFFER, 0);
         glBindVertexArray(0);
+        cubeDepthStream = createDepthStream(vertices, 36, 8);
     }
     // render Cube
+    if (depthOnly)
+    {
+        drawDepthStream(cubeDepthStream, instances);
+        return;
+    }
     glBindVertexArray(cubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instances);
     glBindVertexArray(0);
 }
 
@@ -561,6 +864,48 @@ void processInput(GLFWwindow *window)
         lightMatricesCache = getLightSpaceMatrices();
     }
     cPress = glfwGetKey(window, GLFW_KEY_C);
+
+    static int rPress = GLFW_RELEASE;
+    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE && rPress == GLFW_PRESS)
+    {
+        randomizeCubes();
+    }
+    rPress = glfwGetKey(window, GLFW_KEY_R);
+
+    static int vPress = GLFW_RELEASE;
+    if (glfwGetKey(window, GLFW_KEY_V) == GLFW_RELEASE && vPress == GLFW_PRESS)
+    {
+        // the other maps are stale and fit to another resolution
+        useEVSM = !useEVSM;
+        for (auto& cascade : shadowCascades)
+        {
+            cascade.valid = false;
+        }
+    }
+    vPress = glfwGetKey(window, GLFW_KEY_V);
+
+    static int tPress = GLFW_RELEASE;
+    if (glfwGetKey(window, GLFW_KEY_T) == GLFW_RELEASE && tPress == GLFW_PRESS)
+    {
+        useSDSM = !useSDSM;
+        depthRangeNear = cameraNearPlane;
+        depthRangeFar = cameraFarPlane;
+    }
+    tPress = glfwGetKey(window, GLFW_KEY_T);
+}
+
+// whether the context supports the named extension
+// -------------------------------------------------
+bool hasExtension(const char* name)
+{
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; ++i)
+    {
+        if (std::strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), name) == 0)
+            return true;
+    }
+    return false;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -666,79 +1011,71 @@ std::vector<glm::vec4> getFrustumCornersWorldSpace(const glm::mat4& proj, const
     return getFrustumCornersWorldSpace(proj * view);
 }
 
-glm::mat4 getLightSpaceMatrix(const float nearPlane, const float farPlane)
+// the split distances of this frame, fixed or over the visible depth range
+void updateCascadeSplits()
 {
-    const auto proj = glm::perspective(
-        glm::radians(camera.Zoom), (float)fb_width / (float)fb_height, nearPlane,
-        farPlane);
-    const auto corners = getFrustumCornersWorldSpace(proj, camera.GetViewMatrix());
-
-    glm::vec3 center = glm::vec3(0, 0, 0);
-    for (const auto& v : corners)
+    shadowCascadeLevels = useSDSM ? practicalCascadeSplits(depthRangeNear, depthRangeFar, (unsigned int)shadowCascades.size(), cascadeSplitLambda)
+                                  : fixedCascadeLevels;
+    for (size_t i = 0; i < shadowCascades.size(); ++i)
     {
-        center += glm::vec3(v);
+        shadowCascades[i].nearPlane = i == 0 ? (useSDSM ? depthRangeNear : cameraNearPlane) : shadowCascadeLevels[i - 1];
+        shadowCascades[i].farPlane = i < shadowCascadeLevels.size() ? shadowCascadeLevels[i] : (useSDSM ? depthRangeFar : cameraFarPlane);
     }
-    center /= corners.size();
-
-    const auto lightView = glm::lookAt(center + lightDir, center, glm::vec3(0.0f, 1.0f, 0.0f));
+}
 
-    float minX = std::numeric_limits<float>::max();
-    float maxX = std::numeric_limits<float>::lowest();
-    float minY = std::numeric_limits<float>::max();
-    float maxY = std::numeric_limits<float>::lowest();
-    float minZ = std::numeric_limits<float>::max();
-    float maxZ = std::numeric_limits<float>::lowest();
-    for (const auto& v : corners)
+// (re)create the framebuffer the scene is rendered into, its depth being a texture the reduction samples
+void createSceneFramebuffer(int width, int height)
+{
+    if (sceneFBO != 0)
     {
-        const auto trf = lightView * v;
-        minX = std::min(minX, trf.x);
-        maxX = std::max(maxX, trf.x);
-        minY = std::min(minY, trf.y);
-        maxY = std::max(maxY, trf.y);
-        minZ = std::min(minZ, trf.z);
-        maxZ = std::max(maxZ, trf.z);
+        glDeleteFramebuffers(1, &sceneFBO);
+        glDeleteTextures(1, &sceneColor);
+        glDeleteTextures(1, &sceneDepth);
     }
+    glGenFramebuffers(1, &sceneFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+    glGenTextures(1, &sceneColor);
+    glBindTexture(GL_TEXTURE_2D, sceneColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneColor, 0);
+    glGenTextures(1, &sceneDepth);
+    glBindTexture(GL_TEXTURE_2D, sceneDepth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sceneDepth, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cout << "ERROR::FRAMEBUFFER:: Scene framebuffer is not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    sceneWidth = width;
+    sceneHeight = height;
+}
 
-    // Tune this parameter according to the scene
-    constexpr float zMult = 10.0f;
-    if (minZ < 0)
-    {
-        minZ *= zMult;
-    }
-    else
-    {
-        minZ /= zMult;
-    }
-    if (maxZ < 0)
-    {
-        maxZ /= zMult;
-    }
-    else
+// the current fit of every cascade
+std::vector<ShadowCascadeFit> getShadowCascadeFits()
+{
+    const auto lightRotation = getLightRotation(lightDir);
+    std::vector<ShadowCascadeFit> ret;
+    for (const auto& cascade : shadowCascades)
     {
-        maxZ *= zMult;
+        const auto proj = glm::perspective(
+            glm::radians(camera.Zoom), (float)fb_width / (float)fb_height, cascade.nearPlane,
+            cascade.farPlane);
+        const auto corners = getFrustumCornersWorldSpace(proj, camera.GetViewMatrix());
+        ret.push_back(fitShadowCascade(corners, lightRotation, useEVSM ? momentMapResolution : depthMapResolution, cascade.guardBand));
     }
-
-    const glm::mat4 lightProjection = glm::ortho(minX, maxX, minY, maxY, minZ, maxZ);
-    return lightProjection * lightView;
+    return ret;
 }
 
+// the matrices the cascade layers were last rendered with
 std::vector<glm::mat4> getLightSpaceMatrices()
 {
     std::vector<glm::mat4> ret;
-    for (size_t i = 0; i < shadowCascadeLevels.size() + 1; ++i)
+    for (const auto& cascade : shadowCascades)
     {
-        if (i == 0)
-        {
-            ret.push_back(getLightSpaceMatrix(cameraNearPlane, shadowCascadeLevels[i]));
-        }
-        else if (i < shadowCascadeLevels.size())
-        {
-            ret.push_back(getLightSpaceMatrix(shadowCascadeLevels[i - 1], shadowCascadeLevels[i]));
-        }
-        else
-        {
-            ret.push_back(getLightSpaceMatrix(shadowCascadeLevels[i - 1], cameraFarPlane));
-        }
+        ret.push_back(cascade.rendered.lightSpaceMatrix);
     }
     return ret;
 }
@@ -0,0 +1,123 @@
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/heightmap_pyramid.h>
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+
+// Cooks a heightmap into the tiled 16-bit pyramid the terrain demos memory map. The input is either an image stb_image
+// can read (8 or 16 bits, its first channel is used) or a headerless little endian 16-bit raw file, which is memory
+// mapped itself so terrains larger than RAM can be cooked:
+//
+//     heightmap_cooker iceland_heightmap.png iceland_heightmap.hpyr --flip --scale 63.75 --offset -16 --center
+//     heightmap_cooker world.raw world.hpyr --raw 65537 65537 --spacing 2 --scale 4000
+void printUsage()
+{
+    std::cout << "usage: heightmap_cooker <input.png|input.raw> <output.hpyr> [options]" << std::endl
+              << "  --raw <rows> <columns>  input is raw 16-bit samples, row after row" << std::endl
+              << "  --flip                  flip an image vertically (the terrain_cpu_src orientation)" << std::endl
+              << "  --tile <samples>        samples per tile side (256), a multiple of the patch size" << std::endl
+              << "  --patch <samples>       samples per side of the finest terrain patches (32)" << std::endl
+              << "  --spacing <units>       world units between samples (1)" << std::endl
+              << "  --scale <units>         height of the largest sample value (1)" << std::endl
+              << "  --offset <units>        height of sample value 0 (0)" << std::endl
+              << "  --center                center the terrain on the origin" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        printUsage();
+        return -1;
+    }
+
+    HeightmapPyramidSettings settings;
+    bool raw = false, flip = false, center = false;
+    unsigned int rows = 0, columns = 0;
+    for (int i = 3; i < argc; i++)
+    {
+        const std::string option = argv[i];
+        const int remaining = argc - i - 1;
+        if (option == "--raw" && remaining >= 2)
+        {
+            raw = true;
+            rows = std::atoi(argv[++i]);
+            columns = std::atoi(argv[++i]);
+        }
+        else if (option == "--flip")
+            flip = true;
+        else if (option == "--center")
+            center = true;
+        else if (option == "--tile" && remaining >= 1)
+            settings.tileSize = std::atoi(argv[++i]);
+        else if (option == "--patch" && remaining >= 1)
+            settings.patchResolution = std::atoi(argv[++i]);
+        else if (option == "--spacing" && remaining >= 1)
+            settings.sampleSpacing = static_cast<float>(std::atof(argv[++i]));
+        else if (option == "--scale" && remaining >= 1)
+            settings.heightScale = static_cast<float>(std::atof(argv[++i]));
+        else if (option == "--offset" && remaining >= 1)
+            settings.heightOffset = static_cast<float>(std::atof(argv[++i]));
+        else
+        {
+            std::cout << "Unknown option " << option << std::endl;
+            printUsage();
+            return -1;
+        }
+    }
+    if (settings.patchResolution == 0 || settings.tileSize == 0 || settings.tileSize % settings.patchResolution != 0)
+    {
+        std::cout << "The tile size must be a multiple of the patch size" << std::endl;
+        return -1;
+    }
+
+    MappedFile rawFile;
+    unsigned short *image = nullptr;
+    const uint16_t *samples = nullptr;
+    if (raw)
+    {
+        if (!rawFile.Open(argv[1]) || rows < 2 || columns < 2 || rawFile.Size() < (size_t)rows * columns * sizeof(uint16_t))
+        {
+            std::cout << "Failed to map " << argv[1] << " as " << rows << " x " << columns << " raw samples" << std::endl;
+            return -1;
+        }
+        samples = reinterpret_cast<const uint16_t*>(rawFile.Data());
+    }
+    else
+    {
+        stbi_set_flip_vertically_on_load(flip);
+        int width, height, nrChannels;
+        image = stbi_load_16(argv[1], &width, &height, &nrChannels, 1);
+        if (!image)
+        {
+            std::cout << "Failed to load " << argv[1] << std::endl;
+            return -1;
+        }
+        rows = height;
+        columns = width;
+        samples = image;
+    }
+    if (center)
+        settings.origin = glm::vec2(-(rows - 1) * settings.sampleSpacing / 2.0f, -(columns - 1) * settings.sampleSpacing / 2.0f);
+
+    std::cout << "Cooking " << rows << " x " << columns << " samples into " << argv[2] << std::endl;
+    const bool cooked = cookHeightmapPyramid(samples, rows, columns, argv[2], settings);
+    if (image)
+        stbi_image_free(image);
+
+    HeightmapPyramid pyramid;
+    if (!cooked || !pyramid.Open(argv[2]))
+    {
+        std::cout << "Failed to write " << argv[2] << std::endl;
+        return -1;
+    }
+    std::cout << "Wrote " << pyramid.LevelCount() << " levels of " << settings.tileSize << " x " << settings.tileSize << " tiles, "
+              << pyramid.FileSize() / (1024 * 1024) << " MB" << std::endl;
+    return 0;
+}
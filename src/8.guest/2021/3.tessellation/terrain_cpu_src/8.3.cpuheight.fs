@@ -3,9 +3,21 @@
 out vec4 FragColor;
 
 in float Height;
+in vec3 Normal;
+in float Occlusion;
+
+uniform bool grayscale;
+uniform vec3 lightDirection; // towards the light
 
 void main()
 {
     float h = (Height + 16)/32.0f;	// shift and scale the height into a grayscale value
-    FragColor = vec4(h, h, h, 1.0);
-}
\ No newline at end of file
+    if (grayscale)
+    {
+        FragColor = vec4(h, h, h, 1.0);
+        return;
+    }
+    float diffuse = max(dot(normalize(Normal), lightDirection), 0.0);
+    vec3 albedo = mix(vec3(0.35, 0.4, 0.25), vec3(0.9), clamp(h, 0.0, 1.0));
+    FragColor = vec4(albedo * (0.25 * Occlusion + 0.75 * diffuse), 1.0);
+}
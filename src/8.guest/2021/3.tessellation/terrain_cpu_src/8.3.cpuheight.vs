@@ -1,16 +1,65 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec2 aGridPos; // [0, 1]^2 over the patch
+layout (location = 7) in vec4 aPatch;   // xy first sample (row, column), z size in samples, w LOD level
+layout (location = 8) in vec4 aTile;    // x layer of heightTiles, yz first sample (row, column) of the tile, w samples between its texels
 
 out float Height;
 out vec3 Position;
+out vec3 Normal;
+out float Occlusion;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform vec3 cameraPosition;
+
+uniform sampler2DArray heightTiles;
+uniform sampler2DArray shadingTiles; // rgb normal * 0.5 + 0.5, a ambient occlusion
+uniform float tileSize;     // texels per tile side minus the border one
+uniform vec2 heightmapSize; // rows, columns
+uniform vec2 terrainOrigin; // world xz of sample (0, 0)
+uniform float sampleSpacing;
+uniform float heightScale;
+uniform float heightOffset;
+uniform float patchResolution;
+uniform vec2 morphRanges[16]; // per level: distance where the morph starts, 1 / length of the morph
+
+// patches on the border of the map reach past it, their vertices collapse onto the last row/column
+vec2 clampToMap(vec2 samplePos)
+{
+    return min(samplePos, heightmapSize - 1.0);
+}
+
+// texel (column, row) of the tile, sampled at its center so fractional positions of morphing vertices interpolate
+vec3 tileCoords(vec2 samplePos)
+{
+    vec2 texel = (samplePos - aTile.yz) / aTile.w;
+    return vec3((texel.yx + 0.5) / (tileSize + 1.0), aTile.x);
+}
+
+vec3 terrainPosition(vec2 samplePos)
+{
+    samplePos = clampToMap(samplePos);
+    float h = textureLod(heightTiles, tileCoords(samplePos), 0.0).r * heightScale + heightOffset;
+    return vec3(terrainOrigin.x + samplePos.x * sampleSpacing, h, terrainOrigin.y + samplePos.y * sampleSpacing);
+}
 
 void main()
 {
-    Height = aPos.y;
-    Position = (view * model * vec4(aPos, 1.0)).xyz;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    vec3 worldPos = terrainPosition(aPatch.xy + aGridPos * aPatch.z);
+
+    // move the odd vertices of the grid onto the even ones (the grid of the next level) as the end of the range nears
+    vec2 morph = morphRanges[int(aPatch.w)];
+    float morphK = clamp((distance(cameraPosition, worldPos) - morph.x) * morph.y, 0.0, 1.0);
+    vec2 fracPart = fract(aGridPos * patchResolution * 0.5) * 2.0 / patchResolution;
+    vec2 samplePos = aPatch.xy + (aGridPos - fracPart * morphK) * aPatch.z;
+    worldPos = terrainPosition(samplePos);
+
+    // one fetch for the precomputed normal and occlusion
+    vec4 shading = textureLod(shadingTiles, tileCoords(clampToMap(samplePos)), 0.0);
+    Normal = normalize(shading.rgb * 2.0 - 1.0);
+    Occlusion = shading.a;
+
+    Height = worldPos.y;
+    Position = (view * vec4(worldPos, 1.0)).xyz;
+    gl_Position = projection * view * vec4(worldPos, 1.0);
+}
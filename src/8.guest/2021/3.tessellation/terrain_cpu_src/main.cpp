@@ -9,6 +9,9 @@
 
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/cdlod.h>
+#include <learnopengl/terrain_query.h>
 
 #include <iostream>
 #include <vector>
@@ -24,6 +27,7 @@ const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 int useWireframe = 0;
 int displayGrayscale = 0;
+int walkOnGround = 0;
 
 // camera - give pretty starting point
 Camera camera(glm::vec3(67.0f, 627.5f, 169.9f),
@@ -84,79 +88,53 @@ int main()
     // ------------------------------------
     Shader heightMapShader("8.3.cpuheight.vs","8.3.cpuheight.fs");
 
-    // load and create a texture
-    // -------------------------
-    // load image, create texture and generate mipmaps
+    // load the heightmap
+    // ------------------
+    // The PNG is cooked into a tiled 16-bit pyramid the first time, later runs memory map the cooked file and only read
+    // the tiles the camera needs. Bigger terrains can be cooked offline with the heightmap_cooker tool.
     // The FileSystem::getPath(...) is part of the GitHub repository so we can find files on any IDE/platform; replace it with your own image path.
-    stbi_set_flip_vertically_on_load(true);
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load("heightmaps/iceland_heightmap.png", &width, &height, &nrChannels, 0);
-    if (data)
+    HeightmapPyramid pyramid;
+    if (!pyramid.Open("heightmaps/iceland_heightmap.hpyr"))
     {
-        std::cout << "Loaded heightmap of size " << height << " x " << width << std::endl;
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-
-
-    // set up vertex data (and buffer(s)) and configure vertex attributes
-    // ------------------------------------------------------------------
-    std::vector<float> vertices;
-    float yScale = 64.0f / 256.0f, yShift = 16.0f;
-    int rez = 1;
-    unsigned bytePerPixel = nrChannels;
-    for(int i = 0; i < height; i++)
-    {
-        for(int j = 0; j < width; j++)
+        stbi_set_flip_vertically_on_load(true);
+        int width, height, nrChannels;
+        // 8-bit images are widened to 16 bits, so 16-bit heightmaps keep their full precision
+        unsigned short *data = stbi_load_16("heightmaps/iceland_heightmap.png", &width, &height, &nrChannels, 1);
+        if (!data)
         {
-            unsigned char* pixelOffset = data + (j + width * i) * bytePerPixel;
-            unsigned char y = pixelOffset[0];
-
-            // vertex
-            vertices.push_back( -height/2.0f + height*i/(float)height );   // vx
-            vertices.push_back( (int) y * yScale - yShift);   // vy
-            vertices.push_back( -width/2.0f + width*j/(float)width );   // vz
+            std::cout << "Failed to load texture" << std::endl;
+            glfwTerminate();
+            return -1;
         }
-    }
-    std::cout << "Loaded " << vertices.size() / 3 << " vertices" << std::endl;
-    stbi_image_free(data);
-
-    std::vector<unsigned> indices;
-    for(unsigned i = 0; i < height-1; i += rez)
-    {
-        for(unsigned j = 0; j < width; j += rez)
+        std::cout << "Cooking heightmap of size " << height << " x " << width << std::endl;
+
+        // the terrain is centered on the origin with one world unit per sample, an 8-bit sample v being v * 64 / 256 - 16 high
+        HeightmapPyramidSettings settings;
+        settings.tileSize = 256;
+        settings.patchResolution = 32;
+        settings.origin = glm::vec2(-height / 2.0f, -width / 2.0f);
+        settings.sampleSpacing = 1.0f;
+        settings.heightScale = 255.0f * 64.0f / 256.0f;
+        settings.heightOffset = -16.0f;
+        const bool cooked = cookHeightmapPyramid(data, height, width, "heightmaps/iceland_heightmap.hpyr", settings);
+        stbi_image_free(data);
+        if (!cooked || !pyramid.Open("heightmaps/iceland_heightmap.hpyr"))
         {
-            for(unsigned k = 0; k < 2; k++)
-            {
-                indices.push_back(j + width * (i + k*rez));
-            }
+            std::cout << "Failed to cook heightmap" << std::endl;
+            glfwTerminate();
+            return -1;
         }
     }
-    std::cout << "Loaded " << indices.size() << " indices" << std::endl;
-
-    const int numStrips = (height-1)/rez;
-    const int numTrisPerStrip = (width/rez)*2-2;
-    std::cout << "Created lattice of " << numStrips << " strips with " << numTrisPerStrip << " triangles each" << std::endl;
-    std::cout << "Created " << numStrips * numTrisPerStrip << " triangles total" << std::endl;
-
-    // first, configure the cube's VAO (and terrainVBO + terrainIBO)
-    unsigned int terrainVAO, terrainVBO, terrainIBO;
-    glGenVertexArrays(1, &terrainVAO);
-    glBindVertexArray(terrainVAO);
-
-    glGenBuffers(1, &terrainVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, terrainVBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+    std::cout << "Mapped heightmap of size " << pyramid.Header.rows << " x " << pyramid.Header.columns << " (" << pyramid.FileSize() / (1024 * 1024) << " MB)" << std::endl;
 
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glGenBuffers(1, &terrainIBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainIBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned), &indices[0], GL_STATIC_DRAW);
+    // set up the quadtree, the shared patch mesh and the tile cache
+    // -------------------------------------------------------------
+    CDLODTerrain terrain(pyramid);
+    std::cout << "Created CDLOD quadtree of " << terrain.LevelCount << " levels with " << terrain.PatchResolution << " x " << terrain.PatchResolution << " patches" << std::endl;
+    // height and ray queries for the camera
+    TerrainQuery query(pyramid);
+    CDLODStats stats;
+    double statTime = glfwGetTime();
 
     // render loop
     // -----------
@@ -173,6 +151,8 @@ int main()
         // input
         // -----
         processInput(window);
+        if (walkOnGround)
+            camera.Position.y = query.GetHeight(camera.Position.x, camera.Position.z) + 2.0f;
 
         // render
         // ------
@@ -187,20 +167,25 @@ int main()
         glm::mat4 view = camera.GetViewMatrix();
         heightMapShader.setMat4("projection", projection);
         heightMapShader.setMat4("view", view);
+        heightMapShader.setBool("grayscale", displayGrayscale);
+        heightMapShader.setVec3("lightDirection", glm::normalize(glm::vec3(-0.4f, 0.8f, 0.45f)));
+
+        // render the terrain, all visible patches in one instanced draw
+        glPolygonMode(GL_FRONT_AND_BACK, useWireframe ? GL_LINE : GL_FILL);
+        terrain.Draw(heightMapShader, createFrustumFromMatrix(projection * view), camera.Position, stats);
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-        // world transformation
-        glm::mat4 model = glm::mat4(1.0f);
-        heightMapShader.setMat4("model", model);
-        
-        // render the cube
-        glBindVertexArray(terrainVAO);
-//        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        for(unsigned strip = 0; strip < numStrips; strip++)
+        if (glfwGetTime() - statTime >= 1.0)
         {
-            glDrawElements(GL_TRIANGLE_STRIP,   // primitive type
-                           numTrisPerStrip+2,   // number of indices to render
-                           GL_UNSIGNED_INT,     // index data type
-                           (void*)(sizeof(unsigned) * (numTrisPerStrip+2) * strip)); // offset to starting index
+            const HeightmapTileCacheStats &tiles = terrain.Tiles.GetStats();
+            std::cout << stats.selectedPatches << " patches (" << stats.triangles << " triangles), " << stats.visitedNodes << " nodes visited, "
+                      << tiles.residentTiles << " tiles resident, " << tiles.pendingTiles << " pending, " << tiles.fallbackPatches << " patches on coarser tiles" << std::endl;
+            // pick the point in the middle of the screen
+            TerrainRayHit hit;
+            if (query.Raycast(camera.Position, camera.Front, 100000.0f, hit))
+                std::cout << "Looking at (" << hit.position.x << ", " << hit.position.y << ", " << hit.position.z << "), " << hit.distance << " away, slope "
+                          << glm::degrees(std::acos(hit.normal.y)) << " degrees" << std::endl;
+            statTime = glfwGetTime();
         }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
@@ -209,12 +194,6 @@ int main()
         glfwPollEvents();
     }
 
-    // optional: de-allocate all resources once they've outlived their purpose:
-    // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &terrainVAO);
-    glDeleteBuffers(1, &terrainVBO);
-    glDeleteBuffers(1, &terrainIBO);
-
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -258,6 +237,9 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
             case GLFW_KEY_SPACE:
                 useWireframe = 1 - useWireframe;
                 break;
+            case GLFW_KEY_F:
+                walkOnGround = 1 - walkOnGround;
+                break;
             case GLFW_KEY_G:
                 displayGrayscale = 1 - displayGrayscale;
                 break;
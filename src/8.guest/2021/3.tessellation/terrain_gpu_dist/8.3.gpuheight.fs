@@ -1,11 +1,16 @@
 #version 410 core
 
 in float Height;
+in vec3 Normal;
+in float Occlusion;
 
 out vec4 FragColor;
 
+uniform vec3 lightDirection; // towards the light
+
 void main()
 {
     float h = (Height + 16)/64.0f;
-    FragColor = vec4(h, h, h, 1.0);
-}
\ No newline at end of file
+    float diffuse = max(dot(normalize(Normal), lightDirection), 0.0);
+    FragColor = vec4(vec3(h) * (0.25 * Occlusion + 0.75 * diffuse) * 1.5, 1.0);
+}
@@ -9,6 +9,10 @@
 
 #include <learnopengl/shader_t.h>
 #include <learnopengl/camera.h>
+#include <learnopengl/heightmap_pyramid.h>
+#include <learnopengl/frustum.h>
+
+#include "terrain_patches.h"
 
 #include <iostream>
 #include <vector>
@@ -23,6 +27,9 @@ void processInput(GLFWwindow *window);
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
 const unsigned int NUM_PATCH_PTS = 4;
+const float PIXELS_PER_EDGE = 8.0f;          // target length on screen of a tessellated edge
+const unsigned int TRIANGLE_BUDGET = 2000000; // the target edge length grows when the visible patches would exceed this
+bool cullPatches = true;
 
 // camera - give pretty starting point
 Camera camera(glm::vec3(67.0f, 627.5f, 169.9f),
@@ -88,8 +95,71 @@ int main()
     Shader tessHeightMapShader("8.3.gpuheight.vs","8.3.gpuheight.fs", nullptr,            // if wishing to render as is
                                "8.3.gpuheight.tcs", "8.3.gpuheight.tes");
 
-    // load and create a texture
-    // -------------------------
+    // load the heightmap
+    // ------------------
+    // The PNG is cooked into a tiled 16-bit pyramid the first time, later runs memory map the cooked file.
+    // The FileSystem::getPath(...) is part of the GitHub repository so we can find files on any IDE/platform; replace it with your own image path.
+    HeightmapPyramid pyramid;
+    if (!pyramid.Open("heightmaps/iceland_heightmap.hpyr"))
+    {
+        int width, height, nrChannels;
+        // 8-bit images are widened to 16 bits, so 16-bit heightmaps keep their full precision
+        unsigned short *data = stbi_load_16("heightmaps/iceland_heightmap.png", &width, &height, &nrChannels, 1);
+        if (!data)
+        {
+            std::cout << "Failed to load texture" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        std::cout << "Cooking heightmap of size " << height << " x " << width << std::endl;
+
+        // an 8-bit sample v is v / 255 * 64 - 16 high
+        HeightmapPyramidSettings settings;
+        settings.heightScale = 64.0f;
+        settings.heightOffset = -16.0f;
+        const bool cooked = cookHeightmapPyramid(data, height, width, "heightmaps/iceland_heightmap.hpyr", settings);
+        stbi_image_free(data);
+        if (!cooked || !pyramid.Open("heightmaps/iceland_heightmap.hpyr"))
+        {
+            std::cout << "Failed to cook heightmap" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+    }
+    const int width = pyramid.Header.columns;
+    const int height = pyramid.Header.rows;
+
+    // the finest level of the pyramid that fits in a texture, heights and shading assembled from its tiles
+    GLint maxTextureSize;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    const HeightmapPyramidLayout &layout = pyramid.Layout();
+    unsigned int level = 0;
+    while (level + 1 < layout.levelCount && std::max(layout.LevelRows(level), layout.LevelColumns(level)) > (unsigned int)maxTextureSize)
+        level++;
+    const unsigned int rows = layout.LevelRows(level);
+    const unsigned int columns = layout.LevelColumns(level);
+    std::vector<unsigned short> samples((size_t)rows * columns);
+    std::vector<unsigned int> shading((size_t)rows * columns);
+    for (unsigned int tileX = 0; tileX < layout.TilesX(level); tileX++)
+    {
+        for (unsigned int tileZ = 0; tileZ < layout.TilesZ(level); tileZ++)
+        {
+            const uint16_t *tile = pyramid.Tile(level, tileX, tileZ);
+            const uint32_t *shadingTile = pyramid.ShadingTile(level, tileX, tileZ);
+            const unsigned int firstColumn = tileZ * layout.tileSize;
+            const unsigned int count = std::min(layout.tileSize + 1, columns - firstColumn);
+            for (unsigned int i = 0; i <= layout.tileSize && tileX * layout.tileSize + i < rows; i++)
+            {
+                const size_t source = (size_t)i * (layout.tileSize + 1);
+                const size_t destination = (size_t)(tileX * layout.tileSize + i) * columns + firstColumn;
+                std::copy(tile + source, tile + source + count, &samples[destination]);
+                std::copy(shadingTile + source, shadingTile + source + count, &shading[destination]);
+            }
+        }
+    }
+
+    // create the texture and generate mipmaps
+    // ---------------------------------------
     unsigned int texture;
     glGenTextures(1, &texture);
     glActiveTexture(GL_TEXTURE0);
@@ -100,23 +170,33 @@ int main()
     // set texture filtering parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load image, create texture and generate mipmaps
-    int width, height, nrChannels;
-    // The FileSystem::getPath(...) is part of the GitHub repository so we can find files on any IDE/platform; replace it with your own image path.
-    unsigned char *data = stbi_load("heightmaps/iceland_heightmap.png", &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, columns, rows, 0, GL_RED, GL_UNSIGNED_SHORT, samples.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    // normals and ambient occlusion, so the evaluation shader shades with one fetch instead of differencing heights
+    unsigned int shadingTexture;
+    glGenTextures(1, &shadingTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, shadingTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, columns, rows, 0, GL_RGBA, GL_UNSIGNED_BYTE, shading.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glActiveTexture(GL_TEXTURE0);
+    shading.clear();
+    shading.shrink_to_fit();
 
-        tessHeightMapShader.setInt("heightMap", 0);
-        std::cout << "Loaded heightmap of size " << height << " x " << width << std::endl;
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+    tessHeightMapShader.use();
+    tessHeightMapShader.setInt("heightMap", 0);
+    tessHeightMapShader.setInt("shadingMap", 1);
+    tessHeightMapShader.setVec3("lightDirection", glm::normalize(glm::vec3(-0.4f, 0.8f, 0.45f)));
+    tessHeightMapShader.setFloat("heightScale", pyramid.Header.heightScale);
+    tessHeightMapShader.setFloat("heightOffset", pyramid.Header.heightOffset);
+    std::cout << "Loaded heightmap of size " << height << " x " << width << " from level " << level << " (" << rows << " x " << columns << ")" << std::endl;
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -155,6 +235,13 @@ int main()
     std::cout << "Loaded " << rez*rez << " patches of 4 control points each" << std::endl;
     std::cout << "Processing " << rez*rez*4 << " vertices in vertex shader" << std::endl;
 
+    // per patch bounds from the heights it covers, to skip the patches outside the view
+    TerrainPatchBounds patchBounds = computeTerrainPatchBounds(samples.data(), rows, columns, rez, (float)width, (float)height,
+                                                               pyramid.Header.heightScale, pyramid.Header.heightOffset);
+    TerrainPatchSelection selection;
+    samples.clear();
+    samples.shrink_to_fit();
+
     // first, configure the cube's VAO (and terrainVBO)
     unsigned int terrainVAO, terrainVBO;
     glGenVertexArrays(1, &terrainVAO);
@@ -173,6 +260,11 @@ int main()
 
     glPatchParameteri(GL_PATCH_VERTICES, NUM_PATCH_PTS);
 
+    // triangles actually generated by the tessellator, read back with the stats
+    unsigned int primitivesQuery;
+    glGenQueries(1, &primitivesQuery);
+    double statTime = glfwGetTime();
+
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
@@ -205,9 +297,29 @@ int main()
         glm::mat4 model = glm::mat4(1.0f);
         tessHeightMapShader.setMat4("model", model);
 
-        // render the terrain
+        // cull the patches and pick the edge length that keeps the visible ones within the triangle budget
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        selectTerrainPatches(patchBounds, createFrustumFromMatrix(projection * view), view, projection[1][1] * framebufferHeight * 0.5f,
+                             PIXELS_PER_EDGE, TRIANGLE_BUDGET, cullPatches, selection);
+        tessHeightMapShader.setFloat("viewportHeight", (float)framebufferHeight);
+        tessHeightMapShader.setFloat("pixelsPerEdge", selection.pixelsPerEdge);
+
+        // render the visible patches
+        const bool printStats = glfwGetTime() - statTime >= 1.0;
+        if (printStats)
+            glBeginQuery(GL_PRIMITIVES_GENERATED, primitivesQuery);
         glBindVertexArray(terrainVAO);
-        glDrawArrays(GL_PATCHES, 0, NUM_PATCH_PTS*rez*rez);
+        glMultiDrawArrays(GL_PATCHES, selection.firsts.data(), selection.counts.data(), (GLsizei)selection.firsts.size());
+        if (printStats)
+        {
+            glEndQuery(GL_PRIMITIVES_GENERATED);
+            GLuint primitives = 0;
+            glGetQueryObjectuiv(primitivesQuery, GL_QUERY_RESULT, &primitives);
+            std::cout << selection.visiblePatches << " / " << rez*rez << " patches" << (cullPatches ? "" : " (culling off)") << ", " << primitives << " triangles (estimated "
+                      << selection.estimatedTriangles << "), " << selection.pixelsPerEdge << " pixels per edge" << std::endl;
+            statTime = glfwGetTime();
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -219,6 +331,7 @@ int main()
     // ------------------------------------------------------------------------
     glDeleteVertexArrays(1, &terrainVAO);
     glDeleteBuffers(1, &terrainVBO);
+    glDeleteQueries(1, &primitivesQuery);
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
@@ -260,6 +373,9 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     {
         switch(key)
         {
+            case GLFW_KEY_C:
+                cullPatches = !cullPatches;
+                break;
             default:
                 break;
         }
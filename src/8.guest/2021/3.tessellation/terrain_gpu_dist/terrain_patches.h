@@ -0,0 +1,127 @@
+#ifndef TERRAIN_PATCHES_H
+#define TERRAIN_PATCHES_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/frustum.h>
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// tessellation levels the control shader clamps to, must match 8.3.gpuheight.tcs
+#define MIN_TESS_LEVEL 1.0f
+#define MAX_TESS_LEVEL 64.0f
+
+// World space bounds of the rez x rez patches of the terrain grid, patch (i, j) being the (i * rez + j)th. Patch i
+// spans [i, i + 1] / rez of the width along x and of the heightmap's columns, patch j the same of the height along z
+// and of its rows.
+struct TerrainPatchBounds
+{
+    unsigned int rez = 0;
+    std::vector<glm::vec3> minimum;
+    std::vector<glm::vec3> maximum;
+};
+
+// the patches' bounds from the samples of the heightmap texture (rows x columns, row major), each patch taking the
+// height range of every texel its bilinear lookups can reach
+TerrainPatchBounds computeTerrainPatchBounds(const unsigned short* samples, unsigned int rows, unsigned int columns, unsigned int rez,
+                                             float width, float height, float heightScale, float heightOffset)
+{
+    TerrainPatchBounds bounds;
+    bounds.rez = rez;
+    bounds.minimum.resize(rez * rez);
+    bounds.maximum.resize(rez * rez);
+    for (unsigned int i = 0; i < rez; i++)
+    {
+        const unsigned int firstColumn = static_cast<unsigned int>(std::max(0.0f, float(columns) * i / rez - 0.5f));
+        const unsigned int lastColumn = std::min(columns - 1, static_cast<unsigned int>(std::ceil(float(columns) * (i + 1) / rez + 0.5f)));
+        for (unsigned int j = 0; j < rez; j++)
+        {
+            const unsigned int firstRow = static_cast<unsigned int>(std::max(0.0f, float(rows) * j / rez - 0.5f));
+            const unsigned int lastRow = std::min(rows - 1, static_cast<unsigned int>(std::ceil(float(rows) * (j + 1) / rez + 0.5f)));
+            unsigned short low = 0xFFFF, high = 0;
+            for (unsigned int row = firstRow; row <= lastRow; row++)
+            {
+                for (unsigned int column = firstColumn; column <= lastColumn; column++)
+                {
+                    low = std::min(low, samples[(size_t)row * columns + column]);
+                    high = std::max(high, samples[(size_t)row * columns + column]);
+                }
+            }
+            bounds.minimum[i * rez + j] = glm::vec3(-width / 2.0f + width * i / rez, low / 65535.0f * heightScale + heightOffset, -height / 2.0f + height * j / rez);
+            bounds.maximum[i * rez + j] = glm::vec3(-width / 2.0f + width * (i + 1) / rez, high / 65535.0f * heightScale + heightOffset, -height / 2.0f + height * (j + 1) / rez);
+        }
+    }
+    return bounds;
+}
+
+struct TerrainPatchSelection
+{
+    std::vector<int> firsts;    // for glMultiDrawArrays, consecutive visible patches merged into one range
+    std::vector<int> counts;
+    unsigned int visiblePatches = 0;
+    unsigned int estimatedTriangles = 0;
+    float pixelsPerEdge = 0.0f; // the target edge length, raised from the requested one if the budget demanded it
+};
+
+// tessellation level of an edge as 8.3.gpuheight.tcs computes it: the edge's bounding sphere projected to the screen,
+// divided by the target length in pixels of a tessellated edge
+float terrainEdgeLevel(const glm::vec3& a, const glm::vec3& b, const glm::mat4& view, float projectionScale, float pixelsPerEdge)
+{
+    const float diameter = glm::distance(a, b);
+    const float depth = std::max(-(view * glm::vec4((a + b) * 0.5f, 1.0f)).z, diameter * 0.5f);
+    return glm::clamp(diameter * projectionScale / depth / pixelsPerEdge, MIN_TESS_LEVEL, MAX_TESS_LEVEL);
+}
+
+// Frustum cull the patches against their bounds and estimate the triangles the visible ones tessellate into. When
+// they exceed triangleBudget the target edge length is raised to bring them back under it (triangles scale with the
+// inverse square of the edge length). projectionScale is projection[1][1] * viewport height / 2.
+void selectTerrainPatches(const TerrainPatchBounds& bounds, const Frustum& frustum, const glm::mat4& view, float projectionScale,
+                          float pixelsPerEdge, unsigned int triangleBudget, bool cull, TerrainPatchSelection& selection)
+{
+    const Plane* planes[6] = { &frustum.leftFace, &frustum.rightFace, &frustum.topFace,
+        &frustum.bottomFace, &frustum.nearFace, &frustum.farFace };
+
+    selection.firsts.clear();
+    selection.counts.clear();
+    selection.visiblePatches = 0;
+    float triangles = 0.0f;
+    const unsigned int patchCount = bounds.rez * bounds.rez;
+    for (unsigned int patch = 0; patch < patchCount; patch++)
+    {
+        const glm::vec3 center = (bounds.minimum[patch] + bounds.maximum[patch]) * 0.5f;
+        const glm::vec3 extents = (bounds.maximum[patch] - bounds.minimum[patch]) * 0.5f;
+        bool inside = true;
+        for (unsigned int p = 0; p < 6 && inside && cull; p++)
+            inside = planes[p]->getSignedDistanceToPlane(center) >= -glm::dot(extents, glm::abs(planes[p]->normal));
+        if (!inside)
+            continue;
+
+        selection.visiblePatches++;
+        if (!selection.firsts.empty() && selection.firsts.back() + selection.counts.back() == int(patch * 4))
+            selection.counts.back() += 4;
+        else
+        {
+            selection.firsts.push_back(patch * 4);
+            selection.counts.push_back(4);
+        }
+
+        // the inner levels are the larger of the opposite outer ones, about 2 * inner0 * inner1 triangles
+        const glm::vec3 p00(bounds.minimum[patch].x, center.y, bounds.minimum[patch].z);
+        const glm::vec3 p11(bounds.maximum[patch].x, center.y, bounds.maximum[patch].z);
+        const glm::vec3 p01(p11.x, center.y, p00.z), p10(p00.x, center.y, p11.z);
+        const float inner0 = std::max(terrainEdgeLevel(p00, p01, view, projectionScale, pixelsPerEdge), terrainEdgeLevel(p10, p11, view, projectionScale, pixelsPerEdge));
+        const float inner1 = std::max(terrainEdgeLevel(p00, p10, view, projectionScale, pixelsPerEdge), terrainEdgeLevel(p01, p11, view, projectionScale, pixelsPerEdge));
+        triangles += 2.0f * inner0 * inner1;
+    }
+
+    selection.pixelsPerEdge = pixelsPerEdge;
+    if (triangleBudget > 0 && triangles > triangleBudget)
+    {
+        selection.pixelsPerEdge = pixelsPerEdge * std::sqrt(triangles / triangleBudget);
+        triangles = float(triangleBudget);
+    }
+    selection.estimatedTriangles = static_cast<unsigned int>(triangles);
+}
+#endif